@@ -10,7 +10,7 @@ make
 # 3. Run if compile was successful
 if [ $? -eq 0 ]; then
     echo "Build Successful. Launching Simulation..."
-    ./main
+    ./main "$@"
 else
     echo "Compilation Failed!"
     exit 1
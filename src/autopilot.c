@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <getopt.h>
+#include <math.h>
+#include <limits.h>
+#include "common.h"
+#include "params.h"
+#include "channel.h"
+#include "motion.h"
+
+// AUTOPILOT (benchmark driver)
+// Flies the target sequence without a human: it reads the world from the
+// Blackboard like the Map does, plans a path to the next target on an
+// occupancy grid (wavefront from the target), and sends MSG_FORCE_UPDATE
+// on the Input Window's channel. No ncurses: it runs headless for soak
+// tests and prints targets per minute and loop timing.
+
+#define AP_CELL       1.0f    // Planning grid resolution (meters)
+#define AP_W          100     // MAP_WIDTH / AP_CELL
+#define AP_H          100     // MAP_HEIGHT / AP_CELL
+#define AP_LOOKAHEAD  4       // Cells followed along the path for the aim point
+#define AP_REPORT     10.0    // Seconds between two reports
+
+// World as seen through the Blackboard
+static DroneState drone;
+static Obstacle obstacles[MAX_OBSTACLES];
+static Target targets[MAX_TARGETS];
+static int have_drone = 0;
+
+// Tunables (config/params.txt, AUTOPILOT_*)
+static float ap_rate;        // Control loop (Hz)
+static float ap_speed;       // Cruise speed (m/s)
+static float ap_force;       // Max commanded force (N)
+static float ap_clearance;   // Obstacle inflation for planning (m)
+static float K;              // Friction, to hold the cruise speed
+
+// Planning grid: -1 = blocked, otherwise distance to the target in cells
+static int wave[AP_H][AP_W];
+static int queue[AP_W * AP_H];
+
+// Statistics
+static long collected = 0, collected_window = 0;
+static long loops = 0;
+static double work_sum = 0.0, work_max = 0.0;      // Plan + control time
+static double period_sum = 0.0, period_max = 0.0;  // Time between two loops
+
+static volatile sig_atomic_t stop = 0;
+static void on_signal(int sig) { stop = 1; }
+
+static void apply_params(void) {
+    ap_rate = param_get_float("AUTOPILOT_RATE", CMD_RATE_DEFAULT);
+    if (ap_rate < 1.0f) ap_rate = CMD_RATE_DEFAULT;
+    ap_speed = param_get_float("AUTOPILOT_SPEED", 8.0f);
+    ap_force = param_get_float("AUTOPILOT_FORCE", 20.0f);
+    ap_clearance = param_get_float("AUTOPILOT_CLEARANCE", 3.0f);
+    K = param_get_float("K", 1.0f);
+}
+
+static int clamp_cell(float v, int n) {
+    int c = (int)(v / AP_CELL);
+    return c < 0 ? 0 : (c >= n ? n - 1 : c);
+}
+
+// Next target in the sequence: the lowest active id (collected ones are
+// inactive until the level is respawned)
+static int next_target(void) {
+    for (int i = 0; i < MAX_TARGETS; i++) {
+        if (targets[i].id == i && targets[i].active == 1) return i;
+    }
+    return -1;
+}
+
+// 1. Occupancy: obstacles (at their current position) inflated by the
+//    clearance, except around the target so it stays reachable.
+// 2. Wavefront: BFS from the target cell over the free cells.
+static void plan(Vec2 goal, double now) {
+    for (int y = 0; y < AP_H; y++)
+        for (int x = 0; x < AP_W; x++) wave[y][x] = INT_MAX;
+
+    int reach = (int)ceilf(ap_clearance / AP_CELL);
+    for (int i = 0; i < MAX_OBSTACLES; i++) {
+        if (obstacles[i].id == -1) continue;
+        Vec2 o = motion_position(&obstacles[i], now);
+        int cx = clamp_cell(o.x, AP_W), cy = clamp_cell(o.y, AP_H);
+        for (int y = cy - reach; y <= cy + reach; y++) {
+            for (int x = cx - reach; x <= cx + reach; x++) {
+                if (x < 0 || y < 0 || x >= AP_W || y >= AP_H) continue;
+                float dx = (x + 0.5f) * AP_CELL - o.x, dy = (y + 0.5f) * AP_CELL - o.y;
+                if (dx*dx + dy*dy <= ap_clearance * ap_clearance) wave[y][x] = -1;
+            }
+        }
+    }
+    int gx = clamp_cell(goal.x, AP_W), gy = clamp_cell(goal.y, AP_H);
+    int keep = (int)ceilf(TARGET_RADIUS / AP_CELL);
+    for (int y = gy - keep; y <= gy + keep; y++)
+        for (int x = gx - keep; x <= gx + keep; x++)
+            if (x >= 0 && y >= 0 && x < AP_W && y < AP_H) wave[y][x] = INT_MAX;
+
+    int head = 0, tail = 0;
+    wave[gy][gx] = 0;
+    queue[tail++] = gy * AP_W + gx;
+    while (head < tail) {
+        int c = queue[head++];
+        int x = c % AP_W, y = c / AP_W;
+        static const int nb[4][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+        for (int k = 0; k < 4; k++) {
+            int nx = x + nb[k][0], ny = y + nb[k][1];
+            if (nx < 0 || ny < 0 || nx >= AP_W || ny >= AP_H) continue;
+            if (wave[ny][nx] != INT_MAX) continue;   // Blocked or already reached
+            wave[ny][nx] = wave[y][x] + 1;
+            queue[tail++] = ny * AP_W + nx;
+        }
+    }
+}
+
+// Follows the steepest descent of the wavefront AP_LOOKAHEAD cells ahead
+// of the drone. Falls back to the straight line if the drone's cell is
+// blocked or cut off (e.g. pushed inside the clearance by the field).
+static Vec2 aim_point(Vec2 goal) {
+    int x = clamp_cell(drone.position.x, AP_W), y = clamp_cell(drone.position.y, AP_H);
+    if (wave[y][x] < 0 || wave[y][x] == INT_MAX) return goal;
+    for (int step = 0; step < AP_LOOKAHEAD && wave[y][x] > 0; step++) {
+        int bx = x, by = y;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                int nx = x + dx, ny = y + dy;
+                if (nx < 0 || ny < 0 || nx >= AP_W || ny >= AP_H) continue;
+                if (wave[ny][nx] < 0 || wave[ny][nx] == INT_MAX) continue;
+                if (wave[ny][nx] < wave[by][bx]) { bx = nx; by = ny; }
+            }
+        }
+        if (bx == x && by == y) break;
+        x = bx; y = by;
+    }
+    if (wave[y][x] == 0) return goal;
+    Vec2 p = { (x + 0.5f) * AP_CELL, (y + 0.5f) * AP_CELL };
+    return p;
+}
+
+// Velocity controller: cruise towards the aim point, slow down near the
+// goal. K * v holds the speed against the friction, the rest corrects.
+static Vec2 control(Vec2 aim, Vec2 goal) {
+    float dx = aim.x - drone.position.x, dy = aim.y - drone.position.y;
+    float d = sqrtf(dx*dx + dy*dy);
+    float gdx = goal.x - drone.position.x, gdy = goal.y - drone.position.y;
+    float speed = fminf(ap_speed, 1.5f * sqrtf(gdx*gdx + gdy*gdy));
+    Vec2 v = { 0, 0 };
+    if (d > 1e-3f) { v.x = speed * dx / d; v.y = speed * dy / d; }
+
+    Vec2 f = { K * v.x + 4.0f * (v.x - drone.velocity.x),
+               K * v.y + 4.0f * (v.y - drone.velocity.y) };
+    float mag = sqrtf(f.x*f.x + f.y*f.y);
+    if (mag > ap_force) { f.x *= ap_force / mag; f.y *= ap_force / mag; }
+    return f;
+}
+
+static void report(const char *tag, double elapsed, double window) {
+    char line[256];
+    snprintf(line, sizeof(line),
+             "%s t=%.0fs targets=%ld rate=%.1f/min window=%.1f/min loop=%ld work_avg=%.1fus work_max=%.1fus "
+             "period_avg=%.2fms period_max=%.2fms",
+             tag, elapsed, collected, elapsed > 0 ? collected * 60.0 / elapsed : 0.0,
+             window > 0 ? collected_window * 60.0 / window : 0.0, loops,
+             loops ? work_sum / loops * 1e6 : 0.0, work_max * 1e6,
+             loops > 1 ? period_sum / (loops - 1) * 1e3 : 0.0, period_max * 1e3);
+    printf("[Autopilot] %s\n", line);
+    log_message(SYSTEM_LOG_FILE, "Autopilot", "%s", line);
+    collected_window = 0;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [--duration SEC]\n", prog);
+    printf("  --duration  Stop after SEC seconds and print the summary (default: until Ctrl+C / STOP)\n");
+}
+
+int main(int argc, char *argv[]) {
+    double duration = 0.0;
+    static const struct option options[] = {
+        { "duration", required_argument, NULL, 'd' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:h", options, NULL)) != -1) {
+        if (opt == 'd') duration = atof(optarg);
+        else { usage(argv[0]); return (opt == 'h') ? 0 : 1; }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    register_process("Autopilot");
+    log_message(SYSTEM_LOG_FILE, "Autopilot", "Autopilot started.");
+
+    params_load(PARAMS_FILE);
+    apply_params();
+    for (int i = 0; i < MAX_OBSTACLES; i++) obstacles[i].id = -1;
+    for (int i = 0; i < MAX_TARGETS; i++) { targets[i].id = -1; targets[i].active = 0; }
+
+    // Same channels as the windows: the world in, force commands out
+    Channel *ch_in = chan_open(PIPE_SERVER_TO_AUTOPILOT, CHAN_READ);
+    Channel *ch_out = chan_open(PIPE_UI_TO_SERVER, CHAN_WRITE);
+
+    Message msg, cmd;
+    memset(&cmd, 0, sizeof(Message));
+    cmd.type = MSG_FORCE_UPDATE;
+    cmd.sender_pid = getpid();
+
+    double t_start = get_time_sec(), last_loop = 0.0;
+    double next_report = t_start + AP_REPORT, window_start = t_start;
+    long period_us = (long)(1e6 / ap_rate);
+
+    while (!stop) {
+        double now = get_time_sec();
+        if (duration > 0 && now - t_start >= duration) break;
+
+        // 1. World updates (batches are applied whole)
+        while (chan_recv(ch_in, &msg) > 0) {
+            if (msg.type == MSG_DRONE_STATE) { drone = msg.drone; have_drone = 1; }
+            else if (msg.type == MSG_OBSTACLE) {
+                const Obstacle *list = msg.batch ? chan_batch_items(ch_in) : &msg.obstacle;
+                for (int k = 0; k < (msg.batch ? msg.batch : 1); k++) {
+                    if (list[k].id >= 0 && list[k].id < MAX_OBSTACLES) obstacles[list[k].id] = list[k];
+                }
+            }
+            else if (msg.type == MSG_TARGET) {
+                const Target *list = msg.batch ? chan_batch_items(ch_in) : &msg.target;
+                for (int k = 0; k < (msg.batch ? msg.batch : 1); k++) {
+                    int id = list[k].id;
+                    if (id < 0 || id >= MAX_TARGETS) continue;
+                    // Active -> inactive: Dynamics collected it
+                    if (targets[id].active == 1 && list[k].active == 0) { collected++; collected_window++; }
+                    targets[id] = list[k];
+                }
+            }
+            else if (msg.type == MSG_STOP) stop = 1;
+        }
+
+        // 2. Plan and command (one absolute force per loop, like the Input Window)
+        double work = get_time_sec();
+        int t = next_target();
+        Vec2 f = { 0, 0 };
+        if (have_drone && t >= 0) {
+            plan(targets[t].position, now);
+            f = control(aim_point(targets[t].position), targets[t].position);
+        }
+        cmd.drone.force = f;
+        cmd.seq++;
+        cmd.stamp = now;
+        chan_send(ch_out, &cmd);
+        work = get_time_sec() - work;
+
+        // 3. Loop timing
+        loops++;
+        work_sum += work;
+        if (work > work_max) work_max = work;
+        if (last_loop > 0) {
+            double period = now - last_loop;
+            period_sum += period;
+            if (period > period_max) period_max = period;
+        }
+        last_loop = now;
+
+        if (now >= next_report) {
+            report("report", now - t_start, now - window_start);
+            next_report += AP_REPORT;
+            window_start = now;
+        }
+        usleep(period_us);
+    }
+
+    // Leave the drone coasting, not pushed
+    memset(&cmd.drone, 0, sizeof(DroneState));
+    cmd.seq++;
+    chan_send(ch_out, &cmd);
+
+    report("summary", get_time_sec() - t_start, get_time_sec() - window_start);
+    chan_close(ch_in);
+    chan_close(ch_out);
+    return 0;
+}
@@ -1,147 +1,1040 @@
 #include "common.h"
-#include "socket_manager.h" 
+#include "socket_manager.h"
+#include "router.h"
+#include "params.h"
+#include "channel.h"
+#include "ready.h"
+#include "motion.h"
+#include "net_world.h"
+#include "net_lockstep.h"
+#include "net_aoi.h"
+#include "physics.h"
+#include "field.h"
+#include "metrics.h"
+#include "rt.h"
+#include "trace.h"
 #include <locale.h>
+#include <math.h>
 
 // Global State
 DroneState drone;
 Obstacle obstacles[MAX_OBSTACLES];
 Target targets[MAX_TARGETS];
+Player players[MAX_PLAYERS];
 int obs_count = 0;
+static int local_player = 0;    // Our slot in players[] (client: given by the server)
+static int owns_world = 0;      // Standalone, or server with NET_SYNC world
+static NetPeer *peer = NULL;    // World sync client: the server (NULL: standalone or legacy)
+static NetPeer *clients[MAX_PLAYERS];   // World sync server: one per client slot (0 = us)
+static int client_fd[MAX_PLAYERS];
+static NetSpectators *spectators = NULL;   // World sync server: the read-only viewers
+static int spectating = 0;      // Client with NET_ROLE spectator: we watch, our drone is not in the world
+static NetLockstep *lockstep = NULL;    // Lockstep connection (the simulation runs in Dynamics)
+static PhysicsParams phys;      // Server: to run the clients' inputs
 
-void run_blackboard(int mode) {
+// Change tracking: frame number of the last change of each item.
+// A subscriber gets the items changed since the last frame it received
+// for that topic (or everything when it needs a keyframe).
+static unsigned long frame = 1;   // 0 = never changed
+static unsigned long drone_changed = 0;
+static unsigned long force_changed = 0;
+static unsigned long obs_changed[MAX_OBSTACLES];
+static unsigned long tar_changed[MAX_TARGETS];
+static unsigned long players_changed = 0;
+static unsigned long correction_changed = 0;
+static unsigned long lockstep_changed = 0;
+static unsigned long params_changed = 0;
+// Keys deleted from params.txt: sent alone ("KEY"), so that the
+// subscribers' stores drop them too
+#define PARAMS_REMOVED_MAX 32
+static char params_removed[PARAMS_REMOVED_MAX][PARAM_KEY_LEN];
+static int n_params_removed = 0;
+static unsigned long links_changed = 0;
+
+// Last accepted force command (latest value wins)
+static Message force_cmd;
+// Client: the server's state of our drone, for Dynamics to reconcile
+static Message correction;
+// Lockstep: the session settings, and the peer's inputs (by tick) for Dynamics
+static Message lockstep_start;
+static InputCmd remote_inputs[LOCKSTEP_WINDOW];
+static unsigned long remote_input_changed[LOCKSTEP_WINDOW];
+
+// REMOTE DRONE SMOOTHING
+// The other drones are published NET_INTERP_DELAY behind the newest state
+// received, interpolated between the two states around that time: their
+// states come in steps (20 Hz snapshots, bursts of inputs, 10 Hz legacy
+// exchanges), the windows see them glide. players[] stays authoritative
+// (snapshots, physics); shown[] is what the subscribers get.
+#define REMOTE_SAMPLES 8
+typedef struct { double t; DroneState d; } RemoteSample;
+static RemoteSample remote_samples[MAX_PLAYERS][REMOTE_SAMPLES];   // Oldest first
+static int remote_count[MAX_PLAYERS];
+static Player shown[MAX_PLAYERS];
+static double interp_delay = 0.1;
+
+// Server: client steps further than this ahead of our clock are refused
+#define INPUT_AHEAD_MAX 0.1
+// [FIX] An input is never trusted: at most INPUT_SPAN_MAX of simulated
+// time, run in steps of our own physics step (a client sending 65535
+// steps of 1 us used to stall the loop for everyone)
+#define INPUT_SPAN_MAX  0.05
+static long input_steps = 0, input_steps_refused = 0;
+static float input_dt = DYNAMICS_RATE / 1000000.0f;    // Server physics step (PHYSICS_RATE)
+static double input_until[MAX_PLAYERS];                // End of each player's simulated time (0 = none yet)
+
+// Dynamics -> Blackboard latency (reported with the other stats)
+static double lat_sum = 0.0, lat_max = 0.0;
+static long lat_count = 0;
+
+// METRICS: the hub's own values (the router exports the subscribers').
+// Served with every component's block on METRICS_PORT / METRICS_SOCKET.
+enum { IN_UI, IN_DYNAMICS, IN_OBSTACLES, IN_TARGETS, IN_COUNT };
+static Metric *m_received[IN_COUNT];
+static Metric *m_frames, *m_busy, *m_lat_sum, *m_lat_count, *m_lat_max;
+
+// LINK QUALITY: every connection's round trip, jitter, traffic and
+// queues, read once a second, published as NET_STATS (UI Input) and
+// logged with the 5 s report
+#define LINK_STATS_PERIOD 1.0
+static LinkStats links[MAX_PLAYERS];
+static int link_count = 0;
+
+// Client: pickups predicted by our Dynamics that the server has not
+// confirmed yet (time of the claim, 0 = none)
+#define PICKUP_CONFIRM_TIMEOUT 1.0
+static double pickup_claimed[MAX_TARGETS];
+
+// Applies one Target, or a whole batch of them, by ID.
+// A target going inactive is a point for 'player' (-1: not a pickup).
+static void apply_targets(Channel *ch, const Message *msg, int player) {
+    const Target *list = msg->batch ? chan_batch_items(ch) : &msg->target;
+    for (int k = 0; k < (msg->batch ? msg->batch : 1); k++) {
+        int id = list[k].id;
+        if (id >= 0 && id < MAX_TARGETS) {
+            if (player >= 0 && targets[id].active == 1 && list[k].active == 0) {
+                players[player].score++;
+                players_changed = frame;
+            }
+            targets[id] = list[k];
+            tar_changed[id] = frame;
+        }
+    }
+}
+
+// Server: target pickups of a remote drone, swept along the segment
+// between two of its reports (same rule as Dynamics for the local one).
+static void pickup_along(int player, Vec2 from, Vec2 to) {
+    float t_from = 0.0f;
+    while (1) {
+        int next = -1;
+        for (int i = 0; i < MAX_TARGETS && next < 0; i++) if (targets[i].active == 1) next = i;
+        if (next < 0) return;
+
+        Vec2 c = targets[next].position;
+        Vec2 p0 = { from.x + t_from * (to.x - from.x) - c.x, from.y + t_from * (to.y - from.y) - c.y };
+        Vec2 p1 = { to.x - c.x, to.y - c.y };
+        float t = motion_sweep(p0, p1, TARGET_RADIUS);
+        if (t < 0.0f) return;
+        t_from += t * (1.0f - t_from);
+
+        targets[next].active = 0;
+        tar_changed[next] = frame;
+        players[player].score++;
+        players_changed = frame;
+        log_message(SYSTEM_LOG_FILE, "Blackboard", "Player %d collected target %d (score %d)",
+                    player, next, players[player].score);
+
+        if (next == MAX_TARGETS - 1) {
+            // Level clear: the world owner respawns every target
+            for (int j = 0; j < MAX_TARGETS; j++) {
+                targets[j].position.x = 5 + rand() % (MAP_WIDTH - 10);
+                targets[j].position.y = 5 + rand() % (MAP_HEIGHT - 10);
+                targets[j].active = 1;
+                tar_changed[j] = frame;
+            }
+            log_message(SYSTEM_LOG_FILE, "Blackboard", "LEVEL CLEAR by player %d", player);
+            return;
+        }
+    }
+}
+
+// New authoritative state of a remote drone, valid at time 't'
+static void push_remote(int player, double t, const DroneState *d) {
+    RemoteSample *s = remote_samples[player];
+    if (remote_count[player] == REMOTE_SAMPLES) {
+        memmove(s, s + 1, (REMOTE_SAMPLES - 1) * sizeof(RemoteSample));
+        remote_count[player]--;
+    }
+    s[remote_count[player]].t = t;
+    s[remote_count[player]].d = *d;
+    remote_count[player]++;
+}
+
+// Rebuilds shown[] for time 'now' (players_changed if it moved)
+static void update_shown(double now) {
+    Player next[MAX_PLAYERS];
+    memcpy(next, players, sizeof(next));
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (next[i].id == -1) { remote_count[i] = 0; continue; }
+        // Our own drone travels as DRONE_STATE
+        if (next[i].local) { memset(&next[i].drone, 0, sizeof(DroneState)); continue; }
+        int n = remote_count[i];
+        if (n == 0) continue;
+        RemoteSample *s = remote_samples[i];
+        double t = now - interp_delay;
+        int k = 1;
+        while (k < n && s[k].t < t) k++;
+        if (t <= s[0].t || k == n) {
+            next[i].drone = s[t <= s[0].t ? 0 : n - 1].d;   // Hold the oldest / newest
+        } else {
+            float u = (float)((t - s[k - 1].t) / (s[k].t - s[k - 1].t));
+            next[i].drone = s[k].d;
+            next[i].drone.position.x = s[k - 1].d.position.x + u * (s[k].d.position.x - s[k - 1].d.position.x);
+            next[i].drone.position.y = s[k - 1].d.position.y + u * (s[k].d.position.y - s[k - 1].d.position.y);
+        }
+    }
+    if (memcmp(next, shown, sizeof(next)) != 0) {
+        memcpy(shown, next, sizeof(next));
+        players_changed = frame;
+    }
+}
+
+// Server: runs one input of a client on its drone, step by step at the
+// client's step times, with the same physics step as the client's
+// Dynamics (grid-free repulsion: the field lattice belongs to Dynamics)
+static void simulate_input(int player, const InputCmd *in, double now) {
+    DroneState *d = &players[player].drone;
+    if (!(in->dt > 0.0f)) return;
+    d->force = in->force;
+
+    // 1. Duration asked by the client, in our steps (at most INPUT_SPAN_MAX)
+    double span = (double)in->steps * in->dt;
+    if (span > INPUT_SPAN_MAX) span = INPUT_SPAN_MAX;
+    float dt = input_dt;
+    int steps = (int)lround(span / dt);
+    if (steps < 1) steps = 1;
+    input_steps_refused += (in->steps > steps) ? in->steps - steps : 0;
+
+    // 2. Time only moves forward: an input starting before the end of the
+    // previous one (a t0 in the past) is shifted after it, so the drone
+    // never gets more simulated time than the wall clock gave since then
+    if (input_until[player] <= 0.0) input_until[player] = now;
+    double t0 = in->t0;
+    if (!(t0 >= input_until[player])) t0 = input_until[player];
+
+    Obstacle near[MAX_OBSTACLES + MAX_PLAYERS];
+    int done = 0;
+    for (int k = 0; k < steps; k++) {
+        double t = t0 + k * dt;
+        if (t > now + INPUT_AHEAD_MAX) { input_steps_refused += steps - k; break; }
+        // Obstacles where they are at t, the other drones repel too
+        int n = 0;
+        for (int i = 0; i < obs_count; i++) {
+            if (obstacles[i].id == -1) continue;
+            near[n] = obstacles[i];
+            near[n].position = motion_position(&obstacles[i], t);
+            n++;
+        }
+        for (int j = 0; j < MAX_PLAYERS; j++) {
+            if (j == player || players[j].id == -1) continue;
+            memset(&near[n], 0, sizeof(Obstacle));
+            near[n].id = MAX_OBSTACLES + j;
+            near[n].position = players[j].drone.position;
+            n++;
+        }
+        Vec2 f = field_exact(d->position.x, d->position.y, near, n, phys.rep_rho, phys.rep_eta);
+        const Target *next = NULL;
+        for (int i = 0; i < MAX_TARGETS && !next; i++) if (targets[i].active == 1) next = &targets[i];
+        Vec2 f_att = physics_attraction(&phys, d->position, next);
+        f.x += f_att.x;
+        f.y += f_att.y;
+
+        Vec2 prev = d->position;
+        physics_step(&phys, d, f, dt);
+        physics_resolve_obstacles(&phys, d, prev, obstacles, obs_count, t - dt, t);
+        pickup_along(player, prev, d->position);
+        input_steps++;
+        done++;
+    }
+    input_until[player] = t0 + done * dt;
+    push_remote(player, input_until[player], d);
+}
+
+// Lockstep: Dynamics simulates the whole game, we carry its inputs and
+// checksums to the peer and publish its world like a Generator's
+static void handle_lockstep_msg(Channel *ch, const Message *msg) {
+    unsigned int tick, sum;
+    if (msg->type == MSG_INPUT) net_lockstep_send_input(lockstep, &msg->input);
+    else if (msg->type == MSG_LOCKSTEP && sscanf(msg->info, "check %u %u", &tick, &sum) == 2) {
+        net_lockstep_check(lockstep, tick, sum);
+    }
+    else if (msg->type == MSG_OBSTACLE) {
+        const Obstacle *list = msg->batch ? chan_batch_items(ch) : &msg->obstacle;
+        for (int k = 0; k < (msg->batch ? msg->batch : 1); k++) {
+            int id = list[k].id;
+            if (id >= 0 && id < MAX_OBSTACLES) {
+                obstacles[id] = list[k];
+                obs_changed[id] = frame;
+                if (id >= obs_count) obs_count = id + 1;
+            }
+        }
+    }
+    else if (msg->type == MSG_TARGET) apply_targets(ch, msg, -1);   // Scores come with the table
+    else if (msg->type == MSG_PLAYER && msg->batch) {
+        const Player *list = chan_batch_items(ch);
+        for (int k = 0; k < msg->batch && k < MAX_PLAYERS; k++) players[k] = list[k];
+    }
+}
+
+static void handle_dynamics_msg(Channel *ch, const Message *msg, int mode) {
+    metric_add(m_received[IN_DYNAMICS], 1);
+    if (msg->type != MSG_DRONE_STATE && lockstep) {
+        handle_lockstep_msg(ch, msg);
+        return;
+    }
+    if (msg->type == MSG_DRONE_STATE) {
+        drone = msg->drone;
+        drone_changed = frame;
+        trace_flow_in("drone state", trace_flow_id(msg->sender_pid, msg->stamp));
+        // Our entry of the world (sent in snapshots, not to our own windows)
+        if (local_player >= 0) players[local_player].drone = drone;
+        // End-to-end latency of the Dynamics -> Blackboard path
+        double lat = get_time_sec() - msg->stamp;
+        lat_sum += lat; lat_count++;
+        if (lat > lat_max) lat_max = lat;
+        metric_add(m_lat_sum, lat);
+        metric_add(m_lat_count, 1);
+    }
+    else if (msg->type == MSG_TARGET && owns_world) {
+        apply_targets(ch, msg, (mode == MODE_STANDALONE) ? -1 : local_player);
+    }
+    else if (msg->type == MSG_TARGET && mode == MODE_CLIENT && !spectating) {
+        // A prediction: the server decides. Rolled back if not confirmed.
+        const Target *list = msg->batch ? chan_batch_items(ch) : &msg->target;
+        for (int k = 0; k < (msg->batch ? msg->batch : 1); k++) {
+            int id = list[k].id;
+            if (id >= 0 && id < MAX_TARGETS && !list[k].active && !pickup_claimed[id]) pickup_claimed[id] = get_time_sec();
+        }
+    }
+    else if (msg->type == MSG_INPUT && mode == MODE_CLIENT && peer && !spectating) {
+        // Sent as soon as Dynamics closes it (a failure shows up on the next receive)
+        net_world_send_input(peer, &msg->input);
+    }
+}
+
+// Sends every subscriber the topics that are due this frame
+static void broadcast_state(double now) {
+    Message msg_out;
+    memset(&msg_out, 0, sizeof(Message));
+    msg_out.sender_pid = getpid();
+    msg_out.stamp = now;
+    int flow = 0;
+
+    for (int s = 0; s < n_subscribers; s++) {
+        Subscriber *sub = &subscribers[s];
+        int key = sub->keyframe;
+
+        if (router_due(sub, MSG_DRONE_STATE, now) && (key || drone_changed > sub->sent_frame[MSG_DRONE_STATE])) {
+            msg_out.type = MSG_DRONE_STATE;
+            msg_out.drone = drone;
+            // One arrow per tick (to the Map: the only traced reader)
+            if (!flow++) trace_flow_out("drone state", trace_flow_id(msg_out.sender_pid, now));
+            router_send(sub, &msg_out);
+            router_sent(sub, MSG_DRONE_STATE, frame, now);
+        }
+
+        if (router_due(sub, MSG_FORCE_UPDATE, now) && force_changed > 0 &&
+            (key || force_changed > sub->sent_frame[MSG_FORCE_UPDATE])) {
+            router_send(sub, &force_cmd);
+            router_sent(sub, MSG_FORCE_UPDATE, frame, now);
+        }
+
+        // Obstacles and targets: everything that changed in one batch frame
+        // (nothing changed: no frame, the rate slot stays free)
+        if (router_due(sub, MSG_OBSTACLE, now)) {
+            Obstacle list[MAX_OBSTACLES];
+            int n = 0;
+            for (int i = 0; i < MAX_OBSTACLES; i++) {
+                if (obstacles[i].id != -1 && (key || obs_changed[i] > sub->sent_frame[MSG_OBSTACLE])) list[n++] = obstacles[i];
+            }
+            msg_out.type = MSG_OBSTACLE;
+            router_send_batch(sub, &msg_out, list, n);
+            if (n > 0) router_sent(sub, MSG_OBSTACLE, frame, now);
+        }
+
+        if (router_due(sub, MSG_TARGET, now)) {
+            Target list[MAX_TARGETS];
+            int n = 0;
+            for (int i = 0; i < MAX_TARGETS; i++) {
+                if (targets[i].id != -1 && (key || tar_changed[i] > sub->sent_frame[MSG_TARGET])) list[n++] = targets[i];
+            }
+            msg_out.type = MSG_TARGET;
+            router_send_batch(sub, &msg_out, list, n);
+            if (n > 0) router_sent(sub, MSG_TARGET, frame, now);
+        }
+
+        // Players: the whole table when anything changed (index = slot).
+        // info "inputs": we are a world sync client, Dynamics sends us its
+        // closed inputs (nobody else reads them)
+        if (router_due(sub, MSG_PLAYER, now) && players_changed > 0 &&
+            (key || players_changed > sub->sent_frame[MSG_PLAYER])) {
+            msg_out.type = MSG_PLAYER;
+            snprintf(msg_out.info, sizeof(msg_out.info), "%s", (peer && !spectating) ? "inputs" : "");
+            router_send_batch(sub, &msg_out, shown, MAX_PLAYERS);
+            router_sent(sub, MSG_PLAYER, frame, now);
+        }
+
+        // Lockstep: session settings (kept for keyframes), peer inputs
+        if (router_due(sub, MSG_LOCKSTEP, now) && lockstep_changed > 0 &&
+            (key || lockstep_changed > sub->sent_frame[MSG_LOCKSTEP])) {
+            router_send(sub, &lockstep_start);
+            router_sent(sub, MSG_LOCKSTEP, frame, now);
+        }
+        if (router_due(sub, MSG_NET_STATS, now) && links_changed > 0 &&
+            (key || links_changed > sub->sent_frame[MSG_NET_STATS])) {
+            msg_out.type = MSG_NET_STATS;
+            router_send_batch(sub, &msg_out, links, link_count);
+            router_sent(sub, MSG_NET_STATS, frame, now);
+        }
+        if (router_due(sub, MSG_INPUT, now) && lockstep) {
+            InputCmd list[LOCKSTEP_WINDOW];
+            int n = 0;
+            for (int i = 0; i < LOCKSTEP_WINDOW; i++) {
+                if (remote_input_changed[i] > 0 && (key || remote_input_changed[i] > sub->sent_frame[MSG_INPUT])) list[n++] = remote_inputs[i];
+            }
+            msg_out.type = MSG_INPUT;
+            router_send_batch(sub, &msg_out, list, n);
+            if (n > 0) router_sent(sub, MSG_INPUT, frame, now);
+        }
+
+        // Server correction of our drone: only the newest matters
+        if (router_due(sub, MSG_CORRECTION, now) && correction_changed > sub->sent_frame[MSG_CORRECTION]) {
+            router_send(sub, &correction);
+            router_sent(sub, MSG_CORRECTION, frame, now);
+        }
+
+        // Parameters: the whole store (a handful of keys) when anything changed
+        if (router_due(sub, MSG_PARAM, now) && (key || params_changed > sub->sent_frame[MSG_PARAM])) {
+            char pkey[PARAM_KEY_LEN], pval[PARAM_VAL_LEN];
+            int iter = 0;
+            msg_out.type = MSG_PARAM;
+            while (param_next(&iter, pkey, pval)) {
+                // A long path does not fit in 'info': the subscribers do not
+                // use those, and a cut copy would overwrite the shared store
+                // (threads mode)
+                if (snprintf(msg_out.info, sizeof(msg_out.info), "%s %s", pkey, pval) >= (int)sizeof(msg_out.info)) continue;
+                router_send(sub, &msg_out);
+            }
+            for (int i = 0; i < n_params_removed; i++) {
+                snprintf(msg_out.info, sizeof(msg_out.info), "%s", params_removed[i]);
+                router_send(sub, &msg_out);
+            }
+            router_sent(sub, MSG_PARAM, frame, now);
+        }
+    }
+}
+
+// Same step and limits as Dynamics (apply_params)
+static void load_input_step(void) {
+    float rate = param_get_float("PHYSICS_RATE", 1000000.0f / DYNAMICS_RATE);
+    if (rate < 10.0f) rate = 10.0f;
+    if (rate > 5000.0f) rate = 5000.0f;
+    input_dt = 1.0f / rate;
+}
+
+static void on_param_changed(const char *key, const char *value) {
+    int found = -1;
+    for (int i = 0; i < n_params_removed; i++) {
+        if (strcmp(params_removed[i], key) == 0) found = i;
+    }
+    if (value) {
+        log_message(SYSTEM_LOG_FILE, "Blackboard", "Parameter %s changed to %s", key, value);
+        if (found >= 0) memcpy(params_removed[found], params_removed[--n_params_removed], PARAM_KEY_LEN);
+    } else {
+        log_message(SYSTEM_LOG_FILE, "Blackboard", "Parameter %s removed (default applies)", key);
+        if (found < 0 && n_params_removed < PARAMS_REMOVED_MAX) snprintf(params_removed[n_params_removed++], PARAM_KEY_LEN, "%s", key);
+    }
+    params_changed = frame;
+    physics_load(&phys);
+    load_input_step();
+    interp_delay = param_get_float("NET_INTERP_DELAY", 0.1f);
+}
+
+// WORLD SYNC SERVER: the clients
+// A player may join the running session (world sync only): it takes the
+// first free slot. A client leaving frees its slot, the session goes on.
+// Spectators only get the shared stream (net_world.h).
+static void add_spectator(int fd) {
+    if (!spectators) spectators = net_spectators_create();
+    if (!spectators || net_spectators_add(spectators, fd) < 0) {
+        log_message(SYSTEM_LOG_FILE, "Blackboard", "Spectator refused (too many)");
+        close(fd);
+        return;
+    }
+    log_message(SYSTEM_LOG_FILE, "Blackboard", "Spectator joined");
+}
+
+static void accept_players(double now) {
+    int fd, proto;
+    join_poll("world spectate", now);
+    while ((fd = join_take(&proto)) >= 0) {
+        if (proto == NET_PROTO_SPECTATE) {
+            add_spectator(fd);
+            continue;
+        }
+        int slot = 1;
+        while (slot < MAX_PLAYERS && clients[slot]) slot++;
+        // Full, or an old client that cannot share a world: refused
+        if (slot == MAX_PLAYERS || proto != NET_PROTO_WORLD || !(clients[slot] = net_world_open(fd, MODE_SERVER))) {
+            log_message(SYSTEM_LOG_FILE, "Blackboard", "Player refused (%s)", slot == MAX_PLAYERS ? "session full" : "no world sync");
+            close(fd);
+            continue;
+        }
+        client_fd[slot] = fd;
+        log_message(SYSTEM_LOG_FILE, "Blackboard", "Player %d joined", slot);
+    }
+}
+
+static void drop_client(int slot) {
+    net_world_close(clients[slot]);
+    close(client_fd[slot]);
+    clients[slot] = NULL;
+    players[slot].id = -1;
+    input_until[slot] = 0.0;
+    players_changed = frame;
+    log_message(SYSTEM_LOG_FILE, "Blackboard", "Player %d left", slot);
+}
+
+// AREA OF INTEREST (net_aoi.h): each client gets the drones within
+// NET_AOI_RADIUS of its own in every snapshot, the others at
+// NET_AOI_FAR_RATE (0: not at all)
+static AoiGrid aoi;
+static double aoi_next_far[MAX_PLAYERS];
+static double round_time = 0.0;         // Snapshot rounds: index, queries, encoding (reported)
+static unsigned long rounds = 0, round_clients = 0, aoi_near = 0;
+
+static void send_snapshots(double now) {
+    float radius = param_get_float("NET_AOI_RADIUS", NET_AOI_RADIUS);
+    float far_rate = param_get_float("NET_AOI_FAR_RATE", NET_AOI_FAR_RATE);
+    double start = get_time_sec();
+    aoi_build(&aoi, players, radius);
+    for (int slot = 1; slot < MAX_PLAYERS; slot++) {
+        if (!clients[slot]) continue;
+        Player view[MAX_PLAYERS];
+        memcpy(view, players, sizeof(view));
+        unsigned int due = 1u << slot;
+        if (players[slot].id != -1) {
+            unsigned int near = aoi_query(&aoi, players[slot].drone.position, radius);
+            aoi_near += __builtin_popcount(near & ~due);
+            due |= near;
+            if (far_rate <= 0.0f) {
+                for (int i = 0; i < MAX_PLAYERS; i++) if (!(due & (1u << i))) view[i].id = -1;
+            } else if (now >= aoi_next_far[slot]) {
+                aoi_next_far[slot] = now + 1.0 / far_rate;
+                due = ~0u;
+            }
+        }
+        round_clients++;
+        if (net_world_send_snapshot(clients[slot], now, slot, view, due, obstacles, targets) < 0) drop_client(slot);
+    }
+    round_time += get_time_sec() - start;
+    rounds++;
+    if (spectators) net_spectators_send(spectators, now, players, obstacles, targets);
+}
+
+static void collect_link_stats(int proto, int sockfd) {
+    link_count = 0;
+    if (peer) net_world_link_stats(peer, &links[link_count++]);
+    for (int slot = 1; slot < MAX_PLAYERS; slot++) {
+        if (clients[slot] && link_count < MAX_PLAYERS) net_world_link_stats(clients[slot], &links[link_count++]);
+    }
+    if (lockstep) net_lockstep_link_stats(lockstep, &links[link_count++]);
+    if (proto == NET_PROTO_LEGACY && sockfd >= 0) network_link_stats(sockfd, &links[link_count++]);
+    links_changed = frame;
+    for (int i = 0; i < link_count; i++) {
+        char labels[48];
+        if (links[i].peer >= 0) snprintf(labels, sizeof(labels), "peer=\"%d\"", links[i].peer);
+        else snprintf(labels, sizeof(labels), "peer=\"peer\"");
+        metric_set(metric_gauge("drone_link_rtt_seconds", labels, "Smoothed round trip of the connection"), links[i].rtt_ms / 1000.0);
+        metric_set(metric_gauge("drone_link_send_queue_bytes", labels, "Bytes in the socket send queue"), links[i].send_queue);
+    }
+}
+
+static void report_link_stats() {
+    for (int i = 0; i < link_count; i++) {
+        const LinkStats *l = &links[i];
+        char who[32];
+        if (l->peer >= 0) snprintf(who, sizeof(who), "player %d", l->peer);
+        else snprintf(who, sizeof(who), "the peer");
+        log_message(SYSTEM_LOG_FILE, "Blackboard",
+                    "Link to %s: RTT %.1f ms (jitter %.1f, last second %.1f-%.1f), in %.0f B/s (%.0f msg/s), "
+                    "out %.0f B/s (%.0f msg/s), send queue %d B, %u pings lost, %u TCP retransmits",
+                    who, l->rtt_ms, l->jitter_ms, l->rtt_min_ms, l->rtt_max_ms, l->bytes_in, l->msgs_in,
+                    l->bytes_out, l->msgs_out, l->send_queue, l->lost, l->retrans);
+    }
+}
+
+// ip: server address in client mode (NULL = ask on stdin)
+void run_blackboard(int mode, const char *ip) {
     setlocale(LC_NUMERIC, "C");
     register_process("Blackboard");
     log_message(SYSTEM_LOG_FILE, "Blackboard", "Started in mode %d", mode);
 
     for (int i = 0; i < MAX_OBSTACLES; i++) obstacles[i].id = -1;
     for (int i = 0; i < MAX_TARGETS; i++) { targets[i].id = -1; targets[i].active = 0; }
+    for (int i = 0; i < MAX_PLAYERS; i++) players[i].id = shown[i].id = -1;
+
+    // Parameters: parsed once by Main, then pushed to subscribers when the file changes
+    int params_fd = params_watch(PARAMS_FILE);
+    physics_load(&phys);
+    load_input_step();
+    interp_delay = param_get_float("NET_INTERP_DELAY", 0.1f);
+    rt_apply("Blackboard");
+    trace_init("Blackboard");
+
+    // NET_SYNC world: the server runs the generators and owns the world,
+    // clients get it through snapshots (net_world.c)
+    // NET_SYNC lockstep: each Dynamics simulates everything (no generators)
+    char net_sync[PARAM_VAL_LEN], net_role[PARAM_VAL_LEN];
+    param_get_str("NET_SYNC", "world", net_sync, sizeof(net_sync));
+    int want_world = (mode != MODE_STANDALONE && strcmp(net_sync, "world") == 0);
+    int want_lockstep = (mode != MODE_STANDALONE && strcmp(net_sync, "lockstep") == 0);
+    owns_world = (mode == MODE_STANDALONE) || (mode == MODE_SERVER && want_world);
+    // NET_ROLE spectator: a world sync client that only watches
+    spectating = (mode == MODE_CLIENT && want_world && strcmp(param_get_str("NET_ROLE", "player", net_role, sizeof(net_role)), "spectator") == 0);
 
     // Pipe Setup
-    int fd_ui_in, fd_dyn_in, fd_obs_in, fd_tar_in;
-    int fd_ui_out, fd_ui_input_out, fd_dyn_out;
+    // Inputs are channels: FIFO, shared-memory ring or (threads mode) in-process ring
+    Channel *ch_ui_in, *ch_dyn_in, *ch_obs_in = NULL, *ch_tar_in = NULL;
+
+    ch_ui_in = chan_open(PIPE_UI_TO_SERVER, CHAN_READ);
+    ch_dyn_in = chan_open(PIPE_DYN_TO_SERVER, CHAN_READ);
+
+    if (owns_world) {
+        ch_obs_in = chan_open(PIPE_OBS_TO_SERVER, CHAN_READ);
+        ch_tar_in = chan_open(PIPE_TAR_TO_SERVER, CHAN_READ);
+    }
 
-    while ((fd_ui_in = open(PIPE_UI_TO_SERVER, O_RDONLY | O_NONBLOCK)) < 0) usleep(1000);
-    while ((fd_dyn_in = open(PIPE_DYN_TO_SERVER, O_RDONLY | O_NONBLOCK)) < 0) usleep(1000);
-    
-    if (mode == MODE_STANDALONE) {
-        while ((fd_obs_in = open(PIPE_OBS_TO_SERVER, O_RDONLY | O_NONBLOCK)) < 0) usleep(1000);
-        while ((fd_tar_in = open(PIPE_TAR_TO_SERVER, O_RDONLY | O_NONBLOCK)) < 0) usleep(1000);
+    // Metrics: our block first, the router registers its values in it
+    metrics_attach("blackboard");
+    const char *in_names[IN_COUNT] = { "ui", "dynamics", "obstacles", "targets" };
+    for (int i = 0; i < IN_COUNT; i++) {
+        char labels[48];
+        snprintf(labels, sizeof(labels), "input=\"%s\"", in_names[i]);
+        m_received[i] = metric_counter("drone_blackboard_received_total", labels, "Messages read per input channel");
+    }
+    m_frames = metric_counter("drone_blackboard_frames_total", NULL, "Hub ticks");
+    m_busy = metric_counter("drone_blackboard_busy_seconds_total", NULL, "Time spent in ticks (not waiting)");
+    m_lat_sum = metric_counter("drone_dynamics_latency_seconds_sum", NULL, "Dynamics->Blackboard latency, summed");
+    m_lat_count = metric_counter("drone_dynamics_latency_seconds_count", NULL, "Drone states measured");
+    m_lat_max = metric_gauge("drone_dynamics_latency_max_seconds", NULL, "Worst latency of the last report period");
+    int metrics_port = param_get_int("METRICS_PORT", METRICS_PORT);
+    char metrics_socket[PARAM_VAL_LEN];
+    param_get_str("METRICS_SOCKET", METRICS_SOCKET, metrics_socket, sizeof(metrics_socket));
+    if (metrics_serve(metrics_port, metrics_socket) == 0) {
+        log_message(SYSTEM_LOG_FILE, "Blackboard", "Metrics on http://127.0.0.1:%d/metrics and %s", metrics_port, metrics_socket);
+    } else {
+        log_message(SYSTEM_LOG_FILE, "Blackboard", "Metrics endpoint unavailable (port %d, socket %s)", metrics_port, metrics_socket);
     }
 
-    mkfifo(PIPE_SERVER_TO_UI_INPUT, 0666);
-    mkfifo(PIPE_SERVER_TO_MAP, 0666);
-    mkfifo(PIPE_SERVER_TO_DYN, 0666);
-    
-    fd_ui_out = open(PIPE_SERVER_TO_MAP, O_WRONLY);
-    fd_ui_input_out = open(PIPE_SERVER_TO_UI_INPUT, O_WRONLY);
-    fd_dyn_out = open(PIPE_SERVER_TO_DYN, O_WRONLY);
+    // Outputs: one subscriber per line of config/topics.txt.
+    // They attach lazily in the main loop (never block on a missing reader).
+    router_load(TOPICS_FILE);
+    // Detachable windows (--attach) subscribe on a Unix socket instead
+    char viewer_socket[PARAM_VAL_LEN];
+    param_get_str("VIEWER_SOCKET", VIEWER_SOCKET, viewer_socket, sizeof(viewer_socket));
+    if (router_listen(viewer_socket) == 0) {
+        log_message(SYSTEM_LOG_FILE, "Blackboard", "Viewers attach on %s", viewer_socket);
+    } else {
+        log_message(SYSTEM_LOG_FILE, "Blackboard", "Viewer socket %s unavailable (%s)", viewer_socket, strerror(errno));
+    }
+    double next_stats = get_time_sec() + 5.0;
+    ready_signal(READY_BLACKBOARD);
 
     // Network Setup
     int sockfd = -1;
+    int proto = NET_PROTO_LEGACY;
     if (mode != MODE_STANDALONE) {
         int port = SERVER_PORT;
-        sockfd = init_network(mode, &port);
+        sockfd = init_network(mode, &port, ip);
         if (sockfd < 0) {
             log_message(SYSTEM_LOG_FILE, "Blackboard", "Network Init Failed!");
+            ready_fail(READY_FIRST_FRAME);
             exit(1);
         }
-        if (sync_handshake(mode, sockfd) < 0) {
+        // The server offers world sync to players and spectators alike
+        const char *caps = want_world ? (mode == MODE_SERVER ? "world spectate" : (spectating ? "spectate" : "world")) :
+                           (want_lockstep ? "lockstep" : NULL);
+        proto = sync_handshake(mode, sockfd, caps);
+        // [FIX] NET_SYNC world: our generators build a world that a legacy
+        // peer never receives, so the two sides would play in different
+        // worlds. Refused like a legacy player joining later; the next
+        // client may connect.
+        while (mode == MODE_SERVER && want_world && proto == NET_PROTO_LEGACY) {
+            log_message(SYSTEM_LOG_FILE, "Blackboard", "Player refused (no world sync), waiting for another");
+            close(sockfd);
+            sockfd = accept_next();
+            proto = (sockfd >= 0) ? sync_handshake(mode, sockfd, caps) : -1;
+        }
+        if (proto < 0) {
             log_message(SYSTEM_LOG_FILE, "Blackboard", "Handshake Failed!");
+            ready_fail(READY_FIRST_FRAME);
             close(sockfd);
             exit(1);
         }
+        log_message(SYSTEM_LOG_FILE, "Blackboard", "Network protocol: %s",
+                    proto == NET_PROTO_WORLD ? "world (delta snapshots)" :
+                    proto == NET_PROTO_SPECTATE ? "spectate (shared world stream)" :
+                    proto == NET_PROTO_LOCKSTEP ? "lockstep (inputs only)" : "legacy");
+        if ((proto == NET_PROTO_WORLD || proto == NET_PROTO_SPECTATE) && mode == MODE_CLIENT) peer = net_world_open(sockfd, mode);
+        if (proto == NET_PROTO_SPECTATE && mode == MODE_SERVER) {
+            // The first to connect only watches: the players come later
+            add_spectator(sockfd);
+            sockfd = -1;
+            proto = NET_PROTO_WORLD;
+        }
+        else if (proto == NET_PROTO_WORLD && mode == MODE_SERVER) {
+            // The first client is player 1; more may join (accept_players)
+            clients[1] = net_world_open(sockfd, mode);
+            client_fd[1] = sockfd;
+            sockfd = -1;
+            log_message(SYSTEM_LOG_FILE, "Blackboard", "Player 1 joined");
+        }
+        else if (mode == MODE_SERVER) stop_listening();   // One opponent only
+        if (proto != NET_PROTO_SPECTATE) spectating = 0;
+        if (proto == NET_PROTO_LOCKSTEP) {
+            // The server chooses the session; both Dynamics start from it
+            LockstepConfig cfg;
+            unsigned int seed = (unsigned int)param_get_int("LOCKSTEP_SEED", 0);
+            cfg.seed = seed ? seed : (unsigned int)(time(NULL) ^ getpid());
+            cfg.rate = param_get_int("LOCKSTEP_RATE", LOCKSTEP_RATE);
+            if (cfg.rate < 10) cfg.rate = 10;
+            if (cfg.rate > 500) cfg.rate = 500;
+            cfg.substeps = (int)lroundf(param_get_float("PHYSICS_RATE", 1000000.0f / DYNAMICS_RATE) / cfg.rate);
+            if (cfg.substeps < 1) cfg.substeps = 1;
+            cfg.delay = param_get_int("LOCKSTEP_DELAY", LOCKSTEP_DELAY);
+            if (cfg.delay < 0) cfg.delay = 0;
+            if (cfg.delay > LOCKSTEP_WINDOW / 2) cfg.delay = LOCKSTEP_WINDOW / 2;
+            lockstep = net_lockstep_open(sockfd, mode, &cfg);
+            if (lockstep) {
+                local_player = (mode == MODE_SERVER) ? 0 : 1;
+                lockstep_start.type = MSG_LOCKSTEP;
+                lockstep_start.sender_pid = getpid();
+                snprintf(lockstep_start.info, sizeof(lockstep_start.info), "start %u %d %d %d %d",
+                         cfg.seed, local_player, cfg.rate, cfg.substeps, cfg.delay);
+                lockstep_changed = frame;
+                log_message(SYSTEM_LOG_FILE, "Blackboard", "Lockstep session: seed %u, %d ticks/s, %d steps/tick, delay %d",
+                            cfg.seed, cfg.rate, cfg.substeps, cfg.delay);
+            }
+        }
+        if ((proto == NET_PROTO_WORLD && !peer && !clients[1] && !spectators) || (proto == NET_PROTO_LOCKSTEP && !lockstep) ||
+            (proto == NET_PROTO_SPECTATE && !peer)) {
+            ready_fail(READY_FIRST_FRAME);
+            exit(1);
+        }
+        // Server: slot 0, the first client slot 1 (a world client learns
+        // its slot from the snapshots; legacy peers use 0 and 1 too)
+        if (!(mode == MODE_CLIENT && peer) && !lockstep) {
+            players[0].id = 0;
+            players[0].local = 1;
+            players_changed = frame;
+        }
+        // A world client: the first player table tells Dynamics to send its inputs
+        if (mode == MODE_CLIENT && peer && !spectating) players_changed = frame;
     }
+    int first_frame = 0;
+    int remote_seen = 0;        // Network: first snapshot / opponent position received
 
-    Message msg_in, msg_out;
+    Message msg_in;
     int running = 1;
     Obstacle opponent = {0};
-    opponent.id = 0; 
+    opponent.id = 0;
+    double net_interval = 1.0 / param_get_float("NET_SNAPSHOT_RATE", NET_SNAPSHOT_RATE);
+    double next_net = 0.0;
+    double next_links = get_time_sec() + LINK_STATS_PERIOD;
+
+    // Force commands: only the newest one per tick is forwarded to Dynamics
+    unsigned int last_force_seq = 0;
+    int last_force_pid = 0;
 
     // Rate Limiting
     int net_tick = 0;
-    const int NET_RATE = 10; 
+    const int NET_RATE = 10;
+
+    // Ticks on absolute deadlines (the wait ends on the deadline, not
+    // on a 10 ms sleep after the work); lateness reported as jitter
+    RtLoop tick;
+    rt_loop_start(&tick, 10000000L);
+    double deadline = get_time_sec();
 
     // MAIN LOOP
+    frame = 1;
     while (running) {
+        double now = get_time_sec();
+        if (frame > 1) rt_loop_record(&tick, now - deadline);
+        router_begin_frame(now);
+        params_poll(params_fd, PARAMS_FILE, on_param_changed);
+
         // A. Read Local Inputs
-        while (read(fd_ui_in, &msg_in, sizeof(Message)) > 0) {
-            if (msg_in.type == MSG_STOP) running = 0;
-            else if (msg_in.type == MSG_FORCE_UPDATE) write(fd_dyn_out, &msg_in, sizeof(Message));
-        }
-        while (read(fd_dyn_in, &msg_in, sizeof(Message)) > 0) {
-            if (msg_in.type == MSG_DRONE_STATE) drone = msg_in.drone;
-            else if (msg_in.type == MSG_TARGET && mode == MODE_STANDALONE) {
-                if (msg_in.target.id < MAX_TARGETS) targets[msg_in.target.id] = msg_in.target;
+        trace_begin("read");
+        // The Input Window's FIFO, then the viewers' sockets (an attached
+        // Input Window sends the same commands, STOP included)
+        while (chan_recv(ch_ui_in, &msg_in) > 0 || router_recv(&msg_in) > 0) {
+            metric_add(m_received[IN_UI], 1);
+            if (msg_in.type == MSG_STOP) {
+                // Close the other windows too
+                router_publish(&msg_in);
+                running = 0;
+            }
+            else if (msg_in.type == MSG_FORCE_UPDATE && !spectating) {   // A spectator's drone stays parked
+                // Drop stale commands (a restarted Input Window starts a new sequence)
+                if (msg_in.sender_pid == last_force_pid && !seq_is_newer(msg_in.seq, last_force_seq)) continue;
+                last_force_pid = msg_in.sender_pid;
+                last_force_seq = msg_in.seq;
+                force_cmd = msg_in;
+                force_changed = frame;
             }
         }
+        while (chan_recv(ch_dyn_in, &msg_in) > 0) handle_dynamics_msg(ch_dyn_in, &msg_in, mode);
 
         // B. Handle Environment
-        if (mode == MODE_STANDALONE) {
-            while (read(fd_obs_in, &msg_in, sizeof(Message)) > 0) {
-                int id = msg_in.obstacle.id;
-                if (id >= 0 && id < MAX_OBSTACLES) {
-                    obstacles[id] = msg_in.obstacle;
-                    if (id >= obs_count) obs_count = id + 1;
+        if (owns_world) {
+            while (chan_recv(ch_obs_in, &msg_in) > 0) {
+                metric_add(m_received[IN_OBSTACLES], 1);
+                const Obstacle *list = msg_in.batch ? chan_batch_items(ch_obs_in) : &msg_in.obstacle;
+                for (int k = 0; k < (msg_in.batch ? msg_in.batch : 1); k++) {
+                    int id = list[k].id;
+                    if (id >= 0 && id < MAX_OBSTACLES) {
+                        obstacles[id] = list[k];
+                        obs_changed[id] = frame;
+                        if (id >= obs_count) obs_count = id + 1;
+                    }
+                }
+            }
+            while (chan_recv(ch_tar_in, &msg_in) > 0) {
+                metric_add(m_received[IN_TARGETS], 1);
+                apply_targets(ch_tar_in, &msg_in, -1);
+            }
+        }
+        trace_end("read");
+        trace_begin("network");
+        if (mode == MODE_SERVER && proto == NET_PROTO_WORLD) {
+            // WORLD SYNC (server): client inputs in (run on their drones),
+            // delta snapshots out
+            accept_players(now);
+            for (int slot = 1; slot < MAX_PLAYERS; slot++) {
+                if (!clients[slot]) continue;
+                InputCmd inputs[64];
+                int rc;
+                while ((rc = net_world_recv_inputs(clients[slot], inputs, 64)) > 0) {
+                    if (players[slot].id == -1) {
+                        // Same start as a Dynamics process
+                        memset(&players[slot], 0, sizeof(Player));
+                        players[slot].id = slot;
+                        players[slot].drone.position.x = MAP_WIDTH / 2;
+                        players[slot].drone.position.y = MAP_HEIGHT / 2;
+                    }
+                    for (int k = 0; k < rc; k++) simulate_input(slot, &inputs[k], now);
+                    players_changed = frame;
+                    remote_seen = 1;
+                    if (rc < 64) break;
                 }
+                if (rc < 0) drop_client(slot);
             }
-            while (read(fd_tar_in, &msg_in, sizeof(Message)) > 0) {
-                 if (msg_in.target.id < MAX_TARGETS) targets[msg_in.target.id] = msg_in.target;
+            if (now >= next_net) {
+                next_net = now + net_interval;
+                send_snapshots(now);
             }
-        } 
-        else {
-            // NETWORK LOGIC
+        }
+        else if (mode == MODE_CLIENT && peer) {
+            // WORLD SYNC (client): the server's world replaces ours
+            WorldChanges changed;
+            int rc = net_world_recv_snapshot(peer, now, players, obstacles, targets, &changed);
+            if (rc > 0) {
+                remote_seen = 1;
+                local_player = net_world_player(peer);
+                for (int i = 0; i < MAX_OBSTACLES; i++) {
+                    if (!(changed.obstacles & (1u << i))) continue;
+                    obs_changed[i] = frame;
+                    if (obstacles[i].id != -1 && i >= obs_count) obs_count = i + 1;
+                }
+                for (int i = 0; i < MAX_TARGETS; i++) {
+                    if (!(changed.targets & (1u << i))) continue;
+                    tar_changed[i] = frame;
+                    pickup_claimed[i] = 0;
+                }
+                for (int i = 0; i < MAX_PLAYERS; i++) {
+                    if ((changed.players & (1u << i)) && i != local_player && players[i].id != -1) push_remote(i, now, &players[i].drone);
+                }
+                if (local_player >= 0 && local_player < MAX_PLAYERS) players[local_player].drone = drone;
+                // The server's state of our drone after our last input it ran
+                DroneState auth;
+                unsigned int ack = net_world_input_ack(peer, &auth);
+                if (ack && ack != correction.seq) {
+                    correction.type = MSG_CORRECTION;
+                    correction.sender_pid = getpid();
+                    correction.seq = ack;
+                    correction.drone = auth;
+                    correction_changed = frame;
+                }
+            }
+            // Predicted pickups the server did not confirm: give the
+            // server's version back to Dynamics
+            for (int i = 0; i < MAX_TARGETS; i++) {
+                if (pickup_claimed[i] && now - pickup_claimed[i] > PICKUP_CONFIRM_TIMEOUT) {
+                    tar_changed[i] = frame;
+                    pickup_claimed[i] = 0;
+                }
+            }
+            if (rc < 0) {
+                log_message(SYSTEM_LOG_FILE, "Blackboard", "Connection lost.");
+                if (!first_frame) ready_fail(READY_FIRST_FRAME);
+                running = 0;
+            }
+        }
+        else if (lockstep) {
+            // LOCKSTEP: the peer's inputs go to Dynamics, by tick
+            InputCmd inputs[64];
+            int rc;
+            while ((rc = net_lockstep_recv(lockstep, inputs, 64)) > 0) {
+                for (int k = 0; k < rc; k++) {
+                    int i = inputs[k].seq % LOCKSTEP_WINDOW;
+                    remote_inputs[i] = inputs[k];
+                    remote_input_changed[i] = frame;
+                }
+                remote_seen = 1;
+                if (rc < 64) break;
+            }
+            if (rc < 0) {
+                log_message(SYSTEM_LOG_FILE, "Blackboard", "Connection lost.");
+                if (!first_frame) ready_fail(READY_FIRST_FRAME);
+                running = 0;
+            }
+        }
+        else if (mode != MODE_STANDALONE) {
+            // NETWORK LOGIC (legacy text protocol)
             net_tick++;
             if (net_tick >= NET_RATE) {
                 net_tick = 0;
-                if (network_exchange(mode, sockfd, &drone, &opponent) == 0) {
-                    obs_count = 1;
-                    obstacles[0] = opponent; 
-                    obstacles[0].id = 0;
+                trace_begin("network_exchange");
+                int rc = network_exchange(mode, sockfd, &drone, &opponent);
+                trace_end("network_exchange");
+                if (rc == 0) {
+                    // The other drone is player 1
+                    players[1].id = 1;
+                    players[1].drone.position = opponent.position;
+                    push_remote(1, now, &players[1].drone);
+                    remote_seen = 1;
                 } else {
                     // [FIX] IF NETWORK FAILS, STOP THE LOOP.
                     // This stops the "Broken pipe" spam.
                     log_message(SYSTEM_LOG_FILE, "Blackboard", "Connection lost.");
-                    running = 0; 
+                    if (!first_frame) ready_fail(READY_FIRST_FRAME);
+                    running = 0;
                 }
             }
         }
 
+        trace_end("network");
+
         // C. Broadcast State
-        msg_out.type = MSG_DRONE_STATE;
-        msg_out.drone = drone;
-        write(fd_ui_input_out, &msg_out, sizeof(Message));
-        write(fd_ui_out, &msg_out, sizeof(Message));
+        // Each subscriber gets only its topics, at its rate, and only what changed
+        trace_begin("broadcast");
+        update_shown(now);
+        if (running) broadcast_state(now);
+        trace_end("broadcast");
 
-        msg_out.type = MSG_OBSTACLE;
-        int scan_limit = (mode == MODE_STANDALONE) ? MAX_OBSTACLES : 1;
-        
-        for (int i = 0; i < scan_limit; i++) {
-            if (obstacles[i].id != -1) {
-                msg_out.obstacle = obstacles[i];
-                write(fd_ui_out, &msg_out, sizeof(Message));
-                write(fd_dyn_out, &msg_out, sizeof(Message));
-            }
+        // First complete world (drone from Dynamics + obstacles/targets): tell Main
+        if (!first_frame && drone_changed > 0 &&
+            (owns_world ? (obs_count > 0 && targets[0].id != -1) : remote_seen)) {
+            first_frame = 1;
+            ready_signal(READY_FIRST_FRAME);
         }
 
-        if (mode == MODE_STANDALONE) {
-            msg_out.type = MSG_TARGET;
-            for (int i = 0; i < MAX_TARGETS; i++) {
-                msg_out.target = targets[i];
-                write(fd_ui_out, &msg_out, sizeof(Message));  
-                write(fd_dyn_out, &msg_out, sizeof(Message)); 
+        if (mode != MODE_STANDALONE && now >= next_links) {
+            next_links = now + LINK_STATS_PERIOD;
+            collect_link_stats(proto, sockfd);
+        }
+
+        // Periodic backpressure report
+        if (now >= next_stats) {
+            next_stats = now + 5.0;
+            router_report();
+            rt_loop_report(&tick, "Blackboard");
+            report_link_stats();
+            if (peer) net_world_report(peer, "Blackboard");
+            if (spectators) net_spectators_report(spectators, "Blackboard");
+            int n_clients = 0;
+            for (int slot = 1; slot < MAX_PLAYERS; slot++) {
+                if (clients[slot]) { net_world_report(clients[slot], "Blackboard"); n_clients++; }
+            }
+            if (rounds > 0) {
+                log_message(SYSTEM_LOG_FILE, "Blackboard", "Area of interest: %d clients, %.1f drones in range per client, "
+                            "snapshot round %.1f us (%.1f us per client)",
+                            n_clients, round_clients ? (double)aoi_near / round_clients : 0.0,
+                            round_time / rounds * 1e6, round_clients ? round_time / round_clients * 1e6 : 0.0);
+                round_time = 0.0;
+                rounds = round_clients = aoi_near = 0;
+            }
+            if (lockstep) net_lockstep_report(lockstep, "Blackboard");
+            if (input_steps || input_steps_refused) {
+                log_message(SYSTEM_LOG_FILE, "Blackboard", "Client inputs: %ld steps simulated, %ld refused (ahead of our clock, too long)",
+                            input_steps, input_steps_refused);
+                input_steps = input_steps_refused = 0;
+            }
+            if (lat_count > 0) {
+                log_message(SYSTEM_LOG_FILE, "Blackboard", "Dynamics->Blackboard latency: avg %.1f us, max %.1f us (%ld msgs, %s)",
+                            lat_sum / lat_count * 1e6, lat_max * 1e6, lat_count,
+                            chan_get_transport(PIPE_DYN_TO_SERVER) == CHAN_INPROC ? "threads" :
+                            chan_get_transport(PIPE_DYN_TO_SERVER) == CHAN_RING ? "ring" : "fifo");
+                metric_set(m_lat_max, lat_max);
+                lat_sum = lat_max = 0.0;
+                lat_count = 0;
             }
-            usleep(10000); 
-        } else {
-            // [FIX] Sleep in Multiplayer too (100Hz)
-            // This prevents CPU 100% usage while keeping physics smooth
-            usleep(10000);
         }
+
+        // [FIX] Sleep in Multiplayer too (100Hz)
+        // This prevents CPU 100% usage while keeping physics smooth.
+        // The wait is spent blocked on the Dynamics channel, so drone states
+        // are taken in as they arrive instead of up to a tick late.
+        // [FIX] What arrives here belongs to the next frame: stamped with
+        // this one, it would look already sent and be lost (e.g. a target
+        // collected by Dynamics never reached the Map).
+        frame++;
+        metric_add(m_frames, 1);
+        metric_add(m_busy, get_time_sec() - now);
+        metrics_heartbeat(now);
+        deadline += 0.01;
+        if (deadline < now) {
+            // The tick took longer than the period: restart from now (no burst)
+            tick.overruns++;
+            deadline = now + 0.01;
+        }
+        double left;
+        trace_begin("sleep");
+        while (running && (left = deadline - get_time_sec()) > 0) {
+            if (chan_recv_wait(ch_dyn_in, &msg_in, (long)(left * 1e6)) > 0) handle_dynamics_msg(ch_dyn_in, &msg_in, mode);
+        }
+        trace_end("sleep");
     }
 
+    if (peer) net_world_close(peer);
+    for (int slot = 1; slot < MAX_PLAYERS; slot++) {
+        if (clients[slot]) { net_world_close(clients[slot]); close(client_fd[slot]); clients[slot] = NULL; }
+    }
+    net_spectators_close(spectators);
+    spectators = NULL;
+    if (lockstep) net_lockstep_close(lockstep);
+    peer = NULL;
+    lockstep = NULL;
     if (sockfd != -1) close_network(sockfd);
-    close(fd_ui_in); close(fd_dyn_in);
-    if (mode == MODE_STANDALONE) { close(fd_obs_in); close(fd_tar_in); }
-    close(fd_ui_out); close(fd_ui_input_out); close(fd_dyn_out);
-    
+    stop_listening();
+    chan_close(ch_ui_in); chan_close(ch_dyn_in);
+    chan_close(ch_obs_in); chan_close(ch_tar_in);
+    router_close_all();
+    metrics_stop();
+    if (params_fd >= 0) close(params_fd);
+
     log_message(SYSTEM_LOG_FILE, "Blackboard", "Terminating...");
-}
\ No newline at end of file
+}
@@ -0,0 +1,457 @@
+#define _GNU_SOURCE
+#include "channel.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/sockios.h>
+
+#define IS_RING(ch) ((ch)->transport == CHAN_RING || (ch)->transport == CHAN_INPROC)
+
+// Record layout in the ring: [u32 length][bytes][padding to 8]
+// A length of RING_PAD means "skip to the start of the ring".
+#define RING_PAD   0xFFFFFFFFu
+#define REC_ALIGN  8
+#define REC_SIZE(len) (((len) + sizeof(uint32_t) + REC_ALIGN - 1) & ~(size_t)(REC_ALIGN - 1))
+
+// Per-channel transport table (inherited by the children on fork)
+#define MAX_CHAN_CONFIG 16
+static struct { char name[64]; int transport; } chan_config[MAX_CHAN_CONFIG];
+static int chan_config_count = 0;
+
+// In-process rings (threads mode): created by main before the threads
+// start, read-only afterwards, so lookups need no lock.
+#define MAX_INPROC 16
+static struct { char name[64]; RingBuffer *ring; } inproc[MAX_INPROC];
+static int inproc_count = 0;
+
+static RingBuffer *inproc_find(const char *name) {
+    for (int i = 0; i < inproc_count; i++) {
+        if (strcmp(inproc[i].name, name) == 0) return inproc[i].ring;
+    }
+    return NULL;
+}
+
+void chan_set_transport(const char *name, int transport) {
+    for (int i = 0; i < chan_config_count; i++) {
+        if (strcmp(chan_config[i].name, name) == 0) { chan_config[i].transport = transport; return; }
+    }
+    if (chan_config_count >= MAX_CHAN_CONFIG) return;
+    snprintf(chan_config[chan_config_count].name, sizeof(chan_config[0].name), "%s", name);
+    chan_config[chan_config_count++].transport = transport;
+}
+
+int chan_get_transport(const char *name) {
+    for (int i = 0; i < chan_config_count; i++) {
+        if (strcmp(chan_config[i].name, name) == 0) return chan_config[i].transport;
+    }
+    return CHAN_FIFO;
+}
+
+int chan_transport_from_name(const char *s) {
+    if (s && strcmp(s, "ring") == 0) return CHAN_RING;
+    if (s && strcmp(s, "inproc") == 0) return CHAN_INPROC;
+    return CHAN_FIFO;
+}
+
+// "/tmp/fifo_dyn_to_server" -> "/drone_fifo_dyn_to_server"
+static void shm_name(const char *name, char *out, size_t len) {
+    const char *base = strrchr(name, '/');
+    snprintf(out, len, "/drone_%s", base ? base + 1 : name);
+}
+
+static size_t ring_map_size(void) {
+    return sizeof(RingBuffer) + RING_SIZE;
+}
+
+static void ring_init(RingBuffer *ring) {
+    ring->size = RING_SIZE;
+    atomic_store(&ring->head, 0);
+    atomic_store(&ring->tail, 0);
+    atomic_store(&ring->waiting, 0);
+    atomic_store(&ring->wake_seq, 0);
+    atomic_store_explicit(&ring->magic, RING_MAGIC, memory_order_release);
+}
+
+int chan_create(const char *name) {
+    if (chan_get_transport(name) == CHAN_INPROC) {
+        if (inproc_find(name)) return 0;
+        if (inproc_count >= MAX_INPROC) return -1;
+        RingBuffer *ring = aligned_alloc(64, ring_map_size());
+        if (!ring) return -1;
+        memset(ring, 0, ring_map_size());
+        ring_init(ring);
+        snprintf(inproc[inproc_count].name, sizeof(inproc[0].name), "%s", name);
+        inproc[inproc_count++].ring = ring;
+        return 0;
+    }
+
+    char shm[96];
+    shm_name(name, shm, sizeof(shm));
+    shm_unlink(shm); // Leftover from a crash
+    int fd = shm_open(shm, O_CREAT | O_RDWR, 0666);
+    if (fd < 0) { perror("shm_open"); return -1; }
+    if (ftruncate(fd, ring_map_size()) < 0) { perror("ftruncate ring"); close(fd); return -1; }
+
+    RingBuffer *ring = mmap(NULL, ring_map_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) { perror("mmap ring"); return -1; }
+    ring_init(ring);
+    munmap(ring, ring_map_size());
+    return 0;
+}
+
+void chan_unlink(const char *name) {
+    if (chan_get_transport(name) != CHAN_RING) return;
+    char shm[96];
+    shm_name(name, shm, sizeof(shm));
+    shm_unlink(shm);
+}
+
+static int futex(_Atomic uint32_t *addr, int op, uint32_t val, const struct timespec *ts) {
+    return syscall(SYS_futex, (uint32_t *)addr, op, val, ts, NULL, 0);
+}
+
+// PRODUCER: copies a + b as one record. Returns -1 if there is no room.
+static int ring_push(RingBuffer *r, const void *a, size_t alen, const void *b, size_t blen) {
+    size_t len = alen + blen;
+    size_t need = REC_SIZE(len);
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    size_t off = head & (r->size - 1);
+    size_t pad = (off + need > r->size) ? r->size - off : 0;
+
+    if (need > r->size / 2 || head + pad + need - tail > r->size) {
+        errno = EAGAIN; // Full (or a record that can never fit safely)
+        return -1;
+    }
+
+    if (pad) {
+        *(uint32_t *)(r->data + off) = RING_PAD;
+        head += pad;
+        off = 0;
+    }
+    *(uint32_t *)(r->data + off) = (uint32_t)len;
+    memcpy(r->data + off + sizeof(uint32_t), a, alen);
+    if (blen) memcpy(r->data + off + sizeof(uint32_t) + alen, b, blen);
+    atomic_store_explicit(&r->head, head + need, memory_order_release);
+
+    // Only pay for a syscall when the consumer is asleep (and only once:
+    // clearing the flag stops the next pushes from waking it again)
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&r->waiting, memory_order_relaxed) && atomic_exchange(&r->waiting, 0)) {
+        atomic_fetch_add(&r->wake_seq, 1);
+        futex(&r->wake_seq, FUTEX_WAKE, 1, NULL);
+    }
+    return 0;
+}
+
+// CONSUMER: returns the record length, 0 if empty, -1 if 'cap' is too small.
+static int ring_pop(RingBuffer *r, void *buf, size_t cap) {
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    for (;;) {
+        uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (tail == head) return 0;
+        size_t off = tail & (r->size - 1);
+        uint32_t len = *(uint32_t *)(r->data + off);
+        if (len == RING_PAD) {
+            tail += r->size - off;
+            atomic_store_explicit(&r->tail, tail, memory_order_release);
+            continue;
+        }
+        int ret = -1;
+        if (len <= cap) {
+            memcpy(buf, r->data + off + sizeof(uint32_t), len);
+            ret = (int)len;
+        }
+        atomic_store_explicit(&r->tail, tail + REC_SIZE(len), memory_order_release);
+        return ret;
+    }
+}
+
+static int ring_empty(RingBuffer *r) {
+    return atomic_load_explicit(&r->head, memory_order_acquire) ==
+           atomic_load_explicit(&r->tail, memory_order_relaxed);
+}
+
+// 'wait' (FIFO writer only): block in open() until the reader exists
+static Channel *open_end(const char *name, int dir, int wait) {
+    Channel *ch = calloc(1, sizeof(Channel));
+    if (!ch) return NULL;
+    ch->transport = chan_get_transport(name);
+    ch->dir = dir;
+    ch->fd = -1;
+    snprintf(ch->name, sizeof(ch->name), "%s", name);
+
+    if (ch->transport == CHAN_INPROC) {
+        ch->ring = inproc_find(name);
+        if (!ch->ring) { free(ch); return NULL; }
+        return ch;
+    }
+
+    if (ch->transport == CHAN_RING) {
+        char shm[96];
+        shm_name(name, shm, sizeof(shm));
+        int fd = shm_open(shm, O_RDWR, 0666);
+        if (fd < 0) { free(ch); return NULL; }
+        ch->map_size = ring_map_size();
+        ch->ring = mmap(NULL, ch->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (ch->ring == MAP_FAILED) { perror("mmap ring"); free(ch); return NULL; }
+        if (atomic_load_explicit(&ch->ring->magic, memory_order_acquire) != RING_MAGIC) {
+            munmap(ch->ring, ch->map_size);
+            free(ch);
+            return NULL;
+        }
+        return ch;
+    }
+
+    // FIFO: a non-blocking writer open fails (ENXIO) until the reader
+    // exists; a blocking one sleeps in the kernel and returns as soon as
+    // the reader opens its end. I/O is non-blocking afterwards.
+    if (dir == CHAN_READ) {
+        ch->fd = open(name, O_RDONLY | O_NONBLOCK);
+    } else if (wait) {
+        ch->fd = open(name, O_WRONLY);
+        if (ch->fd >= 0) fcntl(ch->fd, F_SETFL, fcntl(ch->fd, F_GETFL) | O_NONBLOCK);
+    } else {
+        ch->fd = open(name, O_WRONLY | O_NONBLOCK);
+    }
+    if (ch->fd < 0) { free(ch); return NULL; }
+    return ch;
+}
+
+Channel *chan_try_open(const char *name, int dir) {
+    return open_end(name, dir, 0);
+}
+
+Channel *chan_open(const char *name, int dir) {
+    Channel *ch;
+    // Only retries while the FIFO / ring has not been created yet
+    // (Main creates all of them before starting the components)
+    while ((ch = open_end(name, dir, 1)) == NULL) usleep(1000);
+    return ch;
+}
+
+// One frame on an fd: a socket must not raise SIGPIPE when the viewer is gone
+static ssize_t fd_write(Channel *ch, const void *buf, size_t len) {
+    if (ch->transport == CHAN_SOCKET) return send(ch->fd, buf, len, MSG_NOSIGNAL);
+    return write(ch->fd, buf, len);
+}
+
+int chan_send(Channel *ch, const Message *msg) {
+    // A plain message never carries entities (not every caller clears the struct)
+    Message clean;
+    if (msg->batch || msg->batch_flags) {
+        clean = *msg;
+        clean.batch = clean.batch_flags = 0;
+        msg = &clean;
+    }
+    if (IS_RING(ch)) return ring_push(ch->ring, msg, sizeof(Message), NULL, 0);
+    return (fd_write(ch, msg, sizeof(Message)) == sizeof(Message)) ? 0 : -1;
+}
+
+size_t batch_item_size(MessageType type) {
+    if (type == MSG_OBSTACLE) return sizeof(Obstacle);
+    if (type == MSG_TARGET) return sizeof(Target);
+    if (type == MSG_PLAYER) return sizeof(Player);
+    if (type == MSG_INPUT) return sizeof(InputCmd);
+    if (type == MSG_NET_STATS) return sizeof(LinkStats);
+    return 0;
+}
+
+int chan_send_batch(Channel *ch, const Message *hdr, const void *items, int count) {
+    size_t item = batch_item_size(hdr->type);
+    if (item == 0 || count <= 0) return 0;
+    int per_frame = (int)((BATCH_FRAME_MAX - sizeof(Message)) / item);
+
+    for (int off = 0; off < count; off += per_frame) {
+        int n = (count - off < per_frame) ? count - off : per_frame;
+        const unsigned char *src = (const unsigned char *)items + off * item;
+
+        // The header and the entities go out in a single write
+        Message *frame = (Message *)ch->frame;
+        *frame = *hdr;
+        frame->batch = (unsigned short)n;
+        frame->batch_flags = (off == 0 ? BATCH_FIRST : 0) | (off + n == count ? BATCH_LAST : 0);
+
+        if (IS_RING(ch)) {
+            if (ring_push(ch->ring, frame, sizeof(Message), src, n * item) < 0) return -1;
+            continue;
+        }
+        size_t len = sizeof(Message) + n * item;
+        memcpy(ch->frame + sizeof(Message), src, n * item);
+        if (fd_write(ch, ch->frame, len) != (ssize_t)len) return -1;
+    }
+    return 0;
+}
+
+int chan_pending(Channel *ch) {
+    if (IS_RING(ch)) {
+        return (int)(atomic_load_explicit(&ch->ring->head, memory_order_acquire) -
+                     atomic_load_explicit(&ch->ring->tail, memory_order_acquire));
+    }
+    int depth = 0;
+    // Socket: bytes sent and not yet read by the peer (kernel accounting)
+    if (ioctl(ch->fd, ch->transport == CHAN_SOCKET ? SIOCOUTQ : FIONREAD, &depth) < 0) depth = 0;
+    return depth;
+}
+
+int chan_capacity(Channel *ch) {
+    if (IS_RING(ch)) return (int)ch->ring->size;
+    if (ch->transport == CHAN_SOCKET) {
+        int size = 0;
+        socklen_t len = sizeof(size);
+        if (getsockopt(ch->fd, SOL_SOCKET, SO_SNDBUF, &size, &len) < 0 || size <= 0) size = 65536;
+        return size;
+    }
+    int size = fcntl(ch->fd, F_GETPIPE_SZ);
+    return (size > 0) ? size : 65536;
+}
+
+// Reads one frame into ch->frame. Returns 1, 0 if empty, -1 on error.
+static int recv_frame(Channel *ch) {
+    Message *hdr = (Message *)ch->frame;
+    if (IS_RING(ch)) {
+        int n = ring_pop(ch->ring, ch->frame, sizeof(ch->frame));
+        if (n == 0) return 0;
+        return (n >= (int)sizeof(Message) && n == (int)(sizeof(Message) + hdr->batch * batch_item_size(hdr->type))) ? 1 : -1;
+    }
+    if (ch->transport == CHAN_SOCKET) {
+        // SOCK_SEQPACKET: one whole frame per recv (0 = the peer closed)
+        ssize_t n = recv(ch->fd, ch->frame, sizeof(ch->frame), 0);
+        if (n < 0) return (errno == EAGAIN) ? 0 : -1;
+        if (n == 0) { errno = EPIPE; return -1; }
+        return (n >= (ssize_t)sizeof(Message) && n == (ssize_t)(sizeof(Message) + hdr->batch * batch_item_size(hdr->type))) ? 1 : -1;
+    }
+    ssize_t n = read(ch->fd, ch->frame, sizeof(Message));
+    if (n < 0) return (errno == EAGAIN) ? 0 : -1;
+    if (n != sizeof(Message)) return 0;
+    if (hdr->batch == 0) return 1;
+
+    // The entities were written together with the header: they are there
+    size_t len = hdr->batch * batch_item_size(hdr->type);
+    if (len == 0 || len > sizeof(ch->frame) - sizeof(Message)) return -1;
+    return (read(ch->fd, ch->frame + sizeof(Message), len) == (ssize_t)len) ? 1 : -1;
+}
+
+// Appends the entities of a batch frame; 1 when the batch is complete
+static int batch_collect(Channel *ch, Message *hdr) {
+    size_t len = hdr->batch * batch_item_size(hdr->type);
+    if (hdr->batch_flags & BATCH_FIRST) { ch->batch_len = 0; ch->batch_count = 0; }
+    if (ch->batch_len + len > ch->batch_cap) {
+        size_t cap = (ch->batch_len + len) * 2;
+        unsigned char *p = realloc(ch->batch, cap);
+        if (!p) return 0;
+        ch->batch = p;
+        ch->batch_cap = cap;
+    }
+    memcpy(ch->batch + ch->batch_len, ch->frame + sizeof(Message), len);
+    ch->batch_len += len;
+    ch->batch_count += hdr->batch;
+    return (hdr->batch_flags & BATCH_LAST) != 0;
+}
+
+int chan_recv(Channel *ch, Message *msg) {
+    for (;;) {
+        int got = recv_frame(ch);
+        if (got <= 0) return got;
+        Message *hdr = (Message *)ch->frame;
+        if (hdr->batch == 0) { *msg = *hdr; return 1; }
+        if (batch_collect(ch, hdr)) {
+            *msg = *hdr;
+            msg->batch = (unsigned short)ch->batch_count;
+            return 1;
+        }
+        // Middle of a batch: keep reading
+    }
+}
+
+const void *chan_batch_items(Channel *ch) {
+    return ch->batch;
+}
+
+int chan_recv_wait(Channel *ch, Message *msg, long timeout_us) {
+    int got = chan_recv(ch, msg);
+    if (got != 0) return got;
+    return chan_wait(ch, timeout_us) ? chan_recv(ch, msg) : 0;
+}
+
+int chan_wait(Channel *ch, long timeout_us) {
+    struct timespec ts = { timeout_us / 1000000, (timeout_us % 1000000) * 1000L };
+    if (!IS_RING(ch)) {
+        struct pollfd pfd = { .fd = ch->fd, .events = POLLIN };
+        int n = ppoll(&pfd, 1, timeout_us < 0 ? NULL : &ts, NULL);
+        if (n > 0 && !(pfd.revents & POLLIN)) {
+            // No writer (POLLHUP): poll would return at once, so just wait
+            if (timeout_us > 0) nanosleep(&ts, NULL);
+            return 0;
+        }
+        return n > 0;
+    }
+
+    // Announce that we sleep, then check again (the producer checks
+    // 'waiting' after publishing, so one of the two sees the other)
+    RingBuffer *r = ch->ring;
+    uint32_t seq = atomic_load(&r->wake_seq);
+    atomic_store(&r->waiting, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (ring_empty(r)) futex(&r->wake_seq, FUTEX_WAIT, seq, timeout_us < 0 ? NULL : &ts);
+    atomic_store(&r->waiting, 0);
+    return !ring_empty(r);
+}
+
+Channel *chan_from_socket(int fd, const char *name) {
+    Channel *ch = calloc(1, sizeof(Channel));
+    if (!ch) return NULL;
+    ch->transport = CHAN_SOCKET;
+    ch->dir = CHAN_WRITE;
+    ch->fd = fd;
+    snprintf(ch->name, sizeof(ch->name), "%s", name);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return ch;
+}
+
+Channel *chan_connect(const char *path) {
+    if (strlen(path) >= sizeof(((struct sockaddr_un *)0)->sun_path)) { errno = ENAMETOOLONG; return NULL; }
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) return NULL;
+    struct sockaddr_un addr = { 0 };
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) { close(fd); return NULL; }
+    Channel *ch = chan_from_socket(fd, path);
+    if (!ch) close(fd);
+    return ch;
+}
+
+Channel *chan_subscribe(const char *path, const char *line, double timeout) {
+    Channel *ch;
+    for (int tries = (int)(timeout * 10); (ch = chan_connect(path)) == NULL && tries > 0; tries--) usleep(100000);
+    if (!ch) return NULL;
+    if (chan_send_raw(ch, line, strlen(line)) < 0) { chan_close(ch); return NULL; }
+    return ch;
+}
+
+int chan_send_raw(Channel *ch, const void *buf, size_t len) {
+    if (IS_RING(ch)) return ring_push(ch->ring, buf, len, NULL, 0);
+    return (fd_write(ch, buf, len) == (ssize_t)len) ? 0 : -1;
+}
+
+int chan_recv_raw(Channel *ch, void *buf, size_t len) {
+    if (IS_RING(ch)) return ring_pop(ch->ring, buf, len);
+    ssize_t n = read(ch->fd, buf, len);
+    if (n < 0) return (errno == EAGAIN) ? 0 : -1;
+    return (int)n;
+}
+
+void chan_close(Channel *ch) {
+    if (!ch) return;
+    if (ch->fd >= 0) close(ch->fd);
+    if (ch->ring && ch->transport == CHAN_RING) munmap(ch->ring, ch->map_size);
+    free(ch->batch);
+    free(ch);
+}
@@ -0,0 +1,121 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "common.h"
+#include <stdint.h>
+#include <stdatomic.h>
+
+// CHANNELS
+// A one-way Message stream between two components. The transport is
+// either the named pipe (FIFO) itself or a lock-free single-producer /
+// single-consumer ring buffer, in shared memory (between processes) or
+// in the heap (between threads of the single-process mode). The FIFO
+// path names the channel in all cases, so call sites do not change.
+
+#define CHAN_FIFO   0
+#define CHAN_RING   1
+#define CHAN_INPROC 2
+#define CHAN_SOCKET 3   // Connected SOCK_SEQPACKET socket (viewers), both ways
+
+#define CHAN_READ  0
+#define CHAN_WRITE 1
+
+#define RING_SIZE  65536        // Data bytes per ring (power of 2)
+#define RING_MAGIC 0x52494E47   // "RING"
+
+// Shared memory layout. head/tail are byte counters that only grow;
+// they live on separate cache lines so producer and consumer do not
+// fight over the same line.
+typedef struct {
+    _Atomic uint32_t magic;
+    uint32_t size;
+    _Alignas(64) _Atomic uint64_t head;     // Written by the producer only
+    _Alignas(64) _Atomic uint64_t tail;     // Written by the consumer only
+    _Alignas(64) _Atomic uint32_t waiting;  // Consumer is (about to go) asleep
+    _Atomic uint32_t wake_seq;              // Futex word, bumped on wakeup
+    _Alignas(64) unsigned char data[];
+} RingBuffer;
+
+typedef struct {
+    int transport;
+    int dir;
+    char name[64];      // FIFO path (also names the shared memory)
+    int fd;             // FIFO only
+    RingBuffer *ring;   // RING only
+    size_t map_size;
+
+    // Receive side of batch frames
+    unsigned char frame[BATCH_FRAME_MAX];   // One frame (header + entities)
+    unsigned char *batch;                   // Entities of the batch being assembled
+    size_t batch_len, batch_cap;
+    int batch_count;
+} Channel;
+
+// Transport selection (per channel name, default FIFO).
+// Must be set before fork() so that both ends agree.
+void chan_set_transport(const char *name, int transport);
+int chan_get_transport(const char *name);
+int chan_transport_from_name(const char *s); // "fifo" / "ring" / "inproc"
+
+// Creates the ring of a RING/INPROC channel (called by main, like mkfifo)
+int chan_create(const char *name);
+void chan_unlink(const char *name);
+
+// Opens one end. A FIFO writer sleeps in open() until the reader is there
+// (woken by the kernel, no polling).
+Channel *chan_open(const char *name, int dir);
+
+// Same, but returns NULL at once if the channel is not ready
+// (e.g. a FIFO writer while no reader has opened the pipe yet)
+Channel *chan_try_open(const char *name, int dir);
+
+// SOCKET channels (detachable viewers): one frame per packet, so a
+// frame is never split, and both ends send and receive on the same
+// Channel. chan_from_socket wraps an accepted socket; chan_connect
+// connects to a listening one (NULL if nobody listens).
+Channel *chan_from_socket(int fd, const char *name);
+Channel *chan_connect(const char *path);
+
+// Viewer side: connects (retrying for 'timeout' seconds while the
+// Blackboard starts) and sends the subscription line. NULL on failure.
+Channel *chan_subscribe(const char *path, const char *line, double timeout);
+
+// Non-blocking send. Returns 0 if sent, -1 if full (errno EAGAIN)
+// or broken (errno EPIPE: the FIFO reader went away).
+int chan_send(Channel *ch, const Message *msg);
+
+// Sends 'count' Obstacles or Targets (hdr->type) as batch frames, each
+// in one write. Returns 0 if all were sent, -1 like chan_send.
+int chan_send_batch(Channel *ch, const Message *hdr, const void *items, int count);
+
+// Size of one entity of a batch of 'type' (0 if the type has none)
+size_t batch_item_size(MessageType type);
+
+// Bytes queued and not yet read, and the total buffer size
+int chan_pending(Channel *ch);
+int chan_capacity(Channel *ch);
+
+// Non-blocking receive. Returns 1 if a message was read, 0 if empty, -1 on error.
+// A batch is returned once, complete: msg->batch is then the number of
+// entities and chan_batch_items() points to them (until the next receive).
+int chan_recv(Channel *ch, Message *msg);
+const void *chan_batch_items(Channel *ch);
+
+// Blocking receive with timeout (us, -1 = forever). Returns like chan_recv.
+// The ring consumer only sleeps (futex) when the ring is empty.
+int chan_recv_wait(Channel *ch, Message *msg, long timeout_us);
+
+// Sleeps until the channel may have data, or the timeout (us, -1 = forever).
+// Returns 1 if there is something to read, 0 otherwise.
+int chan_wait(Channel *ch, long timeout_us);
+
+// RAW RECORDS (ipc_bench): 'len' bytes in one write / one ring record,
+// outside the Message protocol. A FIFO does not delimit them: the reader
+// must ask for the size the writer sends (at most PIPE_BUF).
+// Returns like chan_send / chan_recv (recv: the record length).
+int chan_send_raw(Channel *ch, const void *buf, size_t len);
+int chan_recv_raw(Channel *ch, void *buf, size_t len);
+
+void chan_close(Channel *ch);
+
+#endif
@@ -48,6 +48,13 @@
 // Targets : Server (To send new goals)
 #define PIPE_TAR_TO_SERVER      "/tmp/fifo_tar_to_server"
 
+// Server : Autopilot (world state for the benchmark driver; it sends its
+// force commands on PIPE_UI_TO_SERVER like the Input Window)
+#define PIPE_SERVER_TO_AUTOPILOT "/tmp/fifo_server_to_autopilot"
+
+// Unix socket where detachable windows (--attach) subscribe (see router.h)
+#define VIEWER_SOCKET "/tmp/drone_viewer.sock"
+
 // 2. CONSTANTS (simulation parameters)
 
 #define MAP_WIDTH   100  // World size in meters
@@ -59,11 +66,20 @@
 #define REPULSION_ETA   500.0f  // Strength of repulsive push
 #define ATTRACTION_RHO  20.0f   // Radius of influence for Targets
 #define ATTRACTION_ETA  2.0f    // Strength of attractive pull
+#define TARGET_RADIUS   2.0f    // Pickup distance of a target (meters)
+#define OBSTACLE_HIT_RADIUS 1.0f // Hard-collision radius of an obstacle (OBSTACLE_COLLISION)
+#define RESTITUTION     0.5f    // Fraction of the normal speed kept after a bounce
 
 // Timing (Microseconds)
 // 20000us = 20ms = 50 FPS 
 #define UI_REFRESH_RATE 20000  
+// Default cap on force commands sent by the Input Window (per second)
+// Can be overridden with CMD_RATE in params.txt
+#define CMD_RATE_DEFAULT 50
 // 2000us = 2ms = 500 Physics Steps Per Second (High precision math)
+// Can be overridden with PHYSICS_RATE (Hz) in params.txt: collisions are
+// swept along the whole step, so a lower rate only costs accuracy of the
+// integration, never a missed target or a tunnelled obstacle.
 #define DYNAMICS_RATE   2000   
 // NEW: Update rate for dynamic obstacles/targets (e.g., 50ms = 20Hz)
 #define GENERATOR_RATE  50000 
@@ -72,6 +88,7 @@
 // Game Limits
 #define MAX_OBSTACLES 30
 #define MAX_TARGETS   9
+#define MAX_PLAYERS   8   // Drones in a multiplayer world (slot 0 = server)
 
 
 // 2. Assignment 2 Constants (NEW)
@@ -86,6 +103,13 @@ typedef enum {
     MSG_OBSTACLE,       // "A new obstacle appeared"
     MSG_TARGET,         // "A new target appeared"
     MSG_STOP,           // "Emergency Stop / Quit Game"
+    MSG_PARAM,          // "A parameter changed" (info = "KEY VALUE")
+    MSG_PLAYER,         // "Drones of the multiplayer world" (batch: the whole Player table)
+    MSG_INPUT,          // "Dynamics applied this command for N steps" (prediction history)
+    MSG_CORRECTION,     // "The server's state of our drone after input 'seq'"
+    MSG_LOCKSTEP,       // Lockstep session (info = "start SEED SLOT RATE SUBSTEPS DELAY" / "check TICK SUM")
+    MSG_NET_STATS,      // "Quality of the network links" (batch: one LinkStats per connection)
+    MSG_TYPE_COUNT      // Number of topics (keep last)
 } MessageType;
 
 // 4. DATA STRUCTURES 
@@ -103,10 +127,27 @@ typedef struct {
     Vec2 force;         
 } DroneState;
 
-// A static wall/dot
+// Motion model of an obstacle (see motion.h). Every process evaluates
+// the position itself from the model and the shared clock, so a moving
+// obstacle costs one message when its model is set, not one per tick.
+#define MOTION_STATIC   0
+#define MOTION_LINEAR   1
+#define MOTION_CIRCULAR 2
+#define MOTION_WAYPOINT 3
+
+typedef struct {
+    int type;           // MOTION_* (0 = static, the old behaviour)
+    unsigned int seed;  // Direction / phase / waypoints are derived from it
+    float speed;        // m/s along the path
+    float radius;       // Circle radius, or waypoint spread (m)
+    double t0;          // Start time (get_time_sec() clock)
+} Motion;
+
+// A static wall/dot (or a moving one: position is then the anchor)
 typedef struct { 
     int id; 
     Vec2 position; 
+    Motion motion;
 } Obstacle;
 
 // A goal to collect
@@ -118,20 +159,69 @@ typedef struct {
 
 
 
+// A drone of the multiplayer world, with its score.
+// 'local' is set for the drone of the process that receives it.
+typedef struct {
+    int id;             // Player slot (-1 = empty)
+    int score;          // Targets collected
+    int local;
+    DroneState drone;
+} Player;
+
+// A command force held for 'steps' physics steps of 'dt' seconds.
+// Dynamics numbers them; a world sync client sends them to the server,
+// which simulates its drone with the same steps (src/physics.c).
+typedef struct {
+    unsigned int seq;
+    Vec2 force;
+    int steps;
+    float dt;
+    double t0;          // Time of the first step (get_time_sec clock)
+} InputCmd;
+
+// Quality of one network connection over the last second
+// (the Blackboard publishes one per connection as MSG_NET_STATS)
+typedef struct {
+    int peer;               // Player slot on the other side (-1: the server / the opponent)
+    float rtt_ms;           // Smoothed round trip (ping/pong), and its mean deviation
+    float jitter_ms;
+    float rtt_min_ms, rtt_max_ms;   // Samples of the last second (0 = none)
+    float bytes_in, bytes_out;      // Per second
+    float msgs_in, msgs_out;        // Protocol messages per second
+    int send_queue;         // Bytes not yet sent by the kernel (TIOCOUTQ)
+    unsigned int lost;      // Pings without an answer (total)
+    unsigned int retrans;   // TCP segments retransmitted (total)
+} LinkStats;
+
 // 5. THE MESSAGE ENVELOPE
 // This struct is what actually travels through the pipes.
 typedef struct {
     MessageType type;   // Tells the receiver what data to look at
     int sender_pid;     // Process ID of who sent it
+    unsigned int seq;   // Sequence number (force commands), used to drop stale ones
+    unsigned short batch;       // Batch frame: number of entities after the header
+    unsigned short batch_flags; // BATCH_FIRST / BATCH_LAST
+    double stamp;       // Send time (get_time_sec), for latency stats
 
     // The Payload (Only one is used at a time)
     DroneState drone;
     Obstacle obstacle;
     Target target;
+    InputCmd input;
     
     char info[64];      // For debug text messages
 } Message;
 
+// 6. BATCH FRAMES
+// A whole array of Obstacles or Targets (type MSG_OBSTACLE / MSG_TARGET)
+// travels as a Message header followed by 'batch' entities, in one write.
+// A frame is at most PIPE_BUF bytes, so the kernel never splits or
+// interleaves it; larger arrays are cut into several frames and the
+// receiver applies them together when the BATCH_LAST frame arrives.
+#define BATCH_FRAME_MAX 4096
+#define BATCH_FIRST 1
+#define BATCH_LAST  2
+
 
 // 6. Function Prototypes (NEW) 
 // These allow all your processes to use the tools in utilities.c
@@ -148,10 +238,21 @@ void log_message(const char *filename, const char *process_name, const char *fmt
 
 /**
  * Saves the process PID to process_list.txt so the Watchdog can find it
+ * (with the thread ID: in threads mode every component has its own row)
  */
 void register_process(const char *process_name);
 
+/**
+ * Monotonic clock in seconds (for rate limiting and timing)
+ */
+double get_time_sec(void);
+
+/**
+ * Returns 1 if 'seq' is newer than 'last' (handles wrap-around)
+ */
+int seq_is_newer(unsigned int seq, unsigned int last);
+
 // ASSIGNMENT 3 : Network Function Prototypes
-void run_blackboard(int mode);
+void run_blackboard(int mode, const char *ip); // ip: client mode server address (NULL = prompt)
 
 #endif
\ No newline at end of file
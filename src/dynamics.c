@@ -8,161 +8,601 @@
 #include <errno.h> 
 #include "common.h"
 #include "params.h"
+#include "channel.h"
+#include "field.h"
+#include "ready.h"
+#include "motion.h"
+#include "physics.h"
+#include "net_lockstep.h"
+#include "metrics.h"
+#include "rt.h"
+#include "trace.h"
 
 // State Memory
 static DroneState drone;
 static Obstacle obstacles[MAX_OBSTACLES]; 
 static Target targets[MAX_TARGETS]; 
 static int obs_count = 0;
+// Split used by the repulsion: static obstacles go through the grid
+// (moving ones have id -1 there), moving ones at their current position
+static Obstacle static_obs[MAX_OBSTACLES];
+static Obstacle moving_obs[MAX_OBSTACLES + MAX_PLAYERS];
+static int moving_count = 0;
+// Multiplayer: the other drones repel like moving obstacles
+static Player players[MAX_PLAYERS];
 //Game logic: which target is next to collect
 static int next_target_needed = 0;
 
 //Pipes
-static int fd_server_to_dyn;
-static int fd_dyn_to_server;
+static Channel *ch_server_to_dyn;
+static Channel *ch_dyn_to_server; // FIFO or shared-memory ring (IPC_TRANSPORT)
 
 // Physics Parameters(loaded from config/params.txt)
-float M;
-float K;
+// They can change while running: the Blackboard pushes MSG_PARAM updates.
+static PhysicsParams phys;
 float T = DYNAMICS_RATE / 1000000.0; 
+static useconds_t step_us = DYNAMICS_RATE;   // Period of the physics steps
+static long obstacle_contacts = 0;           // Reported with the field statistics
+
+// Exported through the metrics mapping (served by the Blackboard)
+static Metric *m_steps, *m_step_time, *m_step_seconds, *m_received, *m_contacts, *m_corrections;
+
+// CLIENT-SIDE PREDICTION
+// Every step is applied at once with the local physics, whatever the
+// network. The steps are grouped into numbered inputs (same command
+// force, at most INPUT_MAX_TIME) kept in a history and sent to the
+// Blackboard; a world sync client forwards them to the server, which runs
+// them on its copy of our drone. When the server's state after input
+// 'seq' comes back (MSG_CORRECTION) and differs from what we had after
+// it, we restart from the server's state and replay the newer inputs.
+#define INPUT_HISTORY  256     // Inputs kept for replay (>> RTT / INPUT_MAX_TIME)
+#define INPUT_MAX_TIME 0.02    // s: an input is closed (and sent) at least this often
+#define RECONCILE_POS  0.01f   // m: smaller differences are quantisation, not errors
+#define RECONCILE_VEL  0.05f   // m/s
+typedef struct {
+    InputCmd cmd;
+    DroneState after;   // Our state after its last step (replays update it)
+} InputRecord;
+static InputRecord history[INPUT_HISTORY];
+static unsigned int input_seq = 0;     // The open input (0 = none yet)
+static long server_states = 0, corrections = 0, replayed_steps = 0;
+static float correction_max = 0.0f;
+static int inputs_per_tick = 0;        // NET_SYNC lockstep: the peer only takes tick inputs
+static int send_inputs = 0;            // World sync client: the Blackboard forwards our inputs (MSG_PLAYER)
+
+// Reads the physics parameters from the store (compile-time defaults if missing)
+void apply_params() {
+    physics_load(&phys);
+    // Step size: collisions are swept, so the rate is a CPU budget choice
+    float rate = param_get_float("PHYSICS_RATE", 1000000.0f / DYNAMICS_RATE);
+    if (rate < 10.0f) rate = 10.0f;
+    if (rate > 5000.0f) rate = 5000.0f;
+    T = 1.0f / rate;
+    step_us = (useconds_t)(1000000.0f / rate);
+    // The repulsion lattice is rebuilt if its settings or the field changed
+    field_configure(param_get_float("FIELD_GRID_RES", FIELD_GRID_RES),
+                    param_get_float("FIELD_MAX_ERROR", FIELD_MAX_ERROR),
+                    phys.rep_rho, phys.rep_eta);
+}
 
 // Algorithm 1 : Repulsion field
 // Khatib's Method: Obstacles exert a repulsive force 
 // inversely proportional to distance (1/d^2).
+// The field is precomputed on a grid (src/field.c): obstacles move every
+// few seconds, the drone queries the field 500 times per second.
+// Moving obstacles (motion models) are summed exactly instead.
 Vec2 calculate_repulsion() {
-    Vec2 f_rep = {0.0, 0.0};
+    Vec2 f_rep = field_force(drone.position.x, drone.position.y, static_obs, obs_count);
+    Vec2 f_mov = field_exact(drone.position.x, drone.position.y, moving_obs, moving_count,
+                             phys.rep_rho, phys.rep_eta);
+    f_rep.x += f_mov.x;
+    f_rep.y += f_mov.y;
+    return f_rep;
+}
+
+// Evaluates the motion models at time 'now' (no message needed)
+void split_obstacles(double now) {
+    moving_count = 0;
     for (int i = 0; i < obs_count; i++) {
-        float dx = drone.position.x - obstacles[i].position.x;
-        float dy = drone.position.y - obstacles[i].position.y;
-        float dist = sqrt(dx*dx + dy*dy);
-        
-        if (dist < REPULSION_RHO && dist > 0.1) { 
-            float mag = REPULSION_ETA * (1.0/dist - 1.0/REPULSION_RHO) * (1.0/(dist*dist));
-            f_rep.x += mag * (dx / dist);
-            f_rep.y += mag * (dy / dist);
-        }//Also avoid division by zero
+        static_obs[i] = obstacles[i];
+        if (obstacles[i].id == -1 || obstacles[i].motion.type == MOTION_STATIC) continue;
+        static_obs[i].id = -1;
+        moving_obs[moving_count] = obstacles[i];
+        moving_obs[moving_count].position = motion_position(&obstacles[i], now);
+        moving_count++;
+    }
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (players[i].id == -1 || players[i].local) continue;
+        memset(&moving_obs[moving_count], 0, sizeof(Obstacle));
+        moving_obs[moving_count].id = MAX_OBSTACLES + i;
+        moving_obs[moving_count].position = players[i].drone.position;
+        moving_count++;
     }
-    return f_rep;
 }
 
 // Algorithm 2 : Attraction field
 // Targets exert an attractive force pulling the drone towards them.
 Vec2 calculate_attraction() {
-    Vec2 f_att = {0.0, 0.0};
     // Pull towards the current needed target IF it is active
-    if (next_target_needed < MAX_TARGETS && targets[next_target_needed].active == 1) {
-        float dx = targets[next_target_needed].position.x - drone.position.x;
-        float dy = targets[next_target_needed].position.y - drone.position.y;
-        float dist = sqrt(dx*dx + dy*dy);
-
-        if (dist < ATTRACTION_RHO) {
-            f_att.x = ATTRACTION_ETA * dx; 
-            f_att.y = ATTRACTION_ETA * dy;
-        }
-    }
-    return f_att;
+    if (next_target_needed >= MAX_TARGETS) return (Vec2){0.0, 0.0};
+    return physics_attraction(&phys, drone.position, &targets[next_target_needed]);
 }
 // Algorithm 3 : Collision Detection
-// Check if the drone is close enough to a target to collect it.
-void check_collisions() {
-    for (int i = 0; i < MAX_TARGETS; i++) {
-        // Only check active targets
-        if (targets[i].active == 1) {
-            float dx = drone.position.x - targets[i].position.x;
-            float dy = drone.position.y - targets[i].position.y;
-            float dist = sqrt(dx*dx + dy*dy);
-
-            if (dist < 2.0) {
-                // Check Sequence
-                if (targets[i].id == next_target_needed) {
-
-                    // [NEW LOGGING] Debug the sequence logic 
-                    log_message(SYSTEM_LOG_FILE, "Dynamics", "Target %d collected. Sequence updated.", targets[i].id);
-                    //
-                    // 1. DISAPPEAR (Set inactive)
-                    targets[i].active = 0;
-                    
-                    // Notify Server (to hide it on Map)
-                    Message msg;
-                    msg.type = MSG_TARGET;
-                    msg.target = targets[i]; 
-                    msg.sender_pid = getpid();
-                    write(fd_dyn_to_server, &msg, sizeof(Message));
-
-                    // 2. Advance Sequence
-                    next_target_needed++;
-
-                    // 3. LEVEL CLEAR CHECK
-                    // If we collected the last target (target 8, which is number 9)
-                    if (next_target_needed >= MAX_TARGETS) {
-
-                        // [NEW LOGGING] Debug the level reset logic 
-                        log_message(SYSTEM_LOG_FILE, "Dynamics", "LEVEL CLEAR! Respawning all targets.");
-                        // 
-                        // Reset Sequence
-                        next_target_needed = 0;
-                        
-                        // Respawn ALL targets
-                        for (int j = 0; j < MAX_TARGETS; j++) {
-                            targets[j].position.x = 5 + rand() % (MAP_WIDTH - 10);
-                            targets[j].position.y = 5 + rand() % (MAP_HEIGHT - 10);
-                            targets[j].active = 1; // Make visible again
-                            
-                            // Send update for EACH target
-                            msg.target = targets[j];
-                            write(fd_dyn_to_server, &msg, sizeof(Message));
-                        }
-                    }
-                }
+// The drone moved along prev -> drone.position during the last step: a
+// target is collected if that segment passes within TARGET_RADIUS of it,
+// whatever the step size. Targets crossed in the same step are collected
+// in sequence order along the segment.
+void check_collisions(Vec2 prev) {
+    float t_from = 0.0f;   // Targets must be reached after the previous one
+    while (next_target_needed < MAX_TARGETS) {
+        int i = -1;
+        for (int k = 0; k < MAX_TARGETS; k++) {
+            if (targets[k].active == 1 && targets[k].id == next_target_needed) { i = k; break; }
+        }
+        if (i < 0) return;
+
+        Vec2 c = targets[i].position;
+        Vec2 p0 = { prev.x + t_from * (drone.position.x - prev.x) - c.x,
+                    prev.y + t_from * (drone.position.y - prev.y) - c.y };
+        Vec2 p1 = { drone.position.x - c.x, drone.position.y - c.y };
+        float t = motion_sweep(p0, p1, TARGET_RADIUS);
+        if (t < 0.0f) return;
+        t_from += t * (1.0f - t_from);
+
+        // [NEW LOGGING] Debug the sequence logic 
+        log_message(SYSTEM_LOG_FILE, "Dynamics", "Target %d collected. Sequence updated.", targets[i].id);
+        //
+        // 1. DISAPPEAR (Set inactive)
+        targets[i].active = 0;
+
+        // Notify Server (to hide it on Map)
+        Message msg;
+        memset(&msg, 0, sizeof(Message));
+        msg.type = MSG_TARGET;
+        msg.target = targets[i]; 
+        msg.sender_pid = getpid();
+        chan_send(ch_dyn_to_server, &msg);
+
+        // 2. Advance Sequence
+        next_target_needed++;
+
+        // 3. LEVEL CLEAR CHECK
+        // If we collected the last target (target 8, which is number 9)
+        if (next_target_needed >= MAX_TARGETS) {
+
+            // [NEW LOGGING] Debug the level reset logic 
+            log_message(SYSTEM_LOG_FILE, "Dynamics", "LEVEL CLEAR! Respawning all targets.");
+            // 
+            // Reset Sequence
+            next_target_needed = 0;
+            
+            // Respawn ALL targets
+            for (int j = 0; j < MAX_TARGETS; j++) {
+                targets[j].position.x = 5 + rand() % (MAP_WIDTH - 10);
+                targets[j].position.y = 5 + rand() % (MAP_HEIGHT - 10);
+                targets[j].active = 1; // Make visible again
             }
+            // One batch write for the whole new level
+            chan_send_batch(ch_dyn_to_server, &msg, targets, MAX_TARGETS);
+            return;
         }
     }
 }
 
-// Update the drone's physics state
-//// Solves: F = ma + kv
-void update_physics() {
+// Update the drone's physics state over 'dt' seconds
+// (src/physics.c: F = ma + kv, shared with the world sync server)
+void update_physics(float dt) {
+    trace_begin("update_physics");
     Vec2 f_rep = calculate_repulsion();
     Vec2 f_att = calculate_attraction();
-    //1.calculate Acceleration
-    float total_fx = drone.force.x + f_rep.x + f_att.x;
-    float total_fy = drone.force.y + f_rep.y + f_att.y;
-    //Update Velocity and Position
-    float ax = (total_fx - K * drone.velocity.x) / M;
-    float ay = (total_fy - K * drone.velocity.y) / M;
-    //Update velocity and position using Euler integration
-    drone.velocity.x += ax * T;
-    drone.velocity.y += ay * T;
-    drone.position.x += drone.velocity.x * T;
-    drone.position.y += drone.velocity.y * T;
-    //Boundary conditions
-    if (drone.position.x <= 1) { drone.position.x = 1; drone.velocity.x = -0.5*drone.velocity.x; }
-    if (drone.position.x >= MAP_WIDTH-1) { drone.position.x = MAP_WIDTH-1; drone.velocity.x = -0.5*drone.velocity.x; }
-    if (drone.position.y <= 1) { drone.position.y = 1; drone.velocity.y = -0.5*drone.velocity.y; }
-    if (drone.position.y >= MAP_HEIGHT-1) { drone.position.y = MAP_HEIGHT-1; drone.velocity.y = -0.5*drone.velocity.y; }
+    Vec2 f_ext = { f_rep.x + f_att.x, f_rep.y + f_att.y };
+    physics_step(&phys, &drone, f_ext, dt);
+    trace_end("update_physics");
+}
+
+// Optional hard collision with obstacles (OBSTACLE_COLLISION 1), swept
+// along the step: exact at any step size
+void resolve_obstacles(Vec2 prev, double t_prev, double t_now) {
+    if (physics_resolve_obstacles(&phys, &drone, prev, obstacles, obs_count, t_prev, t_now)) {
+        obstacle_contacts++;
+        metric_add(m_contacts, 1);
+    }
+}
+
+// Adds this step to the open input, or closes it (and tells the
+// Blackboard, if it forwards inputs) when the command changed or it is
+// INPUT_MAX_TIME long. The history is kept in every mode.
+void record_input(double now) {
+    InputRecord *r = &history[input_seq % INPUT_HISTORY];
+    if (input_seq && r->cmd.force.x == drone.force.x && r->cmd.force.y == drone.force.y &&
+        r->cmd.dt == T && (r->cmd.steps + 1) * T <= INPUT_MAX_TIME + 1e-6) {
+        r->cmd.steps++;
+        return;
+    }
+    if (input_seq && send_inputs && !inputs_per_tick) {
+        Message msg;
+        memset(&msg, 0, sizeof(Message));
+        msg.type = MSG_INPUT;
+        msg.sender_pid = getpid();
+        msg.input = r->cmd;
+        chan_send(ch_dyn_to_server, &msg);
+    }
+    input_seq++;
+    if (input_seq == 0) input_seq = 1;   // 0 means "none"
+    r = &history[input_seq % INPUT_HISTORY];
+    memset(r, 0, sizeof(*r));
+    r->cmd.seq = input_seq;
+    r->cmd.force = drone.force;
+    r->cmd.steps = 1;
+    r->cmd.dt = T;
+    r->cmd.t0 = now;
+}
+
+// Server correction: 'server' is the authoritative state after input 'seq'
+void reconcile(unsigned int seq, const DroneState *server) {
+    InputRecord *r = &history[seq % INPUT_HISTORY];
+    if (r->cmd.seq != seq || seq == input_seq) return;   // Too old, or not closed yet
+    server_states++;
+    float dx = server->position.x - r->after.position.x, dy = server->position.y - r->after.position.y;
+    float dvx = server->velocity.x - r->after.velocity.x, dvy = server->velocity.y - r->after.velocity.y;
+    float err = sqrtf(dx*dx + dy*dy);
+    if (err < RECONCILE_POS && sqrtf(dvx*dvx + dvy*dvy) < RECONCILE_VEL) return;   // Prediction was right
+    corrections++;
+    metric_add(m_corrections, 1);
+    if (err > correction_max) correction_max = err;
+
+    // Restart from the server's state and replay what it has not seen yet,
+    // at the same step times (moving obstacles), without new pickups
+    Vec2 force = drone.force;
+    drone.position = server->position;
+    drone.velocity = server->velocity;
+    for (unsigned int s = seq + 1; s != input_seq + 1; s++) {
+        InputRecord *h = &history[s % INPUT_HISTORY];
+        drone.force = h->cmd.force;
+        for (int k = 0; k < h->cmd.steps; k++) {
+            double t_now = h->cmd.t0 + k * h->cmd.dt;
+            split_obstacles(t_now);
+            Vec2 prev = drone.position;
+            update_physics(h->cmd.dt);
+            physics_resolve_obstacles(&phys, &drone, prev, obstacles, obs_count, t_now - h->cmd.dt, t_now);
+        }
+        h->after = drone;
+        replayed_steps += h->cmd.steps;
+    }
+    drone.force = force;
 }
 
 void send_state() {
     Message msg;
+    memset(&msg, 0, sizeof(Message));
     msg.type = MSG_DRONE_STATE;
     msg.sender_pid = getpid();
     msg.drone = drone;
+    msg.stamp = get_time_sec();
+    trace_flow_out("drone state", trace_flow_id(msg.sender_pid, msg.stamp));
     //Send updated state to server
-    if (write(fd_dyn_to_server, &msg, sizeof(Message)) < 0) {}
+    if (chan_send(ch_dyn_to_server, &msg) < 0) {}
+}
+
+// LOCKSTEP (NET_SYNC lockstep, see net_lockstep.h)
+// Started by the Blackboard (MSG_LOCKSTEP "start ..."). From then on this
+// process simulates the whole game, both drones, obstacles, targets and
+// scores, one fixed tick at a time. Every random choice comes from the
+// session seed and every time inside the simulation is a session time
+// (tick * tick length), never the local clock: two peers given the same
+// inputs compute the same bits.
+#define LS_CATCHUP 5            // Max ticks simulated in one loop after a stall
+#define OBSTACLE_REFRESH 4.0    // s between two obstacle changes (as the Generator)
+static int ls_active = 0;
+static LockstepConfig ls_cfg;
+static PhysicsParams ls_phys;           // Physics of the session (settings frozen, see lockstep_settings_key)
+static int ls_slot;                     // Our drone (server 0, client 1)
+static unsigned int ls_rng;             // Session random generator
+static unsigned int ls_tick;            // Next tick to simulate
+static double ls_start;                 // Local time of tick 0
+static double ls_dt;                    // Tick length (s)
+static Vec2 ls_input[2][LOCKSTEP_WINDOW];
+static unsigned int ls_input_tick[2][LOCKSTEP_WINDOW];  // Tick each slot holds
+static Player ls_players[MAX_PLAYERS];
+static Obstacle ls_obs[MAX_OBSTACLES];  // Motion t0 in session time
+static int ls_motion, ls_refresh_ticks;
+static float ls_speed, ls_radius;
+static double ls_stall = 0.0;           // Time waiting for the peer (reported)
+static unsigned int ls_ticks_done = 0;
+
+static unsigned int ls_rand(void) {
+    ls_rng = ls_rng * 1664525u + 1013904223u;
+    return ls_rng >> 8;
+}
+
+// New model for obstacle 'i' from session time 't' (Generator rules)
+static void ls_pick_motion(int i, double t) {
+    Obstacle *o = &ls_obs[i];
+    memset(&o->motion, 0, sizeof(Motion));
+    int type = (ls_motion >= 0) ? ls_motion : MOTION_LINEAR + i % 3;
+    if (type == MOTION_STATIC) return;
+    o->motion.type = type;
+    o->motion.seed = ls_rand();
+    o->motion.speed = ls_speed * (0.5f + (ls_rand() % 100) / 100.0f);
+    o->motion.radius = ls_radius;
+    o->motion.t0 = t;
+}
+
+// Publishes obstacles [from, to) to the Blackboard, in local time
+static void ls_send_obstacles(int from, int to) {
+    Obstacle list[MAX_OBSTACLES];
+    for (int i = from; i < to; i++) {
+        list[i - from] = ls_obs[i];
+        list[i - from].motion.t0 += ls_start;
+    }
+    Message msg;
+    memset(&msg, 0, sizeof(Message));
+    msg.type = MSG_OBSTACLE;
+    msg.sender_pid = getpid();
+    chan_send_batch(ch_dyn_to_server, &msg, list, to - from);
+}
+
+static void ls_send_targets() {
+    Message msg;
+    memset(&msg, 0, sizeof(Message));
+    msg.type = MSG_TARGET;
+    msg.sender_pid = getpid();
+    chan_send_batch(ch_dyn_to_server, &msg, targets, MAX_TARGETS);
+}
+
+static void ls_spawn_targets() {
+    for (int j = 0; j < MAX_TARGETS; j++) {
+        targets[j].id = j;
+        targets[j].position.x = 5 + ls_rand() % (MAP_WIDTH - 10);
+        targets[j].position.y = 5 + ls_rand() % (MAP_HEIGHT - 10);
+        targets[j].active = 1;
+    }
+}
+
+void lockstep_start(const char *info) {
+    LockstepConfig cfg;
+    int slot;
+    if (sscanf(info, "start %u %d %d %d %d", &cfg.seed, &slot, &cfg.rate, &cfg.substeps, &cfg.delay) != 5) return;
+    if (ls_active && cfg.seed == ls_cfg.seed) return;   // Resent with a keyframe
+    if (slot < 0 || slot > 1 || cfg.rate <= 0 || cfg.substeps <= 0 || cfg.delay >= LOCKSTEP_WINDOW) return;
+    ls_cfg = cfg;
+    ls_phys = phys;
+    ls_slot = slot;
+    ls_rng = cfg.seed;
+    ls_tick = 0;
+    ls_dt = 1.0 / cfg.rate;
+    ls_start = get_time_sec();
+    ls_refresh_ticks = (int)lround(OBSTACLE_REFRESH * cfg.rate);
+    char motion_param[PARAM_VAL_LEN];
+    param_get_str("OBSTACLE_MOTION", "static", motion_param, sizeof(motion_param));
+    ls_motion = motion_from_name(motion_param);
+    if (strcmp(motion_param, "mixed") == 0) ls_motion = -1;
+    else if (ls_motion < 0) ls_motion = MOTION_STATIC;
+    ls_speed = param_get_float("OBSTACLE_SPEED", 2.0f);
+    ls_radius = param_get_float("OBSTACLE_RADIUS", 6.0f);
+
+    // The world, from the seed only
+    for (int i = 0; i < MAX_OBSTACLES; i++) {
+        ls_obs[i].id = i;
+        ls_obs[i].position.x = 5 + ls_rand() % (MAP_WIDTH - 10);
+        ls_obs[i].position.y = 5 + ls_rand() % (MAP_HEIGHT - 10);
+        ls_pick_motion(i, 0.0);
+    }
+    ls_spawn_targets();
+    next_target_needed = 0;
+    memset(ls_players, 0, sizeof(ls_players));
+    for (int i = 0; i < MAX_PLAYERS; i++) ls_players[i].id = -1;
+    for (int p = 0; p < 2; p++) {
+        ls_players[p].id = p;
+        ls_players[p].drone.position.x = MAP_WIDTH / 2 + (p ? 10 : -10);
+        ls_players[p].drone.position.y = MAP_HEIGHT / 2;
+    }
+    // Nobody moves before the first delayed input
+    memset(ls_input, 0, sizeof(ls_input));
+    memset(ls_input_tick, 0xff, sizeof(ls_input_tick));
+    for (int p = 0; p < 2; p++) {
+        for (int t = 0; t < cfg.delay; t++) ls_input_tick[p][t] = t;
+    }
+    ls_active = 1;
+    ls_send_obstacles(0, MAX_OBSTACLES);
+    ls_send_targets();
+    log_message(SYSTEM_LOG_FILE, "Dynamics", "Lockstep started: seed %u, slot %d, %d ticks/s x %d steps, delay %d ticks",
+                cfg.seed, slot, cfg.rate, cfg.substeps, cfg.delay);
+}
+
+// Peer inputs (seq = tick)
+static void ls_store_inputs(const InputCmd *list, int count) {
+    int remote = 1 - ls_slot;
+    for (int k = 0; k < count; k++) {
+        unsigned int tick = list[k].seq;
+        if (tick < ls_tick || tick >= ls_tick + LOCKSTEP_WINDOW) continue;
+        ls_input[remote][tick % LOCKSTEP_WINDOW] = list[k].force;
+        ls_input_tick[remote][tick % LOCKSTEP_WINDOW] = tick;
+    }
+}
+
+// Our input for 'tick': the current command, rounded as the peer gets it
+static void ls_sample_input(unsigned int tick) {
+    Vec2 f = { lroundf(drone.force.x * LOCKSTEP_FORCE_SCALE) / LOCKSTEP_FORCE_SCALE,
+               lroundf(drone.force.y * LOCKSTEP_FORCE_SCALE) / LOCKSTEP_FORCE_SCALE };
+    ls_input[ls_slot][tick % LOCKSTEP_WINDOW] = f;
+    ls_input_tick[ls_slot][tick % LOCKSTEP_WINDOW] = tick;
+    Message msg;
+    memset(&msg, 0, sizeof(Message));
+    msg.type = MSG_INPUT;
+    msg.sender_pid = getpid();
+    msg.input.seq = tick;
+    msg.input.force = f;
+    msg.input.steps = ls_cfg.substeps;
+    msg.input.dt = (float)ls_dt;
+    chan_send(ch_dyn_to_server, &msg);
+}
+
+// Sequence pickups of drone 'p' along its step (the rule of check_collisions)
+static int ls_pickups(int p, Vec2 from, Vec2 to) {
+    int changed = 0;
+    float t_from = 0.0f;
+    while (next_target_needed < MAX_TARGETS && targets[next_target_needed].active == 1) {
+        Vec2 c = targets[next_target_needed].position;
+        Vec2 p0 = { from.x + t_from * (to.x - from.x) - c.x, from.y + t_from * (to.y - from.y) - c.y };
+        Vec2 p1 = { to.x - c.x, to.y - c.y };
+        float t = motion_sweep(p0, p1, TARGET_RADIUS);
+        if (t < 0.0f) break;
+        t_from += t * (1.0f - t_from);
+        targets[next_target_needed].active = 0;
+        ls_players[p].score++;
+        changed = 1;
+        if (++next_target_needed >= MAX_TARGETS) {
+            log_message(SYSTEM_LOG_FILE, "Dynamics", "LEVEL CLEAR by player %d (lockstep tick %u)", p, ls_tick);
+            next_target_needed = 0;
+            ls_spawn_targets();
+            break;
+        }
+    }
+    return changed;
+}
+
+// FNV-1a over everything the simulation decides
+static unsigned int ls_checksum() {
+    unsigned int h = 2166136261u;
+    const unsigned char *parts[3] = { (const unsigned char *)ls_players, (const unsigned char *)targets,
+                                      (const unsigned char *)ls_obs };
+    size_t sizes[3] = { 2 * sizeof(Player), sizeof(targets), sizeof(ls_obs) };
+    for (int k = 0; k < 3; k++) {
+        for (size_t i = 0; i < sizes[k]; i++) { h ^= parts[k][i]; h *= 16777619u; }
+    }
+    return h;
+}
+
+// One tick: both drones, cfg.substeps fixed physics steps each
+static void lockstep_tick() {
+    int w = ls_tick % LOCKSTEP_WINDOW;
+    double t_tick = ls_tick * ls_dt;
+    float h = (float)(ls_dt / ls_cfg.substeps);
+    int targets_changed = 0;
+
+    // 1. World events, on tick boundaries
+    if (ls_tick > 0 && ls_refresh_ticks > 0 && ls_tick % ls_refresh_ticks == 0) {
+        int id = ls_rand() % MAX_OBSTACLES;
+        if (ls_obs[id].motion.type == MOTION_STATIC) {
+            ls_obs[id].position.x = 5 + ls_rand() % (MAP_WIDTH - 10);
+            ls_obs[id].position.y = 5 + ls_rand() % (MAP_HEIGHT - 10);
+        } else {
+            ls_obs[id].position = motion_position(&ls_obs[id], t_tick);
+            ls_pick_motion(id, t_tick);
+        }
+        ls_send_obstacles(id, id + 1);
+    }
+
+    // 2. Physics: the drones in slot order, each repelled by the other
+    for (int p = 0; p < 2; p++) ls_players[p].drone.force = ls_input[p][w];
+    for (int k = 1; k <= ls_cfg.substeps; k++) {
+        double t = t_tick + k * (double)h;
+        Obstacle near[MAX_OBSTACLES + 1];
+        for (int i = 0; i < MAX_OBSTACLES; i++) {
+            near[i] = ls_obs[i];
+            near[i].position = motion_position(&ls_obs[i], t);
+        }
+        for (int p = 0; p < 2; p++) {
+            DroneState *d = &ls_players[p].drone;
+            memset(&near[MAX_OBSTACLES], 0, sizeof(Obstacle));
+            near[MAX_OBSTACLES].id = MAX_OBSTACLES;
+            near[MAX_OBSTACLES].position = ls_players[1 - p].drone.position;
+            Vec2 f = field_exact(d->position.x, d->position.y, near, MAX_OBSTACLES + 1, phys.rep_rho, phys.rep_eta);
+            Vec2 f_att = (next_target_needed < MAX_TARGETS) ?
+                         physics_attraction(&phys, d->position, &targets[next_target_needed]) : (Vec2){0, 0};
+            f.x += f_att.x;
+            f.y += f_att.y;
+            Vec2 prev = d->position;
+            physics_step(&phys, d, f, h);
+            physics_resolve_obstacles(&phys, d, prev, ls_obs, MAX_OBSTACLES, t - h, t);
+            targets_changed |= ls_pickups(p, prev, d->position);
+        }
+    }
+
+    // 3. Checksum and publication
+    if (ls_tick % LOCKSTEP_CHECK_TICKS == 0) {
+        Message msg;
+        memset(&msg, 0, sizeof(Message));
+        msg.type = MSG_LOCKSTEP;
+        msg.sender_pid = getpid();
+        snprintf(msg.info, sizeof(msg.info), "check %u %u", ls_tick, ls_checksum());
+        chan_send(ch_dyn_to_server, &msg);
+    }
+    if (targets_changed) ls_send_targets();
+    ls_tick++;
+    ls_ticks_done++;
+}
+
+// Runs the ticks that are due and have both inputs
+void lockstep_run(double now) {
+    static double waiting_since = 0.0;
+    int ran = 0;
+    for (int n = 0; n < LS_CATCHUP; n++) {
+        if (now < ls_start + ls_tick * ls_dt) break;          // Not due yet
+        int w = ls_tick % LOCKSTEP_WINDOW;
+        if (ls_input_tick[0][w] != ls_tick || ls_input_tick[1][w] != ls_tick) {
+            if (waiting_since == 0.0) waiting_since = now;    // Stalled on the peer
+            break;
+        }
+        if (waiting_since > 0.0) {
+            double waited = now - waiting_since;
+            ls_stall += waited;
+            waiting_since = 0.0;
+            // The peer started or runs later: follow its clock instead of
+            // waiting on every tick (obstacle times are published in ours)
+            if (waited > ls_dt) {
+                ls_start += waited;
+                ls_send_obstacles(0, MAX_OBSTACLES);
+            }
+        }
+        ls_sample_input(ls_tick + ls_cfg.delay);
+        lockstep_tick();
+        ran++;
+    }
+    if (!ran) return;
+    // Our drone to the Blackboard, the whole table for the others
+    Vec2 force = drone.force;
+    drone = ls_players[ls_slot].drone;
+    drone.force = force;
+    send_state();
+    Player table[MAX_PLAYERS];
+    memcpy(table, ls_players, sizeof(table));
+    table[ls_slot].local = 1;   // Not in the simulated state: it differs per peer
+    Message msg;
+    memset(&msg, 0, sizeof(Message));
+    msg.type = MSG_PLAYER;
+    msg.sender_pid = getpid();
+    chan_send_batch(ch_dyn_to_server, &msg, table, MAX_PLAYERS);
 }
 
 void run_dynamics() {
     register_process("Dynamics");
     log_message(SYSTEM_LOG_FILE, "Dynamics", "Dynamics process started.");
-    srand(time(NULL) + getpid());
-    // Load parameters from config file
-    M = load_param("config/params.txt", "M");
-    K = load_param("config/params.txt", "K");
+    // Parameters: parsed once by Main before we started
+    apply_params();
+    char net_sync[PARAM_VAL_LEN];
+    inputs_per_tick = (strcmp(param_get_str("NET_SYNC", "world", net_sync, sizeof(net_sync)), "lockstep") == 0);
+    // Level respawns follow TARGET_SEED too (0 = random)
+    unsigned int seed = (unsigned int)param_get_int("TARGET_SEED", 0);
+    srand(seed ? seed + 1 : (unsigned int)(time(NULL) + getpid()));
     //Wait for pipes to be available
-    while ((fd_server_to_dyn = open(PIPE_SERVER_TO_DYN, O_RDONLY | O_NONBLOCK)) < 0) usleep(100000);
-    while ((fd_dyn_to_server = open(PIPE_DYN_TO_SERVER, O_WRONLY | O_NONBLOCK)) < 0) usleep(100000);
+    ch_server_to_dyn = chan_open(PIPE_SERVER_TO_DYN, CHAN_READ);
+    ch_dyn_to_server = chan_open(PIPE_DYN_TO_SERVER, CHAN_WRITE);
+    metrics_attach("dynamics");
+    m_steps = metric_counter("drone_dynamics_steps_total", NULL, "Physics steps (lockstep: loop turns)");
+    m_step_time = metric_gauge("drone_dynamics_step_seconds", NULL, "Duration of the last step");
+    m_step_seconds = metric_counter("drone_dynamics_step_seconds_total", NULL, "Time spent in steps");
+    m_received = metric_counter("drone_dynamics_received_total", NULL, "Messages read from the Blackboard");
+    m_contacts = metric_counter("drone_dynamics_obstacle_contacts_total", NULL, "Steps that touched an obstacle");
+    m_corrections = metric_counter("drone_dynamics_corrections_total", NULL, "Predictions corrected by the server");
+    rt_apply("Dynamics");
+    trace_init("Dynamics");
+    ready_signal(READY_DYNAMICS);
 
     for(int i=0; i<MAX_TARGETS; i++) targets[i].active = 0;
+    for(int i=0; i<MAX_OBSTACLES; i++) obstacles[i].id = -1;
+    for(int i=0; i<MAX_PLAYERS; i++) players[i].id = -1;
 
     drone.position.x = MAP_WIDTH / 2;
     drone.position.y = MAP_HEIGHT / 2;
@@ -170,25 +610,134 @@ void run_dynamics() {
     drone.force.x = 0;    drone.force.y = 0;
 
     Message msg;
+    double next_report = get_time_sec() + 5.0;
+    unsigned int last_force_seq = 0;
+    int last_force_pid = 0;
+    double t_prev = get_time_sec();
+    // Steps on absolute deadlines: a slow step does not delay the next ones
+    RtLoop loop;
+    rt_loop_start(&loop, step_us * 1000L);
     while (1) {
         //Read all incoming commands
-        while (read(fd_server_to_dyn, &msg, sizeof(Message)) > 0) {
+        trace_begin("read");
+        while (chan_recv(ch_server_to_dyn, &msg) > 0) {
+            metric_add(m_received, 1);
             if (msg.type == MSG_FORCE_UPDATE) {
+                // Ignore commands older than the one already applied
+                if (msg.sender_pid == last_force_pid && !seq_is_newer(msg.seq, last_force_seq)) continue;
+                last_force_pid = msg.sender_pid;
+                last_force_seq = msg.seq;
                 drone.force = msg.drone.force;
             } 
+            // Lockstep: the world is ours (the Blackboard only echoes it)
+            else if (ls_active && (msg.type == MSG_OBSTACLE || msg.type == MSG_TARGET ||
+                                   msg.type == MSG_PLAYER || msg.type == MSG_CORRECTION)) continue;
+            else if (msg.type == MSG_INPUT && ls_active) {
+                ls_store_inputs(msg.batch ? chan_batch_items(ch_server_to_dyn) : &msg.input, msg.batch ? msg.batch : 1);
+            }
+            else if (msg.type == MSG_LOCKSTEP) lockstep_start(msg.info);
             else if (msg.type == MSG_OBSTACLE) {
-                if (obs_count < MAX_OBSTACLES) obstacles[obs_count++] = msg.obstacle;
+                // Update by ID: the Blackboard only resends obstacles that changed.
+                // A batch is applied as a whole before the next physics step.
+                const Obstacle *list = msg.batch ? chan_batch_items(ch_server_to_dyn) : &msg.obstacle;
+                for (int k = 0; k < (msg.batch ? msg.batch : 1); k++) {
+                    int id = list[k].id;
+                    if (id >= 0 && id < MAX_OBSTACLES) {
+                        obstacles[id] = list[k];
+                        if (id >= obs_count) obs_count = id + 1;
+                    }
+                }
             }
             else if (msg.type == MSG_TARGET) {
-                if (msg.target.id < MAX_TARGETS) targets[msg.target.id] = msg.target;
+                const Target *list = msg.batch ? chan_batch_items(ch_server_to_dyn) : &msg.target;
+                for (int k = 0; k < (msg.batch ? msg.batch : 1); k++) {
+                    if (list[k].id >= 0 && list[k].id < MAX_TARGETS) targets[list[k].id] = list[k];
+                }
+                // The Blackboard has the last word (multiplayer: another
+                // drone may have collected it): next = lowest active id
+                next_target_needed = MAX_TARGETS;
+                for (int i = MAX_TARGETS - 1; i >= 0; i--) {
+                    if (targets[i].active == 1) next_target_needed = i;
+                }
+            }
+            else if (msg.type == MSG_PLAYER) {
+                const Player *list = chan_batch_items(ch_server_to_dyn);
+                for (int k = 0; k < msg.batch && k < MAX_PLAYERS; k++) players[k] = list[k];
+                send_inputs = (strcmp(msg.info, "inputs") == 0);
+            }
+            else if (msg.type == MSG_CORRECTION) reconcile(msg.seq, &msg.drone);
+            else if (msg.type == MSG_PARAM) {
+                // "KEY VALUE", or "KEY" alone: deleted from params.txt
+                char key[PARAM_KEY_LEN], value[PARAM_VAL_LEN];
+                int fields = sscanf(msg.info, "%31s %127s", key, value);
+                if (fields >= 1) {
+                    if (ls_active && lockstep_settings_key(key)) {
+                        // [FIX] Both peers checked these at the start (LS_HELLO):
+                        // changed on one side only, the session would desync
+                        log_message(SYSTEM_LOG_FILE, "Dynamics", "Change to %s ignored until the lockstep session ends", key);
+                    } else if (fields == 2 && param_set(key, value)) {
+                        log_message(SYSTEM_LOG_FILE, "Dynamics", "Parameter %s = %s applied", key, value);
+                    } else if (fields == 1 && param_remove(key)) {
+                        log_message(SYSTEM_LOG_FILE, "Dynamics", "Parameter %s removed, default applied", key);
+                    }
+                    // Always re-apply: in threads mode the store is shared and
+                    // the Blackboard has already written the new value
+                    apply_params();
+                    if (ls_active) phys = ls_phys;
+                }
             }
-            else if (msg.type == MSG_STOP) exit(0);
+            else if (msg.type == MSG_STOP) { trace_end("read"); return; }
         }
+        trace_end("read");
         //Run physics step
-        update_physics();
-        check_collisions();
-        send_state();
-        usleep(DYNAMICS_RATE);
+        trace_begin("step");
+        double t_now = get_time_sec();
+        if (ls_active) {
+            lockstep_run(t_now);   // Fixed ticks, both drones
+        } else {
+            split_obstacles(t_now);
+            field_update(static_obs, obs_count); // Only the area around moved obstacles
+            record_input(t_now);
+            Vec2 prev = drone.position;
+            update_physics(T);
+            resolve_obstacles(prev, t_prev, t_now);  // Swept: exact at any step size
+            check_collisions(prev);
+            history[input_seq % INPUT_HISTORY].after = drone;
+            t_prev = t_now;
+            send_state();
+        }
+        trace_end("step");
+        double t_done = get_time_sec();
+        metric_add(m_steps, 1);
+        metric_set(m_step_time, t_done - t_now);
+        metric_add(m_step_seconds, t_done - t_now);
+        metrics_heartbeat(t_done);
+        if (t_done >= next_report) {
+            next_report += 5.0;
+            field_report("Dynamics");
+            rt_loop_report(&loop, "Dynamics");
+            if (obstacle_contacts) {
+                log_message(SYSTEM_LOG_FILE, "Dynamics", "%ld obstacle contacts in 5 s (step %.1f ms)",
+                            obstacle_contacts, T * 1000.0);
+                obstacle_contacts = 0;
+            }
+            if (ls_active) {
+                log_message(SYSTEM_LOG_FILE, "Dynamics", "Lockstep: tick %u, %.1f ticks/s, %.0f ms stalled on the peer",
+                            ls_tick, ls_ticks_done / 5.0, ls_stall * 1000.0);
+                ls_ticks_done = 0;
+                ls_stall = 0.0;
+            }
+            if (server_states) {
+                log_message(SYSTEM_LOG_FILE, "Dynamics", "Prediction: %ld server states, %ld corrections (max %.3f m), %ld steps replayed",
+                            server_states, corrections, correction_max, replayed_steps);
+                server_states = corrections = replayed_steps = 0;
+                correction_max = 0.0f;
+            }
+        }
+        loop.period_ns = step_us * 1000L;     // DYNAMICS_RATE may change at run time
+        trace_begin("sleep");
+        rt_loop_wait(&loop);
+        trace_end("sleep");
     }
-    close(fd_server_to_dyn); close(fd_dyn_to_server);
+    chan_close(ch_server_to_dyn); chan_close(ch_dyn_to_server);
 }
\ No newline at end of file
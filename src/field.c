@@ -0,0 +1,211 @@
+#include <math.h>
+#include "field.h"
+
+// Grid state (nodes at (i * res, j * res))
+static float grid_res = 0.0f;       // 0 = disabled
+static float max_error = FIELD_MAX_ERROR;
+static float field_rho = REPULSION_RHO;
+static float field_eta = REPULSION_ETA;
+static int nx = 0, ny = 0;          // Nodes per axis
+static Vec2 *nodes = NULL;          // nx * ny sampled forces
+static unsigned char *exact_cell;   // (nx-1) * (ny-1): 1 = use the exact formula
+static int n_exact_cells = 0;
+static int need_rebuild = 1;
+
+// Obstacles the grid was built from
+static Obstacle built[MAX_OBSTACLES];
+static int built_count = 0;
+
+// Statistics (reset by field_report)
+#define FIELD_SAMPLE_EVERY 100      // 1 lookup in N is checked against the exact field
+static long updates = 0, nodes_updated = 0;
+static double update_time = 0.0;
+static long lookups = 0, exact_lookups = 0;
+static double err_sum = 0.0, err_max = 0.0;
+static long err_samples = 0;
+
+Vec2 field_exact(float x, float y, const Obstacle *obs, int count, float rho, float eta) {
+    Vec2 f = {0.0, 0.0};
+    for (int i = 0; i < count; i++) {
+        if (obs[i].id == -1) continue;
+        float dx = x - obs[i].position.x;
+        float dy = y - obs[i].position.y;
+        float dist = sqrt(dx*dx + dy*dy);
+        if (dist < rho && dist > 0.1) {
+            float mag = eta * (1.0/dist - 1.0/rho) * (1.0/(dist*dist));
+            f.x += mag * (dx / dist);
+            f.y += mag * (dy / dist);
+        }
+    }
+    return f;
+}
+
+static Vec2 *node(int i, int j) { return &nodes[j * nx + i]; }
+
+// Bilinear interpolation inside cell (i, j), u/v in [0, 1]
+static Vec2 interpolate(int i, int j, float u, float v) {
+    Vec2 a = *node(i, j), b = *node(i + 1, j);
+    Vec2 c = *node(i, j + 1), d = *node(i + 1, j + 1);
+    Vec2 f;
+    f.x = (1 - v) * ((1 - u) * a.x + u * b.x) + v * ((1 - u) * c.x + u * d.x);
+    f.y = (1 - v) * ((1 - u) * a.y + u * b.y) + v * ((1 - u) * c.y + u * d.y);
+    return f;
+}
+
+static float error_at(int i, int j, float u, float v, const Obstacle *obs, int count) {
+    Vec2 g = interpolate(i, j, u, v);
+    Vec2 e = field_exact((i + u) * grid_res, (j + v) * grid_res, obs, count, field_rho, field_eta);
+    return hypotf(g.x - e.x, g.y - e.y);
+}
+
+// Recomputes the nodes in [x0,x1] x [y0,y1], then re-flags the cells
+// touching them (the interpolation is checked at the cell center and
+// at the edge midpoints, where it is the least accurate).
+static void recompute_rect(float x0, float y0, float x1, float y1, const Obstacle *all, int all_count) {
+    // Only the obstacles that can reach the rectangle (and the ring of
+    // cells around it, which is re-flagged too)
+    Obstacle obs[MAX_OBSTACLES];
+    int count = 0;
+    float reach = field_rho + grid_res;
+    for (int k = 0; k < all_count && count < MAX_OBSTACLES; k++) {
+        if (all[k].id == -1) continue;
+        if (all[k].position.x < x0 - reach || all[k].position.x > x1 + reach ||
+            all[k].position.y < y0 - reach || all[k].position.y > y1 + reach) continue;
+        obs[count++] = all[k];
+    }
+
+    int i0 = (int)floorf(x0 / grid_res), i1 = (int)ceilf(x1 / grid_res);
+    int j0 = (int)floorf(y0 / grid_res), j1 = (int)ceilf(y1 / grid_res);
+    if (i0 < 0) i0 = 0;
+    if (j0 < 0) j0 = 0;
+    if (i1 > nx - 1) i1 = nx - 1;
+    if (j1 > ny - 1) j1 = ny - 1;
+
+    for (int j = j0; j <= j1; j++) {
+        for (int i = i0; i <= i1; i++) {
+            *node(i, j) = field_exact(i * grid_res, j * grid_res, obs, count, field_rho, field_eta);
+        }
+    }
+    nodes_updated += (long)(i1 - i0 + 1) * (j1 - j0 + 1);
+
+    if (i0 > 0) i0--;
+    if (j0 > 0) j0--;
+    if (i1 > nx - 2) i1 = nx - 2;
+    if (j1 > ny - 2) j1 = ny - 2;
+    for (int j = j0; j <= j1; j++) {
+        for (int i = i0; i <= i1; i++) {
+            unsigned char *flag = &exact_cell[j * (nx - 1) + i];
+            int bad = error_at(i, j, 0.5f, 0.5f, obs, count) > max_error ||
+                      error_at(i, j, 0.5f, 0.0f, obs, count) > max_error ||
+                      error_at(i, j, 0.0f, 0.5f, obs, count) > max_error ||
+                      error_at(i, j, 0.5f, 1.0f, obs, count) > max_error ||
+                      error_at(i, j, 1.0f, 0.5f, obs, count) > max_error;
+            n_exact_cells += bad - *flag;
+            *flag = (unsigned char)bad;
+        }
+    }
+}
+
+void field_configure(float res, float max_err, float rho, float eta) {
+    if (res > 0.0f && res < 0.1f) res = 0.1f; // Keeps the grid under 10 MB
+    if (res == grid_res && max_err == max_error && rho == field_rho && eta == field_eta) return;
+    grid_res = res;
+    max_error = max_err;
+    field_rho = rho;
+    field_eta = eta;
+    need_rebuild = 1;
+
+    free(nodes); free(exact_cell);
+    nodes = NULL; exact_cell = NULL;
+    if (grid_res <= 0.0f) return;
+
+    nx = (int)ceilf(MAP_WIDTH / grid_res) + 1;
+    ny = (int)ceilf(MAP_HEIGHT / grid_res) + 1;
+    nodes = calloc((size_t)nx * ny, sizeof(Vec2));
+    exact_cell = calloc((size_t)(nx - 1) * (ny - 1), 1);
+    if (!nodes || !exact_cell) {
+        log_message(SYSTEM_LOG_FILE, "Field", "Grid allocation failed, using the exact field");
+        free(nodes); free(exact_cell);
+        nodes = NULL; exact_cell = NULL;
+        grid_res = 0.0f;
+    }
+}
+
+void field_update(const Obstacle *obs, int count) {
+    if (!nodes) return;
+    double start = get_time_sec();
+    int changed = 0;
+
+    if (need_rebuild) {
+        memset(exact_cell, 0, (size_t)(nx - 1) * (ny - 1));
+        n_exact_cells = 0;
+        recompute_rect(0, 0, MAP_WIDTH, MAP_HEIGHT, obs, count);
+        need_rebuild = 0;
+        changed = 1;
+    } else {
+        // Only the disc of influence around the old and the new position
+        int n = (count > built_count) ? count : built_count;
+        for (int i = 0; i < n; i++) {
+            Obstacle old = (i < built_count) ? built[i] : (Obstacle){ .id = -1 };
+            Obstacle cur = (i < count) ? obs[i] : (Obstacle){ .id = -1 };
+            if (old.id == cur.id && (cur.id == -1 ||
+                (old.position.x == cur.position.x && old.position.y == cur.position.y))) continue;
+
+            float r = field_rho + grid_res;
+            if (old.id != -1) recompute_rect(old.position.x - r, old.position.y - r,
+                                             old.position.x + r, old.position.y + r, obs, count);
+            if (cur.id != -1) recompute_rect(cur.position.x - r, cur.position.y - r,
+                                             cur.position.x + r, cur.position.y + r, obs, count);
+            changed = 1;
+        }
+    }
+
+    if (changed) {
+        memcpy(built, obs, sizeof(Obstacle) * count);
+        built_count = count;
+        updates++;
+        update_time += get_time_sec() - start;
+    }
+}
+
+Vec2 field_force(float x, float y, const Obstacle *obs, int count) {
+    if (!nodes) return field_exact(x, y, obs, count, field_rho, field_eta);
+    lookups++;
+
+    float gx = x / grid_res, gy = y / grid_res;
+    int i = (int)gx, j = (int)gy;
+    if (i < 0) i = 0;
+    if (j < 0) j = 0;
+    if (i > nx - 2) i = nx - 2;
+    if (j > ny - 2) j = ny - 2;
+
+    if (exact_cell[j * (nx - 1) + i]) {
+        exact_lookups++;
+        return field_exact(x, y, obs, count, field_rho, field_eta);
+    }
+
+    float u = gx - i, v = gy - j;
+    Vec2 f = interpolate(i, j, u, v);
+    if (lookups % FIELD_SAMPLE_EVERY == 0) {
+        Vec2 e = field_exact(x, y, obs, count, field_rho, field_eta);
+        double err = hypotf(f.x - e.x, f.y - e.y);
+        err_sum += err; err_samples++;
+        if (err > err_max) err_max = err;
+    }
+    return f;
+}
+
+void field_report(const char *who) {
+    if (!nodes) return;
+    log_message(SYSTEM_LOG_FILE, who,
+                "Field grid %dx%d (%.2f m): %ld updates (%ld nodes, avg %.1f us), %d exact cells, "
+                "%.1f%% exact lookups, error avg %.4f max %.4f N (%ld samples, limit %.2f)",
+                nx, ny, grid_res, updates, nodes_updated,
+                updates ? update_time / updates * 1e6 : 0.0, n_exact_cells,
+                lookups ? 100.0 * exact_lookups / lookups : 0.0,
+                err_samples ? err_sum / err_samples : 0.0, err_max, err_samples, max_error);
+    updates = nodes_updated = 0;
+    update_time = 0.0;
+    lookups = exact_lookups = err_samples = 0;
+    err_sum = err_max = 0.0;
+}
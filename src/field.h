@@ -0,0 +1,36 @@
+#ifndef FIELD_H
+#define FIELD_H
+
+#include "common.h"
+
+// REPULSION FIELD LATTICE
+// The Khatib repulsion of all obstacles is sampled on a grid over the
+// MAP_WIDTH x MAP_HEIGHT world. A force query is a bilinear interpolation
+// of the 4 surrounding nodes (O(1), whatever the number of obstacles).
+// When an obstacle moves, only the nodes within REPULSION_RHO of its old
+// and new position are recomputed.
+// Cells where the interpolation is worse than FIELD_MAX_ERROR (next to an
+// obstacle, where the field grows like 1/d^2) are flagged and use the
+// exact formula instead.
+
+#define FIELD_GRID_RES   0.5f   // Default node spacing (meters)
+#define FIELD_MAX_ERROR  1.0f   // Default max interpolation error (Newtons)
+
+// Exact field at (x, y): sum over the obstacles within rho
+Vec2 field_exact(float x, float y, const Obstacle *obs, int count, float rho, float eta);
+
+// (Re)configures the grid. res <= 0 disables it (every query is exact).
+// A change of any value schedules a full rebuild.
+void field_configure(float res, float max_err, float rho, float eta);
+
+// Compares the obstacles with the ones the grid was built from and
+// recomputes the affected nodes. Call before field_force() each step.
+void field_update(const Obstacle *obs, int count);
+
+// Repulsive force at (x, y): grid lookup, or exact in flagged cells
+Vec2 field_force(float x, float y, const Obstacle *obs, int count);
+
+// Logs the grid size, the update cost and the measured error
+void field_report(const char *who);
+
+#endif
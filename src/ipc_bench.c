@@ -0,0 +1,381 @@
+#define _GNU_SOURCE   // sched_setaffinity
+#include "common.h"
+#include "channel.h"
+#include <sched.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+
+// IPC TRANSPORT BENCHMARKS
+// Fixed-size records between two processes, through each transport:
+//   rate     a producer pushes N records as fast as it can, a consumer
+//            drains them (sleeping only when the transport is empty)
+//   latency  ping-pong over a pair of links: one-way = round trip / 2
+//            (p50 / p99 / max, after a warm-up)
+// Transports:
+//   fifo        mkfifo + O_NONBLOCK, the reader waits in ppoll (Channel FIFO: today's path)
+//   fifo-block  mkfifo, blocking read / write
+//   unix        AF_UNIX SOCK_SEQPACKET socket pair, blocking
+//   ring        shared-memory SPSC ring, the reader waits on a futex (Channel RING)
+// Sizes: bytes per record, "full" = sizeof(Message) (what every IPC
+// message costs today); smaller ones are what a framed payload would be.
+// Placement: none (the scheduler decides), same (both on CPU 0), split
+// (CPU 0 / CPU 1; skipped on a single CPU).
+// One CSV line (or JSON object) per run, for tracking regressions.
+// Usage: ./ipc_bench [--messages N] [--roundtrips N] [--transports LIST]
+//                    [--sizes LIST] [--placement LIST] [--format csv|json]
+
+#define BENCH_CHANNEL      "/tmp/fifo_ipc_bench"
+#define BENCH_CHANNEL_BACK "/tmp/fifo_ipc_bench_back"
+#define BENCH_MAX_SIZE     PIPE_BUF     // A FIFO write is atomic up to this
+#define BENCH_MIN_SIZE     8            // The sequence number
+#define BENCH_WARMUP       100          // Round trips not measured
+
+enum { T_FIFO, T_FIFO_BLOCK, T_UNIX, T_RING, TRANSPORTS };
+static const char *TRANSPORT_NAMES[TRANSPORTS] = { "fifo", "fifo-block", "unix", "ring" };
+
+enum { PLACE_NONE, PLACE_SAME, PLACE_SPLIT, PLACEMENTS };
+static const char *PLACEMENT_NAMES[PLACEMENTS] = { "none", "same", "split" };
+
+// One direction between the two processes (created before fork)
+typedef struct {
+    const char *path;
+    int sv[2];          // unix: the socket pair
+} Link;
+
+// This process' end of a link
+typedef struct {
+    int transport;
+    Channel *ch;        // fifo, ring
+    int fd;             // fifo-block, unix
+} End;
+
+typedef struct {
+    int status;         // 0 ok, -1 failed, 1 skipped
+    double seconds;
+    double p50, p99, max;   // One-way latency (s)
+} Result;
+
+static int json = 0;
+static cpu_set_t original_cpus;
+static int pin_cpu[2] = { -1, -1 };     // First two CPUs we may run on
+
+static int link_create(int t, Link *l, const char *path) {
+    l->path = path;
+    if (t == T_UNIX) return socketpair(AF_UNIX, SOCK_SEQPACKET, 0, l->sv);
+    unlink(path);
+    if (mkfifo(path, 0666) == -1) { perror("mkfifo bench"); return -1; }
+    chan_set_transport(path, t == T_RING ? CHAN_RING : CHAN_FIFO);
+    if (t == T_RING && chan_create(path) < 0) return -1;
+    return 0;
+}
+
+static void link_remove(int t, Link *l) {
+    if (t == T_UNIX) { close(l->sv[0]); close(l->sv[1]); return; }
+    if (t == T_RING) chan_unlink(l->path);
+    unlink(l->path);
+}
+
+// 'child': which end of a socket pair is ours
+static int link_open(int t, Link *l, int dir, int child, End *e) {
+    memset(e, 0, sizeof(End));
+    e->transport = t;
+    e->fd = -1;
+    if (t == T_UNIX) {
+        e->fd = dup(l->sv[child]);
+        return e->fd;
+    }
+    if (t == T_FIFO_BLOCK) {
+        e->fd = open(l->path, dir == CHAN_READ ? O_RDONLY : O_WRONLY);
+        return e->fd;
+    }
+    e->ch = chan_open(l->path, dir);
+    return e->ch ? 0 : -1;
+}
+
+static int end_send(End *e, const void *buf, size_t len) {
+    if (e->ch) {
+        while (chan_send_raw(e->ch, buf, len) < 0) {
+            if (errno != EAGAIN) return -1;
+            sched_yield();      // Full: let the consumer run
+        }
+        return 0;
+    }
+    return (write(e->fd, buf, len) == (ssize_t)len) ? 0 : -1;
+}
+
+static int end_recv(End *e, void *buf, size_t len) {
+    if (e->ch) {
+        for (;;) {
+            int n = chan_recv_raw(e->ch, buf, len);
+            if (n != 0) return n;
+            chan_wait(e->ch, 100000);
+        }
+    }
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(e->fd, (unsigned char *)buf + got, len - got);
+        if (n <= 0) return -1;
+        got += n;
+        if (e->transport == T_UNIX) break;  // One record per read
+    }
+    return (int)got;
+}
+
+static void end_close(End *e) {
+    if (e->ch) chan_close(e->ch);
+    if (e->fd >= 0) close(e->fd);
+}
+
+static int pin(int cpu) {
+    if (cpu < 0) return -1;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+// Pins this process: 'role' 0 = producer / pinger, 1 = consumer / echo.
+// Returns -1 if the pinning failed.
+static int place(int placement, int role) {
+    if (placement == PLACE_NONE) return 0;
+    return pin(pin_cpu[(placement == PLACE_SPLIT) ? role : 0]);
+}
+
+static void place_restore(void) {
+    sched_setaffinity(0, sizeof(original_cpus), &original_cpus);
+}
+
+static void run_rate(int t, size_t size, int placement, long count, Result *r) {
+    Link l;
+    r->status = -1;
+    if (link_create(t, &l, BENCH_CHANNEL) < 0) return;
+
+    fflush(stdout);
+    pid_t consumer = fork();
+    if (consumer == 0) {
+        if (place(placement, 1) < 0) _exit(1);
+        End e;
+        unsigned char buf[BENCH_MAX_SIZE];
+        if (link_open(t, &l, CHAN_READ, 1, &e) < 0) _exit(1);
+        for (long received = 0; received < count; received++) {
+            if (end_recv(&e, buf, size) != (int)size) _exit(1);
+        }
+        end_close(&e);
+        _exit(0);
+    }
+
+    End e;
+    unsigned char buf[BENCH_MAX_SIZE];
+    memset(buf, 0, size);
+    if (place(placement, 0) == 0 && link_open(t, &l, CHAN_WRITE, 0, &e) >= 0) {
+        double start = get_time_sec();
+        long i;
+        for (i = 0; i < count; i++) {
+            memcpy(buf, &i, sizeof(i));
+            if (end_send(&e, buf, size) < 0) break;
+        }
+        int status = 0;
+        waitpid(consumer, &status, 0);
+        r->seconds = get_time_sec() - start;
+        if (i == count && WIFEXITED(status) && WEXITSTATUS(status) == 0) r->status = 0;
+        end_close(&e);
+    } else {
+        kill(consumer, SIGKILL);
+        waitpid(consumer, NULL, 0);
+    }
+    link_remove(t, &l);
+    place_restore();
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_latency(int t, size_t size, int placement, long rounds, Result *r) {
+    Link ab, ba;
+    r->status = -1;
+    if (link_create(t, &ab, BENCH_CHANNEL) < 0) return;
+    if (link_create(t, &ba, BENCH_CHANNEL_BACK) < 0) { link_remove(t, &ab); return; }
+    long total = rounds + BENCH_WARMUP;
+
+    fflush(stdout);
+    pid_t echo = fork();
+    if (echo == 0) {
+        if (place(placement, 1) < 0) _exit(1);
+        End in, out;
+        unsigned char buf[BENCH_MAX_SIZE];
+        // Same open order as the pinger (a blocking FIFO open waits for the other end)
+        if (link_open(t, &ab, CHAN_READ, 1, &in) < 0 || link_open(t, &ba, CHAN_WRITE, 1, &out) < 0) _exit(1);
+        for (long i = 0; i < total; i++) {
+            if (end_recv(&in, buf, size) != (int)size || end_send(&out, buf, size) < 0) _exit(1);
+        }
+        end_close(&in);
+        end_close(&out);
+        _exit(0);
+    }
+
+    End out, in;
+    unsigned char buf[BENCH_MAX_SIZE];
+    memset(buf, 0, size);
+    double *samples = malloc(rounds * sizeof(double));
+    long done = 0;
+    if (samples && place(placement, 0) == 0 && link_open(t, &ab, CHAN_WRITE, 0, &out) >= 0 && link_open(t, &ba, CHAN_READ, 0, &in) >= 0) {
+        for (long i = 0; i < total; i++) {
+            memcpy(buf, &i, sizeof(i));
+            double t0 = get_time_sec();
+            if (end_send(&out, buf, size) < 0 || end_recv(&in, buf, size) != (int)size) break;
+            if (i >= BENCH_WARMUP) samples[done++] = (get_time_sec() - t0) / 2.0;
+        }
+        end_close(&out);
+        end_close(&in);
+    }
+    int status = 0;
+    if (done < rounds) kill(echo, SIGKILL);
+    waitpid(echo, &status, 0);
+    if (done == rounds && rounds > 0) {
+        qsort(samples, rounds, sizeof(double), cmp_double);
+        r->p50 = samples[(long)(0.50 * (rounds - 1))];
+        r->p99 = samples[(long)(0.99 * (rounds - 1))];
+        r->max = samples[rounds - 1];
+        r->status = 0;
+    }
+    free(samples);
+    link_remove(t, &ab);
+    link_remove(t, &ba);
+    place_restore();
+}
+
+static void print_header(void) {
+    if (!json) printf("transport,size,placement,status,messages,seconds,msg_per_s,mb_per_s,"
+                      "roundtrips,lat_p50_us,lat_p99_us,lat_max_us\n");
+}
+
+static void print_result(int t, size_t size, int placement, long count, const Result *rate,
+                         long rounds, const Result *lat) {
+    const char *status = (rate->status == 1) ? "skipped" : (rate->status < 0 || lat->status < 0) ? "failed" : "ok";
+    double msg_s = (rate->status == 0 && rate->seconds > 0) ? count / rate->seconds : 0.0;
+    double mb_s = msg_s * size / 1e6;
+    if (json) {
+        printf("{\"transport\":\"%s\",\"size\":%zu,\"placement\":\"%s\",\"status\":\"%s\",\"messages\":%ld,"
+               "\"seconds\":%.6f,\"msg_per_s\":%.0f,\"mb_per_s\":%.2f,\"roundtrips\":%ld,"
+               "\"lat_p50_us\":%.2f,\"lat_p99_us\":%.2f,\"lat_max_us\":%.2f}\n",
+               TRANSPORT_NAMES[t], size, PLACEMENT_NAMES[placement], status, count, rate->seconds,
+               msg_s, mb_s, rounds, lat->p50 * 1e6, lat->p99 * 1e6, lat->max * 1e6);
+    } else {
+        printf("%s,%zu,%s,%s,%ld,%.6f,%.0f,%.2f,%ld,%.2f,%.2f,%.2f\n",
+               TRANSPORT_NAMES[t], size, PLACEMENT_NAMES[placement], status, count, rate->seconds,
+               msg_s, mb_s, rounds, lat->p50 * 1e6, lat->p99 * 1e6, lat->max * 1e6);
+    }
+}
+
+// Comma separated names -> bit mask (-1 if one is unknown)
+static int parse_names(const char *list, const char **names, int n) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", list);
+    int mask = 0;
+    for (char *tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+        int found = -1;
+        for (int i = 0; i < n; i++) if (strcmp(tok, names[i]) == 0) found = i;
+        if (found < 0) return -1;
+        mask |= 1 << found;
+    }
+    return mask;
+}
+
+// Comma separated sizes ("full" = sizeof(Message)); returns how many
+static int parse_sizes(const char *list, size_t *sizes, int max) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", list);
+    int n = 0;
+    for (char *tok = strtok(buf, ","); tok && n < max; tok = strtok(NULL, ",")) {
+        size_t s = (strcmp(tok, "full") == 0) ? sizeof(Message) : (size_t)atol(tok);
+        if (s < BENCH_MIN_SIZE || s > BENCH_MAX_SIZE) return -1;
+        sizes[n++] = s;
+    }
+    return n;
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [--messages N] [--roundtrips N] [--transports LIST] [--sizes LIST]\n"
+           "       [--placement LIST] [--format csv|json] [messages]\n", prog);
+    printf("  --messages    Records per rate run (default 200000)\n");
+    printf("  --roundtrips  Ping-pongs per latency run (default 20000)\n");
+    printf("  --transports  fifo,fifo-block,unix,ring (default all)\n");
+    printf("  --sizes       Bytes per record, %d-%d or full (default 16,64,full = %zu)\n",
+           BENCH_MIN_SIZE, BENCH_MAX_SIZE, sizeof(Message));
+    printf("  --placement   none,same,split (default all)\n");
+    printf("  --format      csv (default, with a header) or json (one object per line)\n");
+}
+
+int main(int argc, char *argv[]) {
+    long count = 200000, rounds = 20000;
+    int transports = (1 << TRANSPORTS) - 1;
+    int placements = (1 << PLACEMENTS) - 1;
+    size_t sizes[16];
+    int n_sizes = parse_sizes("16,64,full", sizes, 16);
+
+    static const struct option options[] = {
+        { "messages",   required_argument, NULL, 'n' },
+        { "roundtrips", required_argument, NULL, 'r' },
+        { "transports", required_argument, NULL, 't' },
+        { "sizes",      required_argument, NULL, 's' },
+        { "placement",  required_argument, NULL, 'p' },
+        { "format",     required_argument, NULL, 'f' },
+        { "help",       no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:r:t:s:p:f:h", options, NULL)) != -1) {
+        switch (opt) {
+            case 'n': count = atol(optarg); break;
+            case 'r': rounds = atol(optarg); break;
+            case 't': transports = parse_names(optarg, TRANSPORT_NAMES, TRANSPORTS); break;
+            case 's': n_sizes = parse_sizes(optarg, sizes, 16); break;
+            case 'p': placements = parse_names(optarg, PLACEMENT_NAMES, PLACEMENTS); break;
+            case 'f': json = (strcmp(optarg, "json") == 0); break;
+            default: usage(argv[0]); return (opt == 'h') ? 0 : 1;
+        }
+    }
+    if (optind < argc) count = atol(argv[optind]);     // ./ipc_bench [messages], as before
+    if (count <= 0 || rounds <= 0 || transports <= 0 || placements <= 0 || n_sizes <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    // same / split use the CPUs we are allowed on (not always 0 and 1).
+    // A placement we cannot pin to is skipped; a pinning that fails
+    // during a run fails the row.
+    int pinnable[2] = { 0, 0 };
+    if (sched_getaffinity(0, sizeof(original_cpus), &original_cpus) == 0) {
+        for (int c = 0, n = 0; c < CPU_SETSIZE && n < 2; c++) {
+            if (CPU_ISSET(c, &original_cpus)) pin_cpu[n++] = c;
+        }
+        for (int i = 0; i < 2; i++) pinnable[i] = (pin(pin_cpu[i]) == 0);
+        place_restore();
+    }
+    int can_place[PLACEMENTS] = { 0 };
+    can_place[PLACE_NONE] = 1;
+    can_place[PLACE_SAME] = pinnable[0];
+    can_place[PLACE_SPLIT] = pinnable[0] && pinnable[1];
+
+    print_header();
+    for (int t = 0; t < TRANSPORTS; t++) {
+        if (!(transports & (1 << t))) continue;
+        for (int s = 0; s < n_sizes; s++) {
+            for (int p = 0; p < PLACEMENTS; p++) {
+                if (!(placements & (1 << p))) continue;
+                Result rate = { 0 }, lat = { 0 };
+                if (!can_place[p]) {
+                    rate.status = 1;
+                } else {
+                    run_rate(t, sizes[s], p, count, &rate);
+                    run_latency(t, sizes[s], p, rounds, &lat);
+                }
+                print_result(t, sizes[s], p, count, &rate, rounds, &lat);
+            }
+        }
+    }
+    return 0;
+}
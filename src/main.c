@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -6,13 +7,38 @@
 #include <fcntl.h>
 #include <sys/wait.h>
 #include <signal.h> 
+#include <pthread.h>
+#include <getopt.h>
 #include "common.h"
+#include "params.h"
+#include "channel.h"
+#include "ready.h"
+#include "metrics.h"
+#include "trace.h"
 
-// Signal Handler
-void handle_sigint(int sig) {
-    log_message(SYSTEM_LOG_FILE, "Main", "Received SIGINT. Shutting down system...");
-    printf("\n[Main] Shutdown complete. See system.log for details.\n");
-    // Clean up pipes on exit
+// Channels between the internal components (never used by the UI windows).
+// They can be FIFOs, shared-memory rings, or in-process rings (threads mode).
+static const char *INTERNAL_CHANNELS[] = {
+    PIPE_DYN_TO_SERVER, PIPE_SERVER_TO_DYN, PIPE_OBS_TO_SERVER, PIPE_TAR_TO_SERVER
+};
+#define N_INTERNAL_CHANNELS (int)(sizeof(INTERNAL_CHANNELS) / sizeof(INTERNAL_CHANNELS[0]))
+
+void run_dynamics();   
+void run_obstacles(); 
+void run_targets();   
+
+// Internal children (process mode), stopped if startup fails
+static pid_t children[5];
+static int n_children = 0;
+
+static void start_child(void (*fn)(void)) {
+    pid_t pid = fork();
+    if (pid == 0) { signal(SIGINT, SIG_DFL); fn(); exit(0); }
+    if (pid > 0) children[n_children++] = pid;
+}
+
+// Clean up pipes on exit
+static void remove_channels(void) {
     unlink(PIPE_UI_TO_SERVER);
     unlink(PIPE_SERVER_TO_UI_INPUT);
     unlink(PIPE_SERVER_TO_MAP);
@@ -20,16 +46,28 @@ void handle_sigint(int sig) {
     unlink(PIPE_DYN_TO_SERVER);
     unlink(PIPE_OBS_TO_SERVER);
     unlink(PIPE_TAR_TO_SERVER);
+    for (int i = 0; i < N_INTERNAL_CHANNELS; i++) chan_unlink(INTERNAL_CHANNELS[i]);
+    metrics_unlink();
+    char viewer_socket[PARAM_VAL_LEN];
+    unlink(param_get_str("VIEWER_SOCKET", VIEWER_SOCKET, viewer_socket, sizeof(viewer_socket)));
+}
+
+// Signal Handler
+void handle_sigint(int sig) {
+    log_message(SYSTEM_LOG_FILE, "Main", "Received SIGINT. Shutting down system...");
+    printf("\n[Main] Shutdown complete. See system.log for details.\n");
+    remove_channels();
     exit(0);
 }
 
-// Spawn terminal helper
-void spawn_terminal(const char* program_path) {
+// Spawn terminal helper ('attach': viewer socket passed as --attach, or NULL)
+void spawn_terminal(const char* program_path, const char *attach) {
     pid_t pid = fork();
     if (pid == 0) {
-        execlp("konsole", "konsole", "-e", program_path, NULL);
-        execlp("gnome-terminal", "gnome-terminal", "--", program_path, NULL);
-        execlp("xterm", "xterm", "-e", program_path, NULL);
+        const char *opt = attach ? "--attach" : NULL;
+        execlp("konsole", "konsole", "-e", program_path, opt, attach, NULL);
+        execlp("gnome-terminal", "gnome-terminal", "--", program_path, opt, attach, NULL);
+        execlp("xterm", "xterm", "-e", program_path, opt, attach, NULL);
         perror("[Main] Error: Could not launch a new terminal window");
         exit(1);
     }
@@ -47,35 +85,118 @@ void create_named_pipes() {
     unlink(PIPE_OBS_TO_SERVER);      if (mkfifo(PIPE_OBS_TO_SERVER, mode) == -1) perror("mkfifo Obs->Server");
     unlink(PIPE_TAR_TO_SERVER);      if (mkfifo(PIPE_TAR_TO_SERVER, mode) == -1) perror("mkfifo Tar->Server");
     printf("[Main] All Named Pipes (FIFOs) created in /tmp/.\n");
+
+    // Shared counters of all the components (served by the Blackboard)
+    if (metrics_create() < 0) printf("[Main] Metrics mapping failed, metrics are not exported.\n");
+
+    // Channels switched to a ring (IPC_TRANSPORT ring, or threads mode)
+    for (int i = 0; i < N_INTERNAL_CHANNELS; i++) {
+        const char *name = INTERNAL_CHANNELS[i];
+        if (chan_get_transport(name) == CHAN_FIFO) continue;
+        if (chan_create(name) < 0) {
+            printf("[Main] Ring for %s failed, using the FIFO.\n", name);
+            chan_set_transport(name, CHAN_FIFO);
+        }
+    }
 }
 
-void run_blackboard(int mode); 
-void run_dynamics();   
-void run_obstacles(); 
-void run_targets();   
+// THREADS MODE: the same entry points, run as threads of this process
+static int thread_mode_arg;
+static const char *server_ip = NULL;   // --ip (client mode)
+static void *blackboard_thread(void *arg) { run_blackboard(thread_mode_arg, server_ip); return NULL; }
+static void *dynamics_thread(void *arg)   { run_dynamics(); return NULL; }
+static void *obstacles_thread(void *arg)  { run_obstacles(); return NULL; }
+static void *targets_thread(void *arg)    { run_targets(); return NULL; }
+
+static pthread_t start_thread(void *(*fn)(void *), const char *name) {
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, fn, NULL) != 0) {
+        perror("pthread_create");
+        exit(1);
+    }
+    pthread_setname_np(tid, name);
+    return tid;
+}
+
+
+static void usage(const char *prog) {
+    printf("Usage: %s [--mode standalone|server|client] [--ip ADDR] [--headless] [--timeout SEC] [--autopilot]\n", prog);
+    printf("  --mode      Skip the mode prompt\n");
+    printf("  --ip        Server address in client mode (skips the IP prompt)\n");
+    printf("  --headless  Do not open the Map, Input and Watchdog windows\n");
+    printf("  --timeout   Max wait for the components to be ready (default %.0f s)\n", READY_TIMEOUT);
+    printf("  --autopilot Fly the targets with ./autopilot (benchmark driver, no Input Window)\n");
+}
+
+static int mode_from_name(const char *s) {
+    if (strcmp(s, "standalone") == 0 || strcmp(s, "1") == 0) return MODE_STANDALONE;
+    if (strcmp(s, "server") == 0 || strcmp(s, "2") == 0) return MODE_SERVER;
+    if (strcmp(s, "client") == 0 || strcmp(s, "3") == 0) return MODE_CLIENT;
+    return -1;
+}
+
+// Startup failed: stop what was started and clean up
+static void abort_startup(void) {
+    for (int i = 0; i < n_children; i++) kill(children[i], SIGTERM);
+    remove_channels();
+    exit(1);
+}
 
-int main() {
+int main(int argc, char *argv[]) {
     signal(SIGINT, handle_sigint);
 
     signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0); // Line by line, also when piped to a script
+
+    // STEP 0: COMMAND LINE (non-interactive startup for scripts)
+    int mode = -1;
+    int headless = 0;
+    int autopilot = 0;
+    double ready_timeout = READY_TIMEOUT;
+    static const struct option options[] = {
+        { "mode",     required_argument, NULL, 'm' },
+        { "ip",       required_argument, NULL, 'i' },
+        { "headless", no_argument,       NULL, 'H' },
+        { "timeout",  required_argument, NULL, 't' },
+        { "autopilot", no_argument,      NULL, 'a' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "m:i:Ht:ah", options, NULL)) != -1) {
+        switch (opt) {
+            case 'm':
+                mode = mode_from_name(optarg);
+                if (mode < 0) { usage(argv[0]); return 1; }
+                break;
+            case 'i': server_ip = optarg; break;
+            case 'H': headless = 1; break;
+            case 't': ready_timeout = atof(optarg); break;
+            case 'a': autopilot = 1; break;
+            default: usage(argv[0]); return (opt == 'h') ? 0 : 1;
+        }
+    }
 
     // STEP 1: SELECT MODE 
-    int mode = 0; 
-    printf("\n=== DRONE SIMULATOR - ASSIGNMENT 3 ===\n");
-    printf("Select Operation Mode:\n");
-    printf("1. Standalone (Assignment 2)\n");
-    printf("2. Server (Host Multiplayer)\n");
-    printf("3. Client (Join Multiplayer)\n");
-    printf("Enter choice (1-3): ");
-    
-    int choice;
-    if (scanf("%d", &choice) == 1) {
-        if (choice == 1) mode = MODE_STANDALONE;
-        else if (choice == 2) mode = MODE_SERVER;
-        else if (choice == 3) mode = MODE_CLIENT;
+    if (mode < 0) {
+        mode = 0;
+        printf("\n=== DRONE SIMULATOR - ASSIGNMENT 3 ===\n");
+        printf("Select Operation Mode:\n");
+        printf("1. Standalone (Assignment 2)\n");
+        printf("2. Server (Host Multiplayer)\n");
+        printf("3. Client (Join Multiplayer)\n");
+        printf("Enter choice (1-3): ");
+        
+        int choice;
+        if (scanf("%d", &choice) == 1) {
+            if (choice == 1) mode = MODE_STANDALONE;
+            else if (choice == 2) mode = MODE_SERVER;
+            else if (choice == 3) mode = MODE_CLIENT;
+        }
+        // This prevents the "Enter Server IP" step from being skipped!
+        while (getchar() != '\n'); 
     }
-    // This prevents the "Enter Server IP" step from being skipped!
-    while (getchar() != '\n'); 
+    double t_start = get_time_sec();
 
     // Cleanup
     remove(PROCESS_LIST_FILE);
@@ -87,41 +208,152 @@ int main() {
     log_message(SYSTEM_LOG_FILE, "Main", "System starting in mode %d...", mode);
 
     // STEP 2: CREATE PIPES  
+    // The transport is chosen before fork() so both ends agree.
+    // DEPLOYMENT threads: Blackboard, Dynamics and Generators run as threads
+    // of this process and talk through in-process rings (no syscalls).
+    // Parameters are parsed here, once: the components inherit the store
+    // (fork) or share it (threads) and never reload it from scratch.
+    params_load(PARAMS_FILE);
+    // TRACE 1: every component (and the windows) appends its timeline to one file
+    if (param_get_int("TRACE", 0)) {
+        char trace_file[PARAM_VAL_LEN];
+        param_get_str("TRACE_FILE", TRACE_FILE, trace_file, sizeof(trace_file));
+        if (trace_create(trace_file) == 0) {
+            printf("[Main] Tracing to %s (open it in https://ui.perfetto.dev).\n", trace_file);
+            log_message(SYSTEM_LOG_FILE, "Main", "Tracing to %s", trace_file);
+        } else {
+            printf("[Main] Trace file %s could not be created, tracing off.\n", trace_file);
+        }
+    }
+    char value[PARAM_VAL_LEN];
+    int use_threads = (strcmp(param_get_str("DEPLOYMENT", "processes", value, sizeof(value)), "threads") == 0);
+    int transport = use_threads ? CHAN_INPROC : chan_transport_from_name(param_get_str("IPC_TRANSPORT", "fifo", value, sizeof(value)));
+    for (int i = 0; i < N_INTERNAL_CHANNELS; i++) chan_set_transport(INTERNAL_CHANNELS[i], transport);
     create_named_pipes();
 
+    // NET_SYNC world (default): the server owns obstacles and targets and
+    // shares them with the client (NET_SYNC legacy: drones only; NET_SYNC
+    // lockstep: each Dynamics simulates the world from a shared seed)
+    int owns_world = (mode == MODE_STANDALONE) ||
+                     (mode == MODE_SERVER && strcmp(param_get_str("NET_SYNC", "world", value, sizeof(value)), "world") == 0);
+
+    // Readiness: one eventfd per component, inherited by the children
+    if (ready_init() < 0) abort_startup();
+
     // LAUNCH PROCESSES 
-    
-    // 1. Blackboard Server
-    if (fork() == 0) { 
-        signal(SIGINT, SIG_DFL); 
-        run_blackboard(mode); 
-        exit(0); 
-    } 
-
-    // 2. Dynamics
-    if (fork() == 0) { signal(SIGINT, SIG_DFL); run_dynamics(); exit(0); }
-
-    // 3. Generators & Watchdog (Only Standalone)
-    if (mode == MODE_STANDALONE) {
-        if (fork() == 0) { signal(SIGINT, SIG_DFL); run_obstacles(); exit(0); }
-        if (fork() == 0) { signal(SIGINT, SIG_DFL); run_targets(); exit(0); }
+    pthread_t bb_thread = 0;
+    if (use_threads) {
+        printf("[Main] Threads mode: Blackboard, Dynamics and Generators run in this process.\n");
+        log_message(SYSTEM_LOG_FILE, "Main", "Deployment: threads (in-process channels)");
+        thread_mode_arg = mode;
+        bb_thread = start_thread(blackboard_thread, "blackboard");
+        start_thread(dynamics_thread, "dynamics");
+        if (owns_world) {
+            start_thread(obstacles_thread, "obstacles");
+            start_thread(targets_thread, "targets");
+        }
+    } else {
+        // 1. Blackboard Server
+        pid_t bb_pid = fork();
+        if (bb_pid == 0) { 
+            signal(SIGINT, SIG_DFL); 
+            run_blackboard(mode, server_ip); 
+            exit(0); 
+        } 
+        if (bb_pid > 0) children[n_children++] = bb_pid;
+
+        // 2. Dynamics
+        start_child(run_dynamics);
+
+        // 3. Generators (Standalone, or the server of a shared world)
+        if (owns_world) {
+            start_child(run_obstacles);
+            start_child(run_targets);
+        }
+    }
+
+    // STEP 3: WAIT FOR READINESS
+    // Every component reports through its eventfd; no guessing, no polling.
+    ReadySlot wanted[] = { READY_BLACKBOARD, READY_DYNAMICS, READY_OBSTACLES, READY_TARGETS };
+    int n_wanted = owns_world ? 4 : 2;
+    double elapsed[READY_COUNT];
+    if (ready_wait(wanted, n_wanted, ready_timeout, t_start, elapsed) < 0) {
+        printf("[Main] Startup failed: not ready after %.1f s:", ready_timeout);
+        for (int i = 0; i < n_wanted; i++) {
+            if (elapsed[wanted[i]] < 0) printf(" %s", ready_name(wanted[i]));
+        }
+        printf("\n");
+        log_message(SYSTEM_LOG_FILE, "Main", "Startup failed: components not ready after %.1f s", ready_timeout);
+        abort_startup();
+    }
+    char report[256];
+    int len = 0;
+    for (int i = 0; i < n_wanted; i++) {
+        len += snprintf(report + len, sizeof(report) - len, "%s%s %.1f ms",
+                        i ? ", " : "", ready_name(wanted[i]), elapsed[wanted[i]] * 1e3);
+    }
+    printf("[Main] Components ready: %s\n", report);
+    log_message(SYSTEM_LOG_FILE, "Main", "Components ready: %s", report);
+
+    // Watchdog (Only Standalone)
+    if (headless) {
+        printf("[Main] Headless: Map, Input and Watchdog windows not started (attach one with ./map --attach).\n");
+    } else if (mode == MODE_STANDALONE) {
         printf("[Main] Launching Watchdog...\n");
-        spawn_terminal("./watchdog");
+        spawn_terminal("./watchdog", NULL);
     } else {
-        printf("[Main] Multiplayer Mode: Generators and Watchdog DISABLED.\n");
+        printf("[Main] Multiplayer Mode: Watchdog DISABLED%s.\n", owns_world ? "" : ", world comes from the server");
     }
 
     // 4. UI WINDOWS
-    printf("[Main] Launching Map Window...\n");
-    spawn_terminal("./map"); 
-    
-    printf("[Main] Launching Input Window...\n");
-    spawn_terminal("./input");
+    // Viewers of the Blackboard's socket: closing one leaves the
+    // simulation running, and it can be attached again later.
+    char viewer_socket[PARAM_VAL_LEN];
+    param_get_str("VIEWER_SOCKET", VIEWER_SOCKET, viewer_socket, sizeof(viewer_socket));
+    if (!headless) {
+        printf("[Main] Launching Map Window...\n");
+        spawn_terminal("./map", viewer_socket); 
+        
+        // The Autopilot replaces the Input Window (same command channel)
+        if (!autopilot) {
+            printf("[Main] Launching Input Window...\n");
+            spawn_terminal("./input", viewer_socket);
+        }
+    }
+    // Autopilot: no terminal, its reports go to our stdout and system.log
+    if (autopilot) {
+        printf("[Main] Launching Autopilot...\n");
+        pid_t pid = fork();
+        if (pid == 0) {
+            signal(SIGINT, SIG_DFL);
+            execl("./autopilot", "autopilot", NULL);
+            perror("[Main] Error: Could not start ./autopilot");
+            exit(1);
+        }
+        if (pid > 0) children[n_children++] = pid;
+    }
+
+    // STEP 4: TIME TO FIRST FRAME
+    // In multiplayer the first frame also waits for the other player.
+    ReadySlot first = READY_FIRST_FRAME;
+    if (ready_wait(&first, 1, (mode == MODE_STANDALONE) ? ready_timeout : -1, t_start, elapsed) < 0) {
+        printf("[Main] No first frame (see system.log).\n");
+        log_message(SYSTEM_LOG_FILE, "Main", "Startup failed: no first frame");
+        abort_startup();
+    }
+    printf("[Main] First frame after %.1f ms\n", elapsed[READY_FIRST_FRAME] * 1e3);
+    log_message(SYSTEM_LOG_FILE, "Main", "Time to first frame: %.1f ms", elapsed[READY_FIRST_FRAME] * 1e3);
 
     printf("[Main] System Running. Press Ctrl+C to stop.\n");
 
+    // Threads mode: the system ends with the Blackboard (ESC / connection lost)
+    if (use_threads) {
+        pthread_join(bb_thread, NULL);
+        handle_sigint(SIGINT);
+    }
+
     while (1) {
         sleep(10);
     }
     return 0;
-}
\ No newline at end of file
+}
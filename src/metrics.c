@@ -0,0 +1,288 @@
+#define _GNU_SOURCE
+#include "common.h"
+#include "metrics.h"
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <pthread.h>
+
+#define METRICS_BUF (256 * 1024)   // One exposition (about 150 B per value)
+
+static MetricsMap *mapping = NULL;
+static pthread_once_t mapping_once = PTHREAD_ONCE_INIT;
+static _Thread_local MetricsBlock *own = NULL;
+static _Thread_local Metric dummy;
+
+// Scrape server
+static int srv_fd[2] = { -1, -1 };     // TCP, Unix
+static char srv_path[108];
+static pthread_t srv_thread;
+static _Atomic int srv_running = 0;
+
+static MetricsMap *mapping_open(int create) {
+    int fd = open(METRICS_FILE, O_RDWR | (create ? O_CREAT | O_TRUNC : 0), 0666);
+    if (fd < 0) return NULL;
+    if (create && ftruncate(fd, sizeof(MetricsMap)) < 0) { close(fd); return NULL; }
+    void *p = mmap(NULL, sizeof(MetricsMap), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+    MetricsMap *m = p;
+    if (create) {
+        atomic_store(&m->magic, METRICS_MAGIC);
+    } else if (atomic_load(&m->magic) != METRICS_MAGIC) {
+        munmap(p, sizeof(MetricsMap));
+        return NULL;
+    }
+    return m;
+}
+
+static void mapping_init(void) {
+    mapping = mapping_open(0);
+}
+
+int metrics_create(void) {
+    unlink(METRICS_FILE);
+    MetricsMap *m = mapping_open(1);
+    if (!m) return -1;
+    munmap(m, sizeof(MetricsMap));
+    return 0;
+}
+
+void metrics_unlink(void) {
+    unlink(METRICS_FILE);
+}
+
+void metrics_attach(const char *component) {
+    pthread_once(&mapping_once, mapping_init);
+    own = NULL;
+    if (!mapping) return;
+    // 1. Our block from before a restart
+    for (int i = 0; i < METRICS_BLOCKS && !own; i++) {
+        MetricsBlock *b = &mapping->blocks[i];
+        if (atomic_load_explicit(&b->state, memory_order_acquire) == 2 && strcmp(b->component, component) == 0) own = b;
+    }
+    // 2. A free one
+    for (int i = 0; i < METRICS_BLOCKS && !own; i++) {
+        MetricsBlock *b = &mapping->blocks[i];
+        uint32_t expected = 0;
+        if (!atomic_compare_exchange_strong(&b->state, &expected, 1)) continue;
+        snprintf(b->component, sizeof(b->component), "%s", component);
+        atomic_store(&b->count, 0);
+        atomic_store_explicit(&b->state, 2, memory_order_release);
+        own = b;
+    }
+    if (!own) return;
+    atomic_store(&own->pid, getpid());
+    metrics_heartbeat(get_time_sec());
+}
+
+static Metric *metric_register(const char *name, const char *labels, const char *help, int kind) {
+    if (!own) return &dummy;
+    uint32_t n = atomic_load_explicit(&own->count, memory_order_relaxed);
+    for (uint32_t i = 0; i < n; i++) {
+        Metric *m = &own->values[i];
+        if (strcmp(m->name, name) == 0 && strcmp(m->labels, labels ? labels : "") == 0) return m;
+    }
+    if (n == METRICS_VALUES) return &dummy;
+    Metric *m = &own->values[n];
+    snprintf(m->name, sizeof(m->name), "%s", name);
+    snprintf(m->labels, sizeof(m->labels), "%s", labels ? labels : "");
+    snprintf(m->help, sizeof(m->help), "%s", help);
+    m->kind = kind;
+    metric_set(m, 0.0);
+    // Readers only look at [0, count): the fields above are complete
+    atomic_store_explicit(&own->count, n + 1, memory_order_release);
+    return m;
+}
+
+Metric *metric_counter(const char *name, const char *labels, const char *help) {
+    return metric_register(name, labels, help, METRIC_COUNTER);
+}
+
+Metric *metric_gauge(const char *name, const char *labels, const char *help) {
+    return metric_register(name, labels, help, METRIC_GAUGE);
+}
+
+void metrics_heartbeat(double now) {
+    if (!own) return;
+    uint64_t bits;
+    memcpy(&bits, &now, sizeof(bits));
+    atomic_store_explicit(&own->heartbeat, bits, memory_order_relaxed);
+}
+
+// 1 if a value before (block b, index i) already has this name
+static int family_seen(int b, uint32_t i, const char *name) {
+    for (int c = 0; c <= b; c++) {
+        MetricsBlock *blk = &mapping->blocks[c];
+        if (atomic_load_explicit(&blk->state, memory_order_acquire) != 2) continue;
+        uint32_t n = (c == b) ? i : atomic_load_explicit(&blk->count, memory_order_acquire);
+        for (uint32_t k = 0; k < n; k++) {
+            if (strcmp(blk->values[k].name, name) == 0) return 1;
+        }
+    }
+    return 0;
+}
+
+size_t metrics_format(char *buf, size_t cap) {
+    size_t len = 0;
+#define OUT(...) do { if (len < cap) len += snprintf(buf + len, cap - len, __VA_ARGS__); } while (0)
+    if (cap == 0) return 0;
+    buf[0] = '\0';
+    if (!mapping) pthread_once(&mapping_once, mapping_init);
+    if (!mapping) return 0;
+    double now = get_time_sec();
+
+    // 1. Liveness of every component
+    OUT("# HELP drone_component_up Component process alive\n# TYPE drone_component_up gauge\n");
+    for (int b = 0; b < METRICS_BLOCKS; b++) {
+        MetricsBlock *blk = &mapping->blocks[b];
+        if (atomic_load_explicit(&blk->state, memory_order_acquire) != 2) continue;
+        int pid = atomic_load(&blk->pid);
+        OUT("drone_component_up{component=\"%s\",pid=\"%d\"} %d\n", blk->component, pid, kill(pid, 0) == 0);
+    }
+    OUT("# HELP drone_component_heartbeat_age_seconds Time since the component's loop last ran\n"
+        "# TYPE drone_component_heartbeat_age_seconds gauge\n");
+    for (int b = 0; b < METRICS_BLOCKS; b++) {
+        MetricsBlock *blk = &mapping->blocks[b];
+        if (atomic_load_explicit(&blk->state, memory_order_acquire) != 2) continue;
+        uint64_t bits = atomic_load_explicit(&blk->heartbeat, memory_order_relaxed);
+        double beat;
+        memcpy(&beat, &bits, sizeof(beat));
+        OUT("drone_component_heartbeat_age_seconds{component=\"%s\"} %.3f\n", blk->component, now - beat);
+    }
+
+    // 2. The values, grouped by name across all blocks (HELP / TYPE once
+    // per family: several components register the same families and tell
+    // them apart by their labels)
+    for (int b = 0; b < METRICS_BLOCKS; b++) {
+        MetricsBlock *blk = &mapping->blocks[b];
+        if (atomic_load_explicit(&blk->state, memory_order_acquire) != 2) continue;
+        uint32_t n = atomic_load_explicit(&blk->count, memory_order_acquire);
+        for (uint32_t i = 0; i < n; i++) {
+            Metric *m = &blk->values[i];
+            if (family_seen(b, i, m->name)) continue;
+            OUT("# HELP %s %s\n# TYPE %s %s\n", m->name, m->help, m->name,
+                m->kind == METRIC_COUNTER ? "counter" : "gauge");
+            for (int c = b; c < METRICS_BLOCKS; c++) {
+                MetricsBlock *other = &mapping->blocks[c];
+                if (atomic_load_explicit(&other->state, memory_order_acquire) != 2) continue;
+                uint32_t on = atomic_load_explicit(&other->count, memory_order_acquire);
+                for (uint32_t j = (c == b) ? i : 0; j < on; j++) {
+                    Metric *v = &other->values[j];
+                    if (strcmp(v->name, m->name) != 0) continue;
+                    if (v->labels[0]) OUT("%s{%s} %.15g\n", v->name, v->labels, metric_get(v));
+                    else OUT("%s %.15g\n", v->name, metric_get(v));
+                }
+            }
+        }
+    }
+#undef OUT
+    return (len < cap) ? len : cap - 1;
+}
+
+static void send_all(int fd, const char *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        p += n;
+        len -= n;
+    }
+}
+
+// One scrape: a small GET, answered and closed (HTTP/1.0)
+static void serve_one(int fd, char *body) {
+    struct timeval tv = { 0, 200000 };     // A silent client does not hold the thread
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char req[1024];
+    ssize_t n = recv(fd, req, sizeof(req) - 1, 0);
+    if (n <= 0) return;
+    req[n] = '\0';
+    const char *status = "200 OK";
+    size_t len;
+    if (strncmp(req, "GET /metrics", 12) == 0 || strncmp(req, "GET / ", 6) == 0) {
+        len = metrics_format(body, METRICS_BUF);
+    } else {
+        status = "404 Not Found";
+        len = snprintf(body, METRICS_BUF, "Metrics are at /metrics\n");
+    }
+    char hdr[192];
+    int h = snprintf(hdr, sizeof(hdr), "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", status, len);
+    send_all(fd, hdr, h);
+    send_all(fd, body, len);
+}
+
+static void *serve_loop(void *arg) {
+    char *body = malloc(METRICS_BUF);
+    if (!body) return NULL;
+    while (atomic_load(&srv_running)) {
+        struct pollfd pfd[2];
+        int n = 0;
+        for (int i = 0; i < 2; i++) {
+            if (srv_fd[i] >= 0) { pfd[n].fd = srv_fd[i]; pfd[n].events = POLLIN; pfd[n].revents = 0; n++; }
+        }
+        if (poll(pfd, n, 200) <= 0) continue;   // Wakes up to notice metrics_stop
+        for (int i = 0; i < n; i++) {
+            if (!(pfd[i].revents & POLLIN)) continue;
+            int fd = accept(pfd[i].fd, NULL, NULL);
+            if (fd < 0) continue;
+            serve_one(fd, body);
+            close(fd);
+        }
+    }
+    free(body);
+    return NULL;
+}
+
+int metrics_serve(int port, const char *socket_path) {
+    if (port > 0) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = { 0 };
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);     // Never exposed beyond the host
+        int opt = 1;
+        if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        if (fd >= 0 && bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && listen(fd, 8) == 0) {
+            srv_fd[0] = fd;
+        } else if (fd >= 0) {
+            close(fd);
+        }
+    }
+    // A path longer than sun_path is not cut: no socket endpoint then
+    if (socket_path && socket_path[0] && strlen(socket_path) < sizeof(((struct sockaddr_un *)0)->sun_path)) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un addr = { 0 };
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+        unlink(socket_path);
+        if (fd >= 0 && bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && listen(fd, 8) == 0) {
+            srv_fd[1] = fd;
+            snprintf(srv_path, sizeof(srv_path), "%s", socket_path);
+        } else if (fd >= 0) {
+            close(fd);
+        }
+    }
+    if (srv_fd[0] < 0 && srv_fd[1] < 0) return -1;
+    atomic_store(&srv_running, 1);
+    if (pthread_create(&srv_thread, NULL, serve_loop, NULL) != 0) {
+        atomic_store(&srv_running, 0);
+        metrics_stop();
+        return -1;
+    }
+    pthread_setname_np(srv_thread, "metrics");
+    return 0;
+}
+
+void metrics_stop(void) {
+    if (atomic_exchange(&srv_running, 0)) pthread_join(srv_thread, NULL);
+    for (int i = 0; i < 2; i++) {
+        if (srv_fd[i] >= 0) close(srv_fd[i]);
+        srv_fd[i] = -1;
+    }
+    if (srv_path[0]) unlink(srv_path);
+    srv_path[0] = '\0';
+}
@@ -0,0 +1,93 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+// METRICS (Prometheus text format)
+// Every component keeps its counters and gauges in its own block of one
+// shared mapping (METRICS_FILE, created by Main next to the FIFOs). A
+// value has a single writer: an update is a relaxed load + store, no
+// lock, no syscall, so the hot loops pay nothing for being observed.
+// The Blackboard serves all the blocks over HTTP (loopback METRICS_PORT
+// and the Unix socket METRICS_SOCKET) from a thread of its own: a scrape
+// only reads the mapping. Each value is read whole (never torn); the
+// values of a block are not one atomic snapshot, which Prometheus never
+// needs.
+//   curl http://127.0.0.1:9464/metrics
+//   curl --unix-socket /tmp/drone_metrics.sock http://localhost/metrics
+
+#define METRICS_FILE    "/tmp/drone_metrics"
+#define METRICS_SOCKET  "/tmp/drone_metrics.sock"
+#define METRICS_PORT    9464        // Loopback HTTP (METRICS_PORT 0 in params.txt: off)
+#define METRICS_BLOCKS  12          // Components
+#define METRICS_VALUES  96          // Values per component
+#define METRICS_MAGIC   0x4D455452  // "METR"
+
+enum { METRIC_COUNTER, METRIC_GAUGE };
+
+typedef struct {
+    char name[48];              // "drone_dynamics_steps_total"
+    char labels[48];            // 'subscriber="Map"' ("" = none)
+    char help[64];
+    int kind;
+    _Atomic uint64_t value;     // Bits of a double (counters too: exact up to 2^53)
+} Metric;
+
+typedef struct {
+    _Atomic uint32_t state;     // 0 free, 1 being claimed, 2 in use
+    char component[32];
+    _Atomic int32_t pid;
+    _Atomic uint32_t count;     // Values registered (published in order)
+    _Atomic uint64_t heartbeat; // Bits of get_time_sec() at the last metrics_heartbeat
+    Metric values[METRICS_VALUES];
+} MetricsBlock;
+
+typedef struct {
+    _Atomic uint32_t magic;
+    MetricsBlock blocks[METRICS_BLOCKS];
+} MetricsMap;
+
+// Main: creates the mapping before the components start / removes it
+int metrics_create(void);
+void metrics_unlink(void);
+
+// A component (per thread in the threads mode): takes its block, or
+// the one it had before a restart. Without the mapping the metrics
+// still work, they are just not exported.
+void metrics_attach(const char *component);
+
+// Registers a value of our block (the same name with other labels is
+// another value; registering it again returns the same one). Never NULL:
+// past METRICS_VALUES, or unattached, the value is a private dummy.
+Metric *metric_counter(const char *name, const char *labels, const char *help);
+Metric *metric_gauge(const char *name, const char *labels, const char *help);
+
+// Updates (the registering component only)
+static inline double metric_get(Metric *m) {
+    uint64_t bits = atomic_load_explicit(&m->value, memory_order_relaxed);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+static inline void metric_set(Metric *m, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    atomic_store_explicit(&m->value, bits, memory_order_relaxed);
+}
+static inline void metric_add(Metric *m, double n) { metric_set(m, metric_get(m) + n); }
+
+// Liveness: called from the component's loop with its clock
+void metrics_heartbeat(double now);
+
+// Text format of every block, with drone_component_up and the heartbeat
+// age of each component. Returns the length (truncated to cap - 1).
+size_t metrics_format(char *buf, size_t cap);
+
+// Blackboard: serves /metrics from a thread (port 0 or NULL path: that
+// listener is off). -1 if neither could be opened.
+int metrics_serve(int port, const char *socket_path);
+void metrics_stop(void);
+
+#endif
@@ -0,0 +1,112 @@
+#include <math.h>
+#include "motion.h"
+
+static const char *names[] = { "static", "linear", "circular", "waypoint" };
+
+int motion_from_name(const char *name) {
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+const char *motion_name(int type) {
+    return (type >= 0 && type < 4) ? names[type] : "?";
+}
+
+// Small deterministic generator: the same seed gives the same path in
+// every process (rand() is per process and seeded differently)
+static float seed_uniform(unsigned int *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (*state >> 8) / 16777216.0f;   // [0, 1)
+}
+
+// Folds x into [lo, hi] as a ball bouncing between two walls
+static float bounce(float x, float lo, float hi) {
+    float len = hi - lo;
+    float u = fmodf(x - lo, 2.0f * len);
+    if (u < 0) u += 2.0f * len;
+    return lo + ((u <= len) ? u : 2.0f * len - u);
+}
+
+static Vec2 clamp_to_map(Vec2 p) {
+    if (p.x < MOTION_MARGIN) p.x = MOTION_MARGIN;
+    if (p.y < MOTION_MARGIN) p.y = MOTION_MARGIN;
+    if (p.x > MAP_WIDTH - MOTION_MARGIN) p.x = MAP_WIDTH - MOTION_MARGIN;
+    if (p.y > MAP_HEIGHT - MOTION_MARGIN) p.y = MAP_HEIGHT - MOTION_MARGIN;
+    return p;
+}
+
+Vec2 motion_position(const Obstacle *obs, double t) {
+    const Motion *m = &obs->motion;
+    if (m->type == MOTION_STATIC || m->speed <= 0.0f) return obs->position;
+
+    unsigned int state = m->seed;
+    float dt = (float)(t - m->t0);
+    float dist = m->speed * dt;        // Distance travelled along the path
+    Vec2 p = obs->position;
+
+    switch (m->type) {
+        case MOTION_LINEAR: {
+            float angle = seed_uniform(&state) * 2.0f * (float)M_PI;
+            p.x = bounce(p.x + dist * cosf(angle), MOTION_MARGIN, MAP_WIDTH - MOTION_MARGIN);
+            p.y = bounce(p.y + dist * sinf(angle), MOTION_MARGIN, MAP_HEIGHT - MOTION_MARGIN);
+            return p;
+        }
+        case MOTION_CIRCULAR: {
+            float r = (m->radius > 0.1f) ? m->radius : 0.1f;
+            float phase = seed_uniform(&state) * 2.0f * (float)M_PI;
+            float dir = (seed_uniform(&state) < 0.5f) ? 1.0f : -1.0f;
+            float a = phase + dir * dist / r;
+            // The circle passes through the anchor at t0 (no jump on a new model)
+            p.x += r * (cosf(a) - cosf(phase));
+            p.y += r * (sinf(a) - sinf(phase));
+            return clamp_to_map(p);
+        }
+        case MOTION_WAYPOINT: {
+            // The loop starts at the anchor
+            Vec2 wp[MOTION_WAYPOINTS];
+            wp[0] = clamp_to_map(obs->position);
+            for (int i = 1; i < MOTION_WAYPOINTS; i++) {
+                wp[i].x = obs->position.x + (seed_uniform(&state) * 2.0f - 1.0f) * m->radius;
+                wp[i].y = obs->position.y + (seed_uniform(&state) * 2.0f - 1.0f) * m->radius;
+                wp[i] = clamp_to_map(wp[i]);
+            }
+            float seg[MOTION_WAYPOINTS], loop = 0.0f;
+            for (int i = 0; i < MOTION_WAYPOINTS; i++) {
+                Vec2 a = wp[i], b = wp[(i + 1) % MOTION_WAYPOINTS];
+                seg[i] = hypotf(b.x - a.x, b.y - a.y);
+                loop += seg[i];
+            }
+            if (loop < 1e-3f) return wp[0];
+
+            float s = fmodf(dist, loop);
+            for (int i = 0; i < MOTION_WAYPOINTS; i++) {
+                if (s <= seg[i] || i == MOTION_WAYPOINTS - 1) {
+                    Vec2 a = wp[i], b = wp[(i + 1) % MOTION_WAYPOINTS];
+                    float k = (seg[i] > 1e-6f) ? s / seg[i] : 0.0f;
+                    if (k > 1.0f) k = 1.0f;
+                    p.x = a.x + k * (b.x - a.x);
+                    p.y = a.y + k * (b.y - a.y);
+                    return p;
+                }
+                s -= seg[i];
+            }
+            return wp[0];
+        }
+    }
+    return obs->position;
+}
+
+float motion_sweep(Vec2 p0, Vec2 p1, float r) {
+    float dx = p1.x - p0.x, dy = p1.y - p0.y;
+    float c = p0.x*p0.x + p0.y*p0.y - r*r;
+    if (c <= 0.0f) return 0.0f;
+    float a = dx*dx + dy*dy;
+    if (a < 1e-12f) return -1.0f;
+    float b = 2.0f * (p0.x*dx + p0.y*dy);
+    float disc = b*b - 4.0f*a*c;
+    if (disc < 0.0f) return -1.0f;
+    float t = (-b - sqrtf(disc)) / (2.0f * a);
+    return (t >= 0.0f && t <= 1.0f) ? t : -1.0f;
+}
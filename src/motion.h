@@ -0,0 +1,35 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#include "common.h"
+
+// MOVING OBSTACLES
+// Positions are a pure function of (model, time): the Generator only
+// sends the model, and Dynamics and the Map compute where the obstacle
+// is at any moment. Same model + same clock = same position everywhere.
+//
+//   LINEAR   : straight line from the anchor, direction from the seed,
+//              bouncing off the map borders
+//   CIRCULAR : circle of 'radius' through the anchor, phase and
+//              direction from the seed
+//   WAYPOINT : closed loop from the anchor through MOTION_WAYPOINTS - 1
+//              points drawn from the seed within 'radius' of it
+// All models start at the anchor at t0.
+
+#define MOTION_WAYPOINTS 4
+#define MOTION_MARGIN    2.0f   // Moving obstacles stay this far from the borders
+
+// Position of 'obs' at time 't' (get_time_sec() clock)
+Vec2 motion_position(const Obstacle *obs, double t);
+
+// "static" / "linear" / "circular" / "waypoint" (-1 if unknown)
+int motion_from_name(const char *name);
+const char *motion_name(int type);
+
+// SWEPT TEST (collisions that cannot be skipped by a large step)
+// First fraction t in [0, 1] of the segment p0 -> p1 within 'r' of the
+// origin (0 if p0 already is), -1 if none. Positions are relative to
+// the circle center.
+float motion_sweep(Vec2 p0, Vec2 p1, float r);
+
+#endif
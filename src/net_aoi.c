@@ -0,0 +1,59 @@
+#include "net_aoi.h"
+
+static int cell_of(const AoiGrid *g, Vec2 p, int *cx, int *cy) {
+    *cx = (int)(p.x / g->cell);
+    *cy = (int)(p.y / g->cell);
+    if (*cx < 0) *cx = 0;
+    if (*cy < 0) *cy = 0;
+    if (*cx >= g->cols) *cx = g->cols - 1;
+    if (*cy >= g->rows) *cy = g->rows - 1;
+    return *cy * g->cols + *cx;
+}
+
+void aoi_build(AoiGrid *g, const Player *players, float radius) {
+    // 1. Cells of one radius: the neighbours are always in the 3x3 block
+    float min_cell = (float)(MAP_WIDTH > MAP_HEIGHT ? MAP_WIDTH : MAP_HEIGHT) / AOI_MAX_CELLS;
+    g->cell = (radius > min_cell) ? radius : min_cell;
+    g->cols = (int)(MAP_WIDTH / g->cell) + 1;
+    g->rows = (int)(MAP_HEIGHT / g->cell) + 1;
+    if (g->cols > AOI_MAX_CELLS) g->cols = AOI_MAX_CELLS;
+    if (g->rows > AOI_MAX_CELLS) g->rows = AOI_MAX_CELLS;
+    int cells = g->cols * g->rows;
+
+    // 2. Counting sort of the slots by cell
+    int cell[MAX_PLAYERS];
+    memset(g->start, 0, sizeof(int) * (cells + 1));
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        cell[i] = -1;
+        if (players[i].id == -1) continue;
+        int cx, cy;
+        g->pos[i] = players[i].drone.position;
+        cell[i] = cell_of(g, g->pos[i], &cx, &cy);
+        g->start[cell[i] + 1]++;
+    }
+    for (int c = 0; c < cells; c++) g->start[c + 1] += g->start[c];
+    int fill[AOI_MAX_CELLS * AOI_MAX_CELLS];
+    memcpy(fill, g->start, sizeof(int) * cells);
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (cell[i] >= 0) g->slots[fill[cell[i]]++] = i;
+    }
+}
+
+unsigned int aoi_query(const AoiGrid *g, Vec2 center, float radius) {
+    unsigned int mask = 0;
+    int cx, cy;
+    cell_of(g, center, &cx, &cy);
+    for (int y = cy - 1; y <= cy + 1; y++) {
+        if (y < 0 || y >= g->rows) continue;
+        for (int x = cx - 1; x <= cx + 1; x++) {
+            if (x < 0 || x >= g->cols) continue;
+            int c = y * g->cols + x;
+            for (int k = g->start[c]; k < g->start[c + 1]; k++) {
+                int i = g->slots[k];
+                float dx = g->pos[i].x - center.x, dy = g->pos[i].y - center.y;
+                if (dx * dx + dy * dy <= radius * radius) mask |= 1u << i;
+            }
+        }
+    }
+    return mask;
+}
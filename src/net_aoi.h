@@ -0,0 +1,32 @@
+#ifndef NET_AOI_H
+#define NET_AOI_H
+
+#include "common.h"
+
+// AREA OF INTEREST (world sync server with several clients)
+// A client only needs the drones around its own at the full snapshot
+// rate: the others are sent at NET_AOI_FAR_RATE (or not at all). The
+// drones are binned in a uniform grid of 'radius' sized cells, rebuilt
+// once per snapshot round (counting sort, O(players + cells)); a query
+// only looks at the 3x3 cells around the center, so a round costs
+// O(players x neighbours), not O(players^2).
+
+#define NET_AOI_RADIUS   30.0f  // m: drones closer than this are "near"
+#define NET_AOI_FAR_RATE 2.0f   // Updates per second of the other drones (0 = hidden)
+#define AOI_MAX_CELLS    32     // Per axis (the cell grows on a small radius)
+
+typedef struct {
+    float cell;                 // Cell size (m)
+    int cols, rows;
+    int start[AOI_MAX_CELLS * AOI_MAX_CELLS + 1];   // Cell c: slots[start[c] .. start[c+1])
+    int slots[MAX_PLAYERS];
+    Vec2 pos[MAX_PLAYERS];      // Position of each slot when indexed
+} AoiGrid;
+
+// Indexes the present players (id != -1)
+void aoi_build(AoiGrid *g, const Player *players, float radius);
+
+// Slots (bit = slot) within 'radius' of 'center' (the radius of aoi_build)
+unsigned int aoi_query(const AoiGrid *g, Vec2 center, float radius);
+
+#endif
@@ -0,0 +1,219 @@
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <math.h>
+#include "net_frame.h"
+
+void net_quality_sample(NetQuality *q, double sent, double now) {
+    double r = now - sent;
+    if (r < 0) return;
+    q->last = r;
+    if (q->srtt == 0.0) {
+        q->srtt = r;
+        q->rttvar = r / 2;
+    } else {
+        q->rttvar += (fabs(r - q->srtt) - q->rttvar) / 4;
+        q->srtt += (r - q->srtt) / 8;
+    }
+    if (q->rtt_min == 0.0 || r < q->rtt_min) q->rtt_min = r;
+    if (r > q->rtt_max) q->rtt_max = r;
+}
+
+void net_quality_read(NetQuality *q, int fd, LinkStats *out) {
+    double now = get_time_sec();
+    double span = (q->read_at > 0) ? now - q->read_at : 0.0;
+    memset(out, 0, sizeof(LinkStats));
+    out->peer = -1;
+    out->rtt_ms = (float)(q->srtt * 1e3);
+    out->jitter_ms = (float)(q->rttvar * 1e3);
+    out->rtt_min_ms = (float)(q->rtt_min * 1e3);
+    out->rtt_max_ms = (float)(q->rtt_max * 1e3);
+    if (span > 0) {
+        out->bytes_in = (q->bytes_in - q->read_bytes_in) / span;
+        out->bytes_out = (q->bytes_out - q->read_bytes_out) / span;
+        out->msgs_in = (q->msgs_in - q->read_msgs_in) / span;
+        out->msgs_out = (q->msgs_out - q->read_msgs_out) / span;
+    }
+    out->lost = (unsigned int)q->lost;
+    int queued = 0;
+    if (ioctl(fd, TIOCOUTQ, &queued) == 0) out->send_queue = queued;
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0) out->retrans = info.tcpi_total_retrans;
+
+    q->read_at = now;
+    q->read_bytes_in = q->bytes_in;   q->read_bytes_out = q->bytes_out;
+    q->read_msgs_in = q->msgs_in;     q->read_msgs_out = q->msgs_out;
+    q->rtt_min = q->rtt_max = 0.0;
+}
+
+void net_link_init(NetLink *link, int fd) {
+    memset(link, 0, sizeof(NetLink));
+    link->fd = fd;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+int net_link_flush(NetLink *link) {
+    while (link->out_len > 0) {
+        ssize_t n = send(link->fd, link->out, link->out_len, MSG_NOSIGNAL);
+        if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+        memmove(link->out, link->out + n, link->out_len - n);
+        link->out_len -= n;
+        link->bytes_out += n;
+        link->quality.bytes_out += n;
+    }
+    return 0;
+}
+
+int net_link_queue(NetLink *link, int kind, const unsigned char *payload, size_t len) {
+    if (link->out_len + NET_HEADER + len > sizeof(link->out)) return 0; // Link saturated
+    unsigned char *p = link->out + link->out_len;
+    p = put8(p, (uint8_t)kind);
+    p = put16(p, (uint16_t)len);
+    if (len) memcpy(p, payload, len);
+    link->out_len += NET_HEADER + len;
+    link->quality.msgs_out++;
+    return net_link_flush(link);
+}
+
+// A ping when one is due; the last one unanswered for too long is lost
+static void link_ping(NetLink *link) {
+    NetQuality *q = &link->quality;
+    double now = get_time_sec();
+    if (q->ping_sent > 0 && now - q->ping_sent > NET_PING_TIMEOUT) {
+        q->lost++;
+        q->ping_sent = 0;
+    }
+    if (now < q->next_ping || q->ping_sent > 0) return;
+    unsigned char buf[8], *p = buf;
+    q->ping_id++;
+    p = put32(p, q->ping_id);
+    p = put32(p, (uint32_t)(uint64_t)(now * 1000.0));
+    q->ping_sent = now;
+    q->next_ping = now + NET_PING_INTERVAL;
+    net_link_queue(link, NET_PING, buf, sizeof(buf));
+}
+
+int net_link_fill(NetLink *link) {
+    link_ping(link);
+    while (link->in_len < sizeof(link->in)) {
+        ssize_t n = recv(link->fd, link->in + link->in_len, sizeof(link->in) - link->in_len, 0);
+        if (n == 0) return -1;
+        if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+        link->in_len += n;
+        link->bytes_in += n;
+        link->quality.bytes_in += n;
+    }
+    return 0;
+}
+
+int net_link_next(NetLink *link, size_t *pos, const unsigned char **payload, size_t *len) {
+    for (;;) {
+        if (link->in_len - *pos < NET_HEADER) return 0;
+        const unsigned char *p = link->in + *pos;
+        int kind = get8(&p);
+        size_t n = get16(&p);
+        if (link->in_len - *pos < NET_HEADER + n) return 0;
+        *pos += NET_HEADER + n;
+        link->quality.msgs_in++;
+        if (kind == NET_PING && n == 8) {
+            net_link_queue(link, NET_PONG, p, n);       // Echo it as it came
+            continue;
+        }
+        if (kind == NET_PONG && n == 8) {
+            NetQuality *q = &link->quality;
+            uint32_t id = get32(&p);
+            if (q->ping_sent > 0 && id == q->ping_id) {
+                net_quality_sample(q, q->ping_sent, get_time_sec());
+                q->ping_sent = 0;
+            }
+            continue;
+        }
+        *payload = p;
+        *len = n;
+        return kind;
+    }
+}
+
+void net_link_consume(NetLink *link, size_t pos) {
+    memmove(link->in, link->in + pos, link->in_len - pos);
+    link->in_len -= pos;
+}
+
+NetShared *net_shared_frame(int kind, const unsigned char *payload, size_t len) {
+    NetShared *frame = malloc(sizeof(NetShared) + NET_HEADER + len);
+    if (!frame) return NULL;
+    frame->refs = 1;
+    frame->len = NET_HEADER + len;
+    unsigned char *p = put8(frame->data, (uint8_t)kind);
+    p = put16(p, (uint16_t)len);
+    if (len) memcpy(p, payload, len);
+    return frame;
+}
+
+void net_shared_release(NetShared *frame) {
+    if (frame && --frame->refs == 0) free(frame);
+}
+
+void net_fanout_init(NetFanout *f, int fd) {
+    memset(f, 0, sizeof(NetFanout));
+    f->fd = fd;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+int net_fanout_push(NetFanout *f, NetShared *frame) {
+    if (f->count == NET_FANOUT_QUEUE) return -1;
+    frame->refs++;
+    f->queue[(f->head + f->count) % NET_FANOUT_QUEUE] = frame;
+    f->count++;
+    return 0;
+}
+
+int net_fanout_flush(NetFanout *f) {
+    while (f->count > 0) {
+        // 1. The whole queue in one system call (writev, as sendmsg for
+        //    MSG_NOSIGNAL; the first frame may be partly sent)
+        struct iovec iov[NET_FANOUT_QUEUE];
+        size_t total = 0;
+        for (int k = 0; k < f->count; k++) {
+            NetShared *frame = f->queue[(f->head + k) % NET_FANOUT_QUEUE];
+            size_t skip = k ? 0 : f->offset;
+            iov[k].iov_base = frame->data + skip;
+            iov[k].iov_len = frame->len - skip;
+            total += iov[k].iov_len;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = f->count;
+        ssize_t n = sendmsg(f->fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+        f->bytes_out += n;
+
+        // 2. Release the frames fully written
+        size_t left = (size_t)n;
+        while (f->count > 0) {
+            NetShared *frame = f->queue[f->head];
+            size_t rest = frame->len - f->offset;
+            if (left < rest) { f->offset += left; break; }
+            left -= rest;
+            f->offset = 0;
+            net_shared_release(frame);
+            f->head = (f->head + 1) % NET_FANOUT_QUEUE;
+            f->count--;
+        }
+        if ((size_t)n < total) break;   // Socket full
+    }
+    return 0;
+}
+
+void net_fanout_clear(NetFanout *f) {
+    while (f->count > 0) {
+        net_shared_release(f->queue[f->head]);
+        f->head = (f->head + 1) % NET_FANOUT_QUEUE;
+        f->count--;
+    }
+    f->offset = 0;
+}
@@ -0,0 +1,128 @@
+#ifndef NET_FRAME_H
+#define NET_FRAME_H
+
+#include <stdint.h>
+#include "common.h"
+
+// BINARY FRAMES over the game socket (after the text handshake)
+//   u8 kind | u16 payload length | payload      (big endian)
+// Non-blocking on both sides: what the socket does not accept stays
+// queued in 'out', partial frames wait in 'in'. Used by the world sync
+// (net_world.c) and the lockstep (net_lockstep.c) protocols.
+
+#define NET_HEADER   3         // u8 kind + u16 length
+#define NET_BUF_SIZE 8192
+
+// LINK QUALITY
+// Every connection pings its peer every NET_PING_INTERVAL; the frame
+// layer answers and consumes NET_PING / NET_PONG itself (the protocols
+// never see them, older peers skip them as unknown kinds):
+//   NET_PING / NET_PONG: u32 id | u32 sender's time (ms), echoed back
+// The round trip is smoothed as TCP does (RFC 6298): srtt += (r - srtt) / 8,
+// jitter (rttvar) += (|r - srtt| - rttvar) / 4. A ping still unanswered
+// after NET_PING_TIMEOUT counts as lost.
+#define NET_PING 0x7e
+#define NET_PONG 0x7f
+#define NET_PING_INTERVAL 0.5
+#define NET_PING_TIMEOUT  2.0
+
+typedef struct {
+    double srtt, rttvar;        // s (0 before the first sample)
+    double rtt_min, rtt_max;    // Since the last net_quality_read
+    double last;                // Latest sample (s)
+    uint32_t ping_id;
+    double ping_sent;           // 0 = none pending
+    double next_ping;
+    unsigned long lost;
+    unsigned long msgs_in, msgs_out, bytes_in, bytes_out;   // Totals
+    // Totals at the last net_quality_read (for the rates)
+    double read_at;
+    unsigned long read_msgs_in, read_msgs_out, read_bytes_in, read_bytes_out;
+} NetQuality;
+
+// A round trip measured at 'now' for a ping sent at 'sent'
+void net_quality_sample(NetQuality *q, double sent, double now);
+
+// Fills 'out' with the rates since the last call, the smoothed RTT,
+// the kernel send queue (TIOCOUTQ) and TCP retransmissions of 'fd'
+void net_quality_read(NetQuality *q, int fd, LinkStats *out);
+
+typedef struct {
+    int fd;
+    NetQuality quality;
+    unsigned char in[NET_BUF_SIZE];
+    size_t in_len;
+    unsigned char out[NET_BUF_SIZE];
+    size_t out_len;
+    unsigned long bytes_in, bytes_out;  // Counters (the owner resets them)
+} NetLink;
+
+// Takes over a connected socket (switches it to non-blocking)
+void net_link_init(NetLink *link, int fd);
+
+// Writes what the socket accepts now. -1 if the connection is gone.
+int net_link_flush(NetLink *link);
+
+// Queues a frame and flushes. 0 if queued (or dropped: link saturated),
+// -1 if the connection is gone.
+int net_link_queue(NetLink *link, int kind, const unsigned char *payload, size_t len);
+
+// Reads what arrived (and sends a ping when one is due). -1 if the peer closed.
+int net_link_fill(NetLink *link);
+
+// Next complete frame from *pos: its kind, payload in *payload / *len,
+// *pos moved past it. 0 if none yet. Pings and pongs are handled here.
+int net_link_next(NetLink *link, size_t *pos, const unsigned char **payload, size_t *len);
+
+// Drops the frames before 'pos' (the ones read with net_link_next)
+void net_link_consume(NetLink *link, size_t pos);
+
+// SHARED FRAMES (one encoding, many sockets)
+// A frame sent to several connections is built once in a reference
+// counted buffer; each connection queues a reference and writes its
+// queue with one writev(). The buffer is freed by the last writer.
+// (MSG_ZEROCOPY does not pay off for frames this small: pinning the
+// pages and reading the completions costs more than the copy.)
+#define NET_FANOUT_QUEUE 16    // Frames queued per connection
+
+typedef struct {
+    int refs;
+    size_t len;                 // Header + payload
+    unsigned char data[];
+} NetShared;
+
+typedef struct {
+    int fd;
+    NetShared *queue[NET_FANOUT_QUEUE];
+    int head, count;
+    size_t offset;              // Bytes of queue[head] already written
+    unsigned long bytes_out;    // Counter (the owner resets it)
+} NetFanout;
+
+// Encodes a frame once (refs = 1: the caller's). NULL if out of memory.
+NetShared *net_shared_frame(int kind, const unsigned char *payload, size_t len);
+void net_shared_release(NetShared *frame);
+
+// Takes over a connected socket (switches it to non-blocking)
+void net_fanout_init(NetFanout *f, int fd);
+
+// Queues a reference to 'frame'. 0 if queued, -1 if the queue is full
+// (the frame is not queued: the caller decides what the peer misses).
+int net_fanout_push(NetFanout *f, NetShared *frame);
+
+// Writes what the socket accepts now (one writev for the whole queue).
+// -1 if the connection is gone.
+int net_fanout_flush(NetFanout *f);
+
+// Drops the queued references
+void net_fanout_clear(NetFanout *f);
+
+// Big endian helpers
+static inline unsigned char *put8(unsigned char *p, uint8_t v)   { *p++ = v; return p; }
+static inline unsigned char *put16(unsigned char *p, uint16_t v) { *p++ = v >> 8; *p++ = v; return p; }
+static inline unsigned char *put32(unsigned char *p, uint32_t v) { p = put16(p, v >> 16); return put16(p, v); }
+static inline uint8_t  get8(const unsigned char **p)  { return *(*p)++; }
+static inline uint16_t get16(const unsigned char **p) { uint16_t v = ((*p)[0] << 8) | (*p)[1]; *p += 2; return v; }
+static inline uint32_t get32(const unsigned char **p) { uint32_t v = (uint32_t)get16(p) << 16; return v | get16(p); }
+
+#endif
@@ -0,0 +1,208 @@
+#include <math.h>
+#include <poll.h>
+#include "net_lockstep.h"
+#include "net_frame.h"
+#include "physics.h"
+#include "params.h"
+
+#define LS_HELLO 1
+#define LS_INPUT 2
+#define LS_CHECK 3
+#define LS_BYE   4
+
+#define LS_HELLO_TIMEOUT 5.0   // s the client waits for the settings
+#define LS_HELLO_LEN 13
+
+struct NetLockstep {
+    NetLink link;
+    // Checksums of the same tick from both sides (slot = tick % window)
+    unsigned int local_tick[LOCKSTEP_WINDOW], local_sum[LOCKSTEP_WINDOW];
+    unsigned int remote_tick[LOCKSTEP_WINDOW], remote_sum[LOCKSTEP_WINDOW];
+    unsigned long inputs_in, checks;
+    unsigned long desyncs;              // Since the start (the first one is logged)
+    double since;
+    unsigned int hash;                  // Our settings hash
+};
+
+static const char *SETTINGS_KEYS[] = {
+    "M", "K", "REPULSION_RHO", "REPULSION_ETA", "ATTRACTION_RHO", "ATTRACTION_ETA",
+    "OBSTACLE_COLLISION", "OBSTACLE_HIT_RADIUS", "OBSTACLE_MOTION", "OBSTACLE_SPEED", "OBSTACLE_RADIUS"
+};
+
+int lockstep_settings_key(const char *key) {
+    for (size_t i = 0; i < sizeof(SETTINGS_KEYS) / sizeof(SETTINGS_KEYS[0]); i++) {
+        if (strcmp(key, SETTINGS_KEYS[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+// FNV-1a over the values as the simulation uses them (defaults applied,
+// so "1" and "1.0" or a missing key and its default hash the same)
+unsigned int lockstep_settings_hash(void) {
+    PhysicsParams pp;
+    physics_load(&pp);
+    char motion[PARAM_VAL_LEN];
+    param_get_str("OBSTACLE_MOTION", "static", motion, sizeof(motion));
+    char text[256];
+    snprintf(text, sizeof(text), "%.6g %.6g %.6g %.6g %.6g %.6g %d %.6g %s %.6g %.6g",
+             pp.M, pp.K, pp.rep_rho, pp.rep_eta, pp.att_rho, pp.att_eta, pp.obstacle_collision, pp.hit_radius,
+             motion, param_get_float("OBSTACLE_SPEED", 2.0f),
+             param_get_float("OBSTACLE_RADIUS", 6.0f));
+    unsigned int h = 2166136261u;
+    for (const char *c = text; *c; c++) h = (h ^ (unsigned char)*c) * 16777619u;
+    return h;
+}
+
+static int send_hello(NetLockstep *ls, const LockstepConfig *cfg) {
+    unsigned char buf[LS_HELLO_LEN], *p = buf;
+    p = put32(p, cfg->seed);
+    p = put16(p, (uint16_t)cfg->rate);
+    p = put16(p, (uint16_t)cfg->substeps);
+    p = put8(p, (uint8_t)cfg->delay);
+    p = put32(p, ls->hash);
+    return net_link_queue(&ls->link, LS_HELLO, buf, p - buf);
+}
+
+// Compares once both checksums of 'tick' are known
+static void compare(NetLockstep *ls, unsigned int tick) {
+    int i = tick % LOCKSTEP_WINDOW;
+    if (ls->local_tick[i] != tick || ls->remote_tick[i] != tick) return;
+    ls->checks++;
+    if (ls->local_sum[i] != ls->remote_sum[i]) {
+        if (ls->desyncs++ == 0) {
+            log_message(SYSTEM_LOG_FILE, "Lockstep", "DESYNC at tick %u (checksum %08x, peer %08x)",
+                        tick, ls->local_sum[i], ls->remote_sum[i]);
+        }
+    }
+    ls->local_tick[i] = ls->remote_tick[i] = (unsigned int)-1;   // Compared once
+}
+
+NetLockstep *net_lockstep_open(int fd, int mode, LockstepConfig *cfg) {
+    NetLockstep *ls = calloc(1, sizeof(NetLockstep));
+    if (!ls) return NULL;
+    net_link_init(&ls->link, fd);
+    memset(ls->local_tick, 0xff, sizeof(ls->local_tick));
+    memset(ls->remote_tick, 0xff, sizeof(ls->remote_tick));
+    ls->since = get_time_sec();
+    ls->hash = cfg->hash = lockstep_settings_hash();
+
+    if (mode == MODE_SERVER) {
+        if (send_hello(ls, cfg) < 0) { free(ls); return NULL; }
+        return ls;
+    }
+
+    // Client: the server's settings come first
+    double deadline = get_time_sec() + LS_HELLO_TIMEOUT;
+    while (get_time_sec() < deadline) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        poll(&pfd, 1, 100);
+        if (net_link_fill(&ls->link) < 0) break;
+        size_t pos = 0, len;
+        const unsigned char *p;
+        int kind = net_link_next(&ls->link, &pos, &p, &len);
+        if (kind == 0) continue;
+        if (kind != LS_HELLO || len < LS_HELLO_LEN) break;
+        cfg->seed = get32(&p);
+        cfg->rate = get16(&p);
+        cfg->substeps = get16(&p);
+        cfg->delay = get8(&p);
+        cfg->hash = get32(&p);
+        net_link_consume(&ls->link, pos);   // Inputs may follow in the same read
+        if (cfg->rate <= 0 || cfg->substeps <= 0 || cfg->delay >= LOCKSTEP_WINDOW) break;
+        if (cfg->hash != ls->hash) {
+            // Same inputs, different physics: a desync by design
+            log_message(SYSTEM_LOG_FILE, "Lockstep", "Settings differ from the server's (hash %08x, ours %08x): refused",
+                        cfg->hash, ls->hash);
+            net_link_queue(&ls->link, LS_BYE, NULL, 0);
+            free(ls);
+            return NULL;
+        }
+        send_hello(ls, cfg);     // Our answer: the server checks it too
+        return ls;
+    }
+    log_message(SYSTEM_LOG_FILE, "Lockstep", "No valid settings from the server");
+    free(ls);
+    return NULL;
+}
+
+void net_lockstep_close(NetLockstep *ls) {
+    if (!ls) return;
+    net_link_queue(&ls->link, LS_BYE, NULL, 0);
+    free(ls);
+}
+
+int net_lockstep_send_input(NetLockstep *ls, const InputCmd *in) {
+    unsigned char buf[8], *p = buf;
+    p = put32(p, in->seq);
+    p = put16(p, (uint16_t)(int16_t)lroundf(in->force.x * LOCKSTEP_FORCE_SCALE));
+    p = put16(p, (uint16_t)(int16_t)lroundf(in->force.y * LOCKSTEP_FORCE_SCALE));
+    return net_link_queue(&ls->link, LS_INPUT, buf, p - buf);
+}
+
+int net_lockstep_recv(NetLockstep *ls, InputCmd *inputs, int max) {
+    int closed = net_link_fill(&ls->link);
+    int got = 0;
+    size_t pos = 0, len;
+    const unsigned char *p;
+    int kind;
+    while (got < max && (kind = net_link_next(&ls->link, &pos, &p, &len)) != 0) {
+        if (kind == LS_BYE) return -1;
+        if (kind == LS_INPUT && len >= 8) {
+            InputCmd *in = &inputs[got++];
+            memset(in, 0, sizeof(InputCmd));
+            in->seq = get32(&p);
+            in->force.x = (int16_t)get16(&p) / LOCKSTEP_FORCE_SCALE;
+            in->force.y = (int16_t)get16(&p) / LOCKSTEP_FORCE_SCALE;
+            ls->inputs_in++;
+        }
+        else if (kind == LS_CHECK && len >= 8) {
+            unsigned int tick = get32(&p);
+            int i = tick % LOCKSTEP_WINDOW;
+            ls->remote_tick[i] = tick;
+            ls->remote_sum[i] = get32(&p);
+            compare(ls, tick);
+        }
+        else if (kind == LS_HELLO && len >= LS_HELLO_LEN) {
+            // The client's answer: its settings must be ours too
+            p += LS_HELLO_LEN - 4;
+            unsigned int hash = get32(&p);
+            if (hash != ls->hash) {
+                log_message(SYSTEM_LOG_FILE, "Lockstep", "Client settings differ from ours (hash %08x, ours %08x): refused",
+                            hash, ls->hash);
+                net_link_consume(&ls->link, pos);
+                return -1;
+            }
+        }
+    }
+    net_link_consume(&ls->link, pos);
+    if (closed < 0) return -1;
+    return got;
+}
+
+void net_lockstep_check(NetLockstep *ls, unsigned int tick, unsigned int sum) {
+    int i = tick % LOCKSTEP_WINDOW;
+    ls->local_tick[i] = tick;
+    ls->local_sum[i] = sum;
+    compare(ls, tick);
+    unsigned char buf[8], *p = buf;
+    p = put32(p, tick);
+    p = put32(p, sum);
+    net_link_queue(&ls->link, LS_CHECK, buf, p - buf);
+}
+
+void net_lockstep_report(NetLockstep *ls, const char *who) {
+    double now = get_time_sec();
+    double span = now - ls->since;
+    if (span <= 0) return;
+    log_message(SYSTEM_LOG_FILE, who,
+                "Lockstep: %.1f inputs/s in, out %.0f B/s, in %.0f B/s, %lu checksums compared, %lu desyncs%s",
+                ls->inputs_in / span, ls->link.bytes_out / span, ls->link.bytes_in / span,
+                ls->checks, ls->desyncs, ls->desyncs ? " (see first DESYNC line)" : "");
+    ls->link.bytes_out = ls->link.bytes_in = 0;
+    ls->inputs_in = ls->checks = 0;
+    ls->since = now;
+}
+
+void net_lockstep_link_stats(NetLockstep *ls, LinkStats *out) {
+    net_quality_read(&ls->link.quality, ls->link.fd, out);
+}
@@ -0,0 +1,73 @@
+#ifndef NET_LOCKSTEP_H
+#define NET_LOCKSTEP_H
+
+#include "common.h"
+
+// DETERMINISTIC LOCKSTEP (NET_PROTO_LOCKSTEP, NET_SYNC lockstep)
+// Both peers run the same fixed-step simulation of the whole game (both
+// drones, obstacles, targets, scores) in their Dynamics, from the same
+// seed. Only the command forces cross the wire: the input of tick n is
+// sampled at tick n - delay and sent at once, and tick n is simulated
+// when both inputs for it are there. Every LOCKSTEP_CHECK_TICKS ticks
+// each side sends a checksum of its state; a difference is a desync.
+//
+// Binary frames (net_frame.h):
+//   LS_HELLO server -> client, once: u32 seed | u16 tick rate |
+//            u16 physics steps per tick | u8 input delay (ticks) |
+//            u32 settings hash; the client answers with the same frame.
+//            A peer whose hash differs is refused (lockstep_settings_hash).
+//   LS_INPUT  u32 tick | i16 fx | i16 fy        (11 bytes a tick)
+//   LS_CHECK  u32 tick | u32 checksum
+//   LS_BYE    no payload
+// Bandwidth depends on the tick rate only, not on the world size.
+
+#define LOCKSTEP_RATE        50   // Default ticks per second
+#define LOCKSTEP_DELAY       4    // Default input delay (ticks)
+#define LOCKSTEP_CHECK_TICKS 50   // Ticks between two checksums
+#define LOCKSTEP_WINDOW      128  // Ticks of inputs / checksums kept (> delay)
+#define LOCKSTEP_FORCE_SCALE 100.0f // Forces travel in 0.01 N: both sides
+                                    // simulate the rounded value
+
+typedef struct {
+    unsigned int seed;
+    int rate;           // Ticks per second
+    int substeps;       // Physics steps per tick
+    int delay;          // Input delay (ticks)
+    unsigned int hash;  // lockstep_settings_hash() of the sender
+} LockstepConfig;
+
+// The local parameters the simulation depends on besides the config:
+// physics (M, K, REPULSION_*, ATTRACTION_*, OBSTACLE_COLLISION,
+// OBSTACLE_HIT_RADIUS) and obstacles (OBSTACLE_MOTION, OBSTACLE_SPEED,
+// OBSTACLE_RADIUS). Dynamics ignores changes to them during a session.
+unsigned int lockstep_settings_hash(void);
+int lockstep_settings_key(const char *key);
+
+typedef struct NetLockstep NetLockstep;
+
+// Takes over a connected socket after a NET_PROTO_LOCKSTEP handshake.
+// The server sends *cfg; the client waits for it and fills *cfg, and
+// fails if the server's settings hash is not ours (the server then gets
+// -1 from net_lockstep_recv).
+NetLockstep *net_lockstep_open(int fd, int mode, LockstepConfig *cfg);
+
+// Sends LS_BYE (best effort) and frees the session (the socket stays open)
+void net_lockstep_close(NetLockstep *ls);
+
+// Sends our input for tick in->seq (force only)
+int net_lockstep_send_input(NetLockstep *ls, const InputCmd *in);
+
+// Reads the peer's inputs (at most 'max', seq = tick) and checksums.
+// Returns the number of inputs, -1 if the connection is gone.
+int net_lockstep_recv(NetLockstep *ls, InputCmd *inputs, int max);
+
+// Our checksum of tick 'tick': sent, and compared with the peer's
+void net_lockstep_check(NetLockstep *ls, unsigned int tick, unsigned int sum);
+
+// Logs the traffic and the checksums compared / mismatched
+void net_lockstep_report(NetLockstep *ls, const char *who);
+
+// Link quality since the last call (net_frame.h)
+void net_lockstep_link_stats(NetLockstep *ls, LinkStats *out);
+
+#endif
@@ -0,0 +1,563 @@
+#include <math.h>
+#include <sys/socket.h>
+#include "net_world.h"
+#include "net_frame.h"
+
+#define NET_SNAPSHOT 1
+#define NET_INPUT    2
+#define NET_BYE      3
+
+// Quantised records: compared with memcmp, so always built from zero
+typedef struct { uint8_t present; uint16_t x, y; int16_t vx, vy, fx, fy; uint16_t score; } QPlayer;
+typedef struct { uint8_t present, type; uint16_t x, y, speed, radius; uint32_t seed; int32_t t0; } QObstacle;
+typedef struct { uint8_t present, active; uint16_t x, y; } QTarget;
+
+typedef struct {
+    QPlayer p[MAX_PLAYERS];
+    QObstacle o[MAX_OBSTACLES];
+    QTarget t[MAX_TARGETS];
+} QWorld;
+
+struct NetPeer {
+    NetLink link;
+    int mode;
+    double epoch;                       // Server: session start (time_ms = 0)
+    double offset;                      // Client: local clock - server clock
+    int have_offset;
+    int player;                         // Client: our slot. Server: the client's.
+
+    QWorld history[NET_HISTORY];        // Sent (server) / received (client) worlds
+    QWorld applied;                     // Client: the world in the caller's arrays
+    uint32_t history_seq[NET_HISTORY];
+    uint32_t seq;                       // Server: last sent. Client: last applied.
+    uint32_t acked;                     // Server: last acknowledged by the client
+    uint32_t input_ack;                 // Server: last client input simulated.
+                                        // Client: the same, from the last snapshot
+
+    // Statistics (reset by net_world_report)
+    unsigned long snapshots, full, records, skipped;
+    unsigned long deferred;             // Server: drone updates held back (area of interest)
+    double since;
+};
+
+static uint16_t qpos(float v) {
+    long q = lroundf(v * NET_POS_SCALE);
+    return q < 0 ? 0 : (q > 65535 ? 65535 : (uint16_t)q);
+}
+static int16_t qvel(float v) {
+    long q = lroundf(v * NET_VEL_SCALE);
+    return q < -32768 ? -32768 : (q > 32767 ? 32767 : (int16_t)q);
+}
+
+static void quantise_drone(QPlayer *q, const DroneState *d) {
+    q->x = qpos(d->position.x);  q->y = qpos(d->position.y);
+    q->vx = qvel(d->velocity.x); q->vy = qvel(d->velocity.y);
+    q->fx = qvel(d->force.x);    q->fy = qvel(d->force.y);
+}
+
+// Obstacle start times are sent in ms since 'epoch' (the stream's session start)
+static void quantise(double epoch, QWorld *w, const Player *players, const Obstacle *obs, const Target *tar) {
+    memset(w, 0, sizeof(QWorld));
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (players[i].id == -1) continue;
+        w->p[i].present = 1;
+        quantise_drone(&w->p[i], &players[i].drone);
+        w->p[i].score = (uint16_t)players[i].score;
+    }
+    for (int i = 0; i < MAX_OBSTACLES; i++) {
+        if (obs[i].id == -1) continue;
+        QObstacle *q = &w->o[i];
+        q->present = 1;
+        q->x = qpos(obs[i].position.x); q->y = qpos(obs[i].position.y);
+        q->type = (uint8_t)obs[i].motion.type;
+        q->seed = obs[i].motion.seed;
+        q->speed = (uint16_t)lroundf(obs[i].motion.speed * NET_VEL_SCALE);
+        q->radius = (uint16_t)lroundf(obs[i].motion.radius * NET_VEL_SCALE);
+        q->t0 = (int32_t)lround((obs[i].motion.t0 - epoch) * 1000.0);
+    }
+    for (int i = 0; i < MAX_TARGETS; i++) {
+        if (tar[i].id == -1) continue;
+        w->t[i].present = 1;
+        w->t[i].active = (uint8_t)tar[i].active;
+        w->t[i].x = qpos(tar[i].position.x); w->t[i].y = qpos(tar[i].position.y);
+    }
+}
+
+// Records: an absent entity is just its 'present' byte. The readers
+// return -1 if the record would go past 'end' (nothing read past it).
+static unsigned char *put_player(unsigned char *p, const QPlayer *q) {
+    p = put8(p, q->present);
+    if (!q->present) return p;
+    p = put16(p, q->x); p = put16(p, q->y);
+    p = put16(p, q->vx); p = put16(p, q->vy);
+    p = put16(p, q->fx); p = put16(p, q->fy);
+    return put16(p, q->score);
+}
+static int get_player(const unsigned char **p, const unsigned char *end, QPlayer *q) {
+    memset(q, 0, sizeof(*q));
+    if (end - *p < 1) return -1;
+    q->present = get8(p);
+    if (!q->present) return 0;
+    if (end - *p < 14) return -1;
+    q->x = get16(p); q->y = get16(p);
+    q->vx = get16(p); q->vy = get16(p);
+    q->fx = get16(p); q->fy = get16(p);
+    q->score = get16(p);
+    return 0;
+}
+static unsigned char *put_obstacle(unsigned char *p, const QObstacle *q) {
+    p = put8(p, q->present);
+    if (!q->present) return p;
+    p = put16(p, q->x); p = put16(p, q->y);
+    p = put8(p, q->type); p = put32(p, q->seed);
+    p = put16(p, q->speed); p = put16(p, q->radius);
+    return put32(p, (uint32_t)q->t0);
+}
+static int get_obstacle(const unsigned char **p, const unsigned char *end, QObstacle *q) {
+    memset(q, 0, sizeof(*q));
+    if (end - *p < 1) return -1;
+    q->present = get8(p);
+    if (!q->present) return 0;
+    if (end - *p < 17) return -1;
+    q->x = get16(p); q->y = get16(p);
+    q->type = get8(p); q->seed = get32(p);
+    q->speed = get16(p); q->radius = get16(p);
+    q->t0 = (int32_t)get32(p);
+    return 0;
+}
+static unsigned char *put_target(unsigned char *p, const QTarget *q) {
+    p = put8(p, q->present);
+    if (!q->present) return p;
+    p = put8(p, q->active);
+    p = put16(p, q->x);
+    return put16(p, q->y);
+}
+static int get_target(const unsigned char **p, const unsigned char *end, QTarget *q) {
+    memset(q, 0, sizeof(*q));
+    if (end - *p < 1) return -1;
+    q->present = get8(p);
+    if (!q->present) return 0;
+    if (end - *p < 5) return -1;
+    q->active = get8(p);
+    q->x = get16(p); q->y = get16(p);
+    return 0;
+}
+
+// A NET_SNAPSHOT payload: the records of 'cur' that differ from 'base'.
+// Returns its length; adds the records written to *records.
+static size_t encode_snapshot(unsigned char *buf, uint32_t seq, uint32_t base_seq, int32_t time_ms, uint32_t input_ack,
+                              uint8_t player, const QWorld *cur, const QWorld *base, unsigned long *records) {
+    uint32_t pmask = 0, omask = 0, tmask = 0;
+    for (int i = 0; i < MAX_PLAYERS; i++)   if (memcmp(&cur->p[i], &base->p[i], sizeof(QPlayer))) pmask |= 1u << i;
+    for (int i = 0; i < MAX_OBSTACLES; i++) if (memcmp(&cur->o[i], &base->o[i], sizeof(QObstacle))) omask |= 1u << i;
+    for (int i = 0; i < MAX_TARGETS; i++)   if (memcmp(&cur->t[i], &base->t[i], sizeof(QTarget))) tmask |= 1u << i;
+
+    unsigned char *p = buf;
+    p = put32(p, seq);
+    p = put32(p, base_seq);
+    p = put32(p, (uint32_t)time_ms);
+    p = put32(p, input_ack);
+    p = put8(p, player);
+    p = put8(p, (uint8_t)pmask);
+    p = put32(p, omask);
+    p = put16(p, (uint16_t)tmask);
+    for (int i = 0; i < MAX_PLAYERS; i++)   if (pmask & (1u << i)) { p = put_player(p, &cur->p[i]); (*records)++; }
+    for (int i = 0; i < MAX_OBSTACLES; i++) if (omask & (1u << i)) { p = put_obstacle(p, &cur->o[i]); (*records)++; }
+    for (int i = 0; i < MAX_TARGETS; i++)   if (tmask & (1u << i)) { p = put_target(p, &cur->t[i]); (*records)++; }
+    return p - buf;
+}
+
+NetPeer *net_world_open(int fd, int mode) {
+    NetPeer *peer = calloc(1, sizeof(NetPeer));
+    if (!peer) return NULL;
+    net_link_init(&peer->link, fd);
+    peer->mode = mode;
+    peer->epoch = get_time_sec();
+    peer->player = -1;
+    peer->since = peer->epoch;
+    return peer;
+}
+
+void net_world_close(NetPeer *peer) {
+    if (!peer) return;
+    net_link_queue(&peer->link, NET_BYE, NULL, 0);
+    free(peer);
+}
+
+int net_world_player(const NetPeer *peer) { return peer->player; }
+
+// SERVER
+
+int net_world_recv_inputs(NetPeer *peer, InputCmd *inputs, int max) {
+    int closed = net_link_fill(&peer->link);
+    int got = 0;
+    size_t pos = 0, len;
+    const unsigned char *p;
+    int kind;
+    while (got < max && (kind = net_link_next(&peer->link, &pos, &p, &len)) != 0) {
+        if (kind == NET_BYE) return -1;
+        if (kind != NET_INPUT || len < 22) continue;
+        uint32_t ack = get32(&p);
+        if (ack && (int32_t)(ack - peer->acked) > 0 && (int32_t)(peer->seq - ack) >= 0) peer->acked = ack;
+        uint32_t seq = get32(&p);
+        if (peer->input_ack && !seq_is_newer(seq, peer->input_ack)) continue;   // Duplicate
+        InputCmd *in = &inputs[got++];
+        in->seq = seq;
+        in->t0 = peer->epoch + (int32_t)get32(&p) / 1000.0;
+        in->force.x = (int16_t)get16(&p) / NET_VEL_SCALE;
+        in->force.y = (int16_t)get16(&p) / NET_VEL_SCALE;
+        in->steps = get16(&p);
+        in->dt = get32(&p) / 1e6f;
+        peer->input_ack = seq;
+    }
+    net_link_consume(&peer->link, pos);
+    if (closed < 0) return -1;
+    return got;
+}
+
+int net_world_send_snapshot(NetPeer *peer, double now, int player, const Player *players,
+                            unsigned int players_due, const Obstacle *obs, const Target *tar) {
+    if (net_link_flush(&peer->link) < 0) return -1;
+    if (peer->link.out_len > 0) { peer->skipped++; return 0; }
+
+    // Baseline: the last snapshot the client confirmed, if still in the history
+    static const QWorld empty;
+    const QWorld *base = &empty;
+    uint32_t base_seq = 0;
+    if (peer->acked && peer->seq - peer->acked < NET_HISTORY &&
+        peer->history_seq[peer->acked % NET_HISTORY] == peer->acked) {
+        base = &peer->history[peer->acked % NET_HISTORY];
+        base_seq = peer->acked;
+    }
+
+    // The previous snapshot: the newest value the client may have
+    const QWorld *prev = base;
+    if (peer->seq && peer->history_seq[peer->seq % NET_HISTORY] == peer->seq) prev = &peer->history[peer->seq % NET_HISTORY];
+
+    peer->player = player;
+    uint32_t seq = peer->seq + 1;
+    if (seq == 0) seq = 1;                  // 0 means "no baseline"
+    QWorld *cur = &peer->history[seq % NET_HISTORY];
+    quantise(peer->epoch, cur, players, obs, tar);
+    // Drones not due keep the value of the previous snapshot (their change
+    // goes out in a later one); joins and departures are never deferred
+    if (base_seq) {
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            if (!(players_due & (1u << i)) && cur->p[i].present == prev->p[i].present) {
+                if (memcmp(&cur->p[i], &prev->p[i], sizeof(QPlayer))) peer->deferred++;
+                cur->p[i] = prev->p[i];
+            }
+        }
+    }
+    peer->history_seq[seq % NET_HISTORY] = seq;
+    peer->seq = seq;
+
+    unsigned char buf[NET_BUF_SIZE / 2];
+    size_t len = encode_snapshot(buf, seq, base_seq, (int32_t)lround((now - peer->epoch) * 1000.0), peer->input_ack,
+                                 (uint8_t)player, cur, base, &peer->records);
+    peer->snapshots++;
+    if (base_seq == 0) peer->full++;
+    return net_link_queue(&peer->link, NET_SNAPSHOT, buf, len);
+}
+
+// SPECTATORS
+
+struct NetSpectators {
+    NetFanout conn[NET_MAX_SPECTATORS];
+    int used[NET_MAX_SPECTATORS];
+    int need_full[NET_MAX_SPECTATORS];  // Joined, or missed a frame
+    unsigned char in[NET_MAX_SPECTATORS][64];   // What they send: only pings
+    size_t in_len[NET_MAX_SPECTATORS];
+    int count;
+    double epoch;
+    QWorld prev;                        // The world of the last round
+    uint32_t seq;
+
+    // Statistics (reset by net_spectators_report)
+    unsigned long rounds, encoded, queued, missed, records;
+    unsigned long bytes_out;
+    double encode_time, since;
+};
+
+NetSpectators *net_spectators_create(void) {
+    NetSpectators *s = calloc(1, sizeof(NetSpectators));
+    if (!s) return NULL;
+    s->epoch = s->since = get_time_sec();
+    return s;
+}
+
+int net_spectators_add(NetSpectators *s, int fd) {
+    for (int i = 0; i < NET_MAX_SPECTATORS; i++) {
+        if (s->used[i]) continue;
+        net_fanout_init(&s->conn[i], fd);
+        s->used[i] = 1;
+        s->need_full[i] = 1;
+        s->in_len[i] = 0;
+        s->count++;
+        return 0;
+    }
+    return -1;
+}
+
+static void drop_spectator(NetSpectators *s, int i) {
+    net_fanout_clear(&s->conn[i]);
+    close(s->conn[i].fd);
+    s->used[i] = 0;
+    s->count--;
+    log_message(SYSTEM_LOG_FILE, "NetWorld", "Spectator left (%d watching)", s->count);
+}
+
+int net_spectators_send(NetSpectators *s, double now, const Player *players, const Obstacle *obs, const Target *tar) {
+    if (s->count == 0) return 0;
+    double start = get_time_sec();
+
+    // 1. The world of this round, encoded at most twice whatever the
+    //    number of spectators: the delta, and the full world if needed
+    static const QWorld empty;
+    QWorld cur;
+    quantise(s->epoch, &cur, players, obs, tar);
+    uint32_t seq = s->seq + 1;
+    if (seq == 0) seq = 1;
+    int32_t time_ms = (int32_t)lround((now - s->epoch) * 1000.0);
+    NetShared *delta = NULL, *full = NULL;
+    unsigned char buf[NET_BUF_SIZE / 2];
+    for (int i = 0; i < NET_MAX_SPECTATORS; i++) {
+        if (!s->used[i]) continue;
+        if (s->need_full[i] || s->seq == 0) {
+            if (!full) {
+                size_t len = encode_snapshot(buf, seq, 0, time_ms, 0, 0xff, &cur, &empty, &s->records);
+                full = net_shared_frame(NET_SNAPSHOT, buf, len);
+                s->encoded++;
+            }
+        } else if (!delta) {
+            size_t len = encode_snapshot(buf, seq, s->seq, time_ms, 0, 0xff, &cur, &s->prev, &s->records);
+            delta = net_shared_frame(NET_SNAPSHOT, buf, len);
+            s->encoded++;
+        }
+    }
+    s->prev = cur;
+    s->seq = seq;
+    s->encode_time += get_time_sec() - start;
+    s->rounds++;
+
+    // 2. The same buffers for everyone. A spectator whose queue is full
+    //    misses the frame and gets the full world when it has drained.
+    for (int i = 0; i < NET_MAX_SPECTATORS; i++) {
+        if (!s->used[i]) continue;
+        // Read-only: only its pings are answered, the end of its stream ends it
+        ssize_t n;
+        while ((n = recv(s->conn[i].fd, s->in[i] + s->in_len[i], sizeof(s->in[i]) - s->in_len[i], MSG_DONTWAIT)) > 0) {
+            s->in_len[i] += n;
+            size_t pos = 0;
+            while (s->in_len[i] - pos >= NET_HEADER) {
+                const unsigned char *p = s->in[i] + pos;
+                int kind = get8(&p);
+                size_t len = get16(&p);
+                if (NET_HEADER + len > sizeof(s->in[i])) { s->in_len[i] = pos = 0; break; }   // Not ours: dropped
+                if (s->in_len[i] - pos < NET_HEADER + len) break;
+                if (kind == NET_PING) {
+                    NetShared *pong = net_shared_frame(NET_PONG, p, len);
+                    if (pong && net_fanout_push(&s->conn[i], pong) == 0) s->queued++;
+                    net_shared_release(pong);
+                }
+                pos += NET_HEADER + len;
+            }
+            memmove(s->in[i], s->in[i] + pos, s->in_len[i] - pos);
+            s->in_len[i] -= pos;
+        }
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            drop_spectator(s, i);
+            continue;
+        }
+        NetShared *frame = s->need_full[i] ? full : delta;
+        if (frame && net_fanout_push(&s->conn[i], frame) == 0) {
+            s->need_full[i] = 0;
+            s->queued++;
+        } else {
+            s->need_full[i] = 1;
+            s->missed++;
+        }
+        unsigned long before = s->conn[i].bytes_out;
+        if (net_fanout_flush(&s->conn[i]) < 0) { drop_spectator(s, i); continue; }
+        s->bytes_out += s->conn[i].bytes_out - before;
+    }
+    net_shared_release(delta);      // The queues hold their own references
+    net_shared_release(full);
+    return s->count;
+}
+
+void net_spectators_report(NetSpectators *s, const char *who) {
+    double now = get_time_sec();
+    double span = now - s->since;
+    if (span <= 0 || s->rounds == 0) return;
+    log_message(SYSTEM_LOG_FILE, who,
+                "Spectators: %d watching, %.2f encodings/round (%.1f us), %lu frames queued, %lu missed, out %.0f B/s",
+                s->count, (double)s->encoded / s->rounds, s->encode_time / s->rounds * 1e6,
+                s->queued, s->missed, s->bytes_out / span);
+    s->rounds = s->encoded = s->queued = s->missed = s->records = s->bytes_out = 0;
+    s->encode_time = 0.0;
+    s->since = now;
+}
+
+void net_spectators_close(NetSpectators *s) {
+    if (!s) return;
+    for (int i = 0; i < NET_MAX_SPECTATORS; i++) {
+        if (s->used[i]) { net_fanout_clear(&s->conn[i]); close(s->conn[i].fd); }
+    }
+    free(s);
+}
+
+// CLIENT
+
+static void apply_snapshot(NetPeer *peer, const QWorld *w, Player *players,
+                           Obstacle *obs, Target *tar, const WorldChanges *mask) {
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (!(mask->players & (1u << i))) continue;
+        const QPlayer *q = &w->p[i];
+        players[i].id = q->present ? i : -1;
+        players[i].score = q->score;
+        players[i].local = (i == peer->player);
+        players[i].drone.position.x = q->x / NET_POS_SCALE;  players[i].drone.position.y = q->y / NET_POS_SCALE;
+        players[i].drone.velocity.x = q->vx / NET_VEL_SCALE; players[i].drone.velocity.y = q->vy / NET_VEL_SCALE;
+        players[i].drone.force.x = q->fx / NET_VEL_SCALE;    players[i].drone.force.y = q->fy / NET_VEL_SCALE;
+    }
+    for (int i = 0; i < MAX_OBSTACLES; i++) {
+        if (!(mask->obstacles & (1u << i))) continue;
+        const QObstacle *q = &w->o[i];
+        memset(&obs[i], 0, sizeof(Obstacle));
+        obs[i].id = q->present ? i : -1;
+        obs[i].position.x = q->x / NET_POS_SCALE; obs[i].position.y = q->y / NET_POS_SCALE;
+        obs[i].motion.type = q->type;
+        obs[i].motion.seed = q->seed;
+        obs[i].motion.speed = q->speed / NET_VEL_SCALE;
+        obs[i].motion.radius = q->radius / NET_VEL_SCALE;
+        obs[i].motion.t0 = q->t0 / 1000.0 + peer->offset;   // Server clock -> ours
+    }
+    for (int i = 0; i < MAX_TARGETS; i++) {
+        if (!(mask->targets & (1u << i))) continue;
+        const QTarget *q = &w->t[i];
+        tar[i].id = q->present ? i : -1;
+        tar[i].active = q->active;
+        tar[i].position.x = q->x / NET_POS_SCALE; tar[i].position.y = q->y / NET_POS_SCALE;
+    }
+}
+
+int net_world_recv_snapshot(NetPeer *peer, double now, Player *players, Obstacle *obs,
+                            Target *tar, WorldChanges *changed) {
+    memset(changed, 0, sizeof(WorldChanges));
+    int closed = net_link_fill(&peer->link);
+    int applied = 0;
+    size_t pos = 0, len;
+    const unsigned char *p;
+    int kind;
+    while ((kind = net_link_next(&peer->link, &pos, &p, &len)) != 0) {
+        if (kind == NET_BYE) return -1;
+        if (kind != NET_SNAPSHOT || len < 24) continue;
+        const unsigned char *end = p + len;
+        uint32_t seq = get32(&p);
+        uint32_t base_seq = get32(&p);
+        double server_time = (int32_t)get32(&p) / 1000.0;
+        uint32_t input_ack = get32(&p);
+        peer->player = get8(&p);
+        if (peer->player >= MAX_PLAYERS) peer->player = -1;     // Spectator
+        WorldChanges mask;
+        mask.players = get8(&p);
+        mask.obstacles = get32(&p);
+        mask.targets = get16(&p);
+
+        // Clock: the smallest (local - server) seen is the closest to the
+        // real offset (the others include the network delay)
+        if (!peer->have_offset || now - server_time < peer->offset) {
+            peer->offset = now - server_time;
+            peer->have_offset = 1;
+        }
+
+        // Rebuild the full world: baseline + changed records
+        // [FIX] Into a copy: the masks come off the wire, every record is
+        // checked against the payload length before it is read, and the
+        // history slot is only written once the whole frame parsed
+        QWorld next;
+        if (base_seq == 0) memset(&next, 0, sizeof(QWorld));
+        else if (peer->history_seq[base_seq % NET_HISTORY] != base_seq) {
+            log_message(SYSTEM_LOG_FILE, "NetWorld", "Snapshot %u: unknown baseline %u", seq, base_seq);
+            return -1;
+        }
+        else next = peer->history[base_seq % NET_HISTORY];
+
+        int bad = 0;
+        for (int i = 0; i < MAX_PLAYERS && !bad; i++)   if (mask.players & (1u << i)) bad = get_player(&p, end, &next.p[i]);
+        for (int i = 0; i < MAX_OBSTACLES && !bad; i++) if (mask.obstacles & (1u << i)) bad = get_obstacle(&p, end, &next.o[i]);
+        for (int i = 0; i < MAX_TARGETS && !bad; i++)   if (mask.targets & (1u << i)) bad = get_target(&p, end, &next.t[i]);
+        if (bad) {
+            log_message(SYSTEM_LOG_FILE, "NetWorld", "Snapshot %u: truncated", seq);
+            return -1;
+        }
+        QWorld *w = &peer->history[seq % NET_HISTORY];
+        *w = next;
+        peer->history_seq[seq % NET_HISTORY] = seq;
+        peer->seq = seq;
+        peer->input_ack = input_ack;
+        peer->snapshots++;
+        if (base_seq == 0) peer->full++;
+
+        // What changed for us: against the world we had, not the baseline
+        WorldChanges diff = {0, 0, 0};
+        for (int i = 0; i < MAX_PLAYERS; i++)   if (memcmp(&w->p[i], &peer->applied.p[i], sizeof(QPlayer))) diff.players |= 1u << i;
+        for (int i = 0; i < MAX_OBSTACLES; i++) if (memcmp(&w->o[i], &peer->applied.o[i], sizeof(QObstacle))) diff.obstacles |= 1u << i;
+        for (int i = 0; i < MAX_TARGETS; i++)   if (memcmp(&w->t[i], &peer->applied.t[i], sizeof(QTarget))) diff.targets |= 1u << i;
+        apply_snapshot(peer, w, players, obs, tar, &diff);
+        peer->applied = *w;
+        peer->records += __builtin_popcount(diff.players) + __builtin_popcount(diff.obstacles) +
+                         __builtin_popcount(diff.targets);
+
+        changed->players |= diff.players;
+        changed->obstacles |= diff.obstacles;
+        changed->targets |= diff.targets;
+        applied++;
+    }
+    net_link_consume(&peer->link, pos);
+    if (closed < 0) return -1;
+    return applied;
+}
+
+int net_world_send_input(NetPeer *peer, const InputCmd *in) {
+    if (!peer->have_offset) return 0;    // No server clock before the first snapshot
+    unsigned char buf[22], *p = buf;
+    p = put32(p, peer->seq);
+    p = put32(p, in->seq);
+    p = put32(p, (uint32_t)(int32_t)lround((in->t0 - peer->offset) * 1000.0));  // Server clock
+    p = put16(p, (uint16_t)qvel(in->force.x));
+    p = put16(p, (uint16_t)qvel(in->force.y));
+    p = put16(p, (uint16_t)(in->steps > 65535 ? 65535 : in->steps));
+    p = put32(p, (uint32_t)lroundf(in->dt * 1e6f));
+    return net_link_queue(&peer->link, NET_INPUT, buf, p - buf);
+}
+
+unsigned int net_world_input_ack(const NetPeer *peer, DroneState *state) {
+    if (peer->player < 0 || peer->player >= MAX_PLAYERS) return 0;
+    const QPlayer *q = &peer->applied.p[peer->player];
+    state->position.x = q->x / NET_POS_SCALE;  state->position.y = q->y / NET_POS_SCALE;
+    state->velocity.x = q->vx / NET_VEL_SCALE; state->velocity.y = q->vy / NET_VEL_SCALE;
+    state->force.x = q->fx / NET_VEL_SCALE;    state->force.y = q->fy / NET_VEL_SCALE;
+    return peer->input_ack;
+}
+
+void net_world_report(NetPeer *peer, const char *who) {
+    double now = get_time_sec();
+    double span = now - peer->since;
+    if (span <= 0) return;
+    log_message(SYSTEM_LOG_FILE, who,
+                "World sync (player %d): %lu snapshots (%lu full, %lu skipped), %.1f records/snapshot, "
+                "%lu drone updates deferred, out %.0f B/s, in %.0f B/s",
+                peer->player, peer->snapshots, peer->full, peer->skipped,
+                peer->snapshots ? (double)peer->records / peer->snapshots : 0.0,
+                peer->deferred, peer->link.bytes_out / span, peer->link.bytes_in / span);
+    peer->link.bytes_out = peer->link.bytes_in = 0;
+    peer->snapshots = peer->full = peer->records = peer->skipped = peer->deferred = 0;
+    peer->since = now;
+}
+
+void net_world_link_stats(NetPeer *peer, LinkStats *out) {
+    net_quality_read(&peer->link.quality, peer->link.fd, out);
+    out->peer = (peer->mode == MODE_SERVER) ? peer->player : -1;
+}
@@ -0,0 +1,115 @@
+#ifndef NET_WORLD_H
+#define NET_WORLD_H
+
+#include "common.h"
+
+// WORLD SYNC (NET_PROTO_WORLD, negotiated by sync_handshake)
+// The server owns the world: obstacles, targets, every drone and the
+// scores. Clients send their inputs (command force held for N physics
+// steps), the server runs them on its copy of their drone, and the
+// clients apply the server's snapshots to their local Blackboard.
+//
+// Binary frames after the text handshake (big endian):
+//   u8 kind | u16 payload length | payload
+//   NET_SNAPSHOT server -> client:
+//       u32 seq | u32 baseline | i32 time_ms | u32 input ack | u8 your_id |
+//       u8 player mask | u32 obstacle mask | u16 target mask | records
+//   NET_INPUT client -> server: u32 ack | u32 input seq | i32 t0_ms |
+//       i16 fx | i16 fy | u16 steps | u32 step_us
+//   NET_BYE either side, no payload
+// A snapshot only carries the entities whose quantised record differs
+// from the baseline, the last snapshot the client acknowledged (0 = none:
+// full snapshot). Bandwidth follows what changed, not the world size.
+// Positions are quantised to 1/NET_POS_SCALE m, speeds and forces to
+// 1/NET_VEL_SCALE; times are ms since the server's session start.
+
+#define NET_POS_SCALE 500.0f   // 2 mm
+#define NET_VEL_SCALE 100.0f   // 1 cm/s, 0.01 N
+#define NET_HISTORY   32       // Snapshots kept as possible baselines
+#define NET_SNAPSHOT_RATE 20   // Default snapshots per second
+
+typedef struct NetPeer NetPeer;
+
+// Which entities a snapshot changed (bit = slot / id)
+typedef struct {
+    unsigned int players;
+    unsigned int obstacles;
+    unsigned int targets;
+} WorldChanges;
+
+// Takes over a connected socket after a NET_PROTO_WORLD handshake
+// (switches it to non-blocking). mode: MODE_SERVER or MODE_CLIENT.
+NetPeer *net_world_open(int fd, int mode);
+
+// Sends NET_BYE (best effort) and frees the peer (the socket stays open)
+void net_world_close(NetPeer *peer);
+
+// SERVER
+// Reads the client's new inputs (at most 'max', in order, duplicates
+// dropped; t0 converted to our clock). Returns how many, -1 if the
+// connection is gone. The last one is acknowledged in the next snapshot.
+int net_world_recv_inputs(NetPeer *peer, InputCmd *inputs, int max);
+
+// Queues the world as a delta against the last acknowledged snapshot.
+// Skipped (returns 0) while the previous one is still being sent: the
+// next delta covers both. 'player' is the client's slot (your_id).
+// Only the drones in 'players_due' (bit = slot) are updated, the client
+// keeps its value of the others (area of interest, net_aoi.h); a full
+// snapshot has them all. Returns -1 if the connection is gone.
+int net_world_send_snapshot(NetPeer *peer, double now, int player, const Player *players,
+                            unsigned int players_due, const Obstacle *obs, const Target *tar);
+
+// SPECTATORS (NET_PROTO_SPECTATE): read-only clients sharing one stream.
+// Each round the world is encoded once, as a delta against the previous
+// round, into a reference counted buffer queued to every spectator
+// (net_frame.h); one that just joined or missed a frame gets the full
+// world instead, also encoded once. Serialisation costs the same for 1
+// or NET_MAX_SPECTATORS spectators. The frames are NET_SNAPSHOTs
+// (your_id 255, no input ack): the client side is the one above.
+#define NET_MAX_SPECTATORS 32
+
+typedef struct NetSpectators NetSpectators;
+
+NetSpectators *net_spectators_create(void);
+
+// Takes over a connected socket after a NET_PROTO_SPECTATE handshake.
+// -1 if NET_MAX_SPECTATORS are already watching.
+int net_spectators_add(NetSpectators *s, int fd);
+
+// One round: encodes the world and queues it to every spectator (the
+// ones gone are dropped). Returns the number still watching.
+int net_spectators_send(NetSpectators *s, double now, const Player *players,
+                        const Obstacle *obs, const Target *tar);
+
+// Logs spectators, encodings per round, frames queued/missed, bytes/s
+void net_spectators_report(NetSpectators *s, const char *who);
+
+// Closes every spectator socket and frees the stream
+void net_spectators_close(NetSpectators *s);
+
+// CLIENT
+// Applies every complete snapshot received. Returns the number applied
+// (changes in *changed), -1 if the connection is gone. Obstacle start
+// times are converted to the local clock.
+int net_world_recv_snapshot(NetPeer *peer, double now, Player *players, Obstacle *obs,
+                            Target *tar, WorldChanges *changed);
+
+// Sends one of our inputs with the acknowledgement of the last snapshot
+// applied (nothing before the first snapshot: no server clock yet)
+int net_world_send_input(NetPeer *peer, const InputCmd *in);
+
+// The last input the server had simulated in the last snapshot applied
+// (0 = none) and its state of our drone after it, in *state
+unsigned int net_world_input_ack(const NetPeer *peer, DroneState *state);
+
+// Our slot (client, after the first snapshot; -1 before, and for a spectator)
+int net_world_player(const NetPeer *peer);
+
+// Logs the traffic counters (bytes, snapshots, full/delta, records)
+void net_world_report(NetPeer *peer, const char *who);
+
+// Link quality since the last call (net_frame.h; peer = the client's
+// slot on the server, -1 on a client)
+void net_world_link_stats(NetPeer *peer, LinkStats *out);
+
+#endif
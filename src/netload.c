@@ -0,0 +1,426 @@
+#include "common.h"
+#include "socket_manager.h"
+#include "net_world.h"
+#include <getopt.h>
+#include <poll.h>
+#include <math.h>
+#include <signal.h>
+#include <sys/time.h>
+
+// SYNTHETIC LOAD on a running server (./main --mode server)
+// Opens N player connections (and M spectators) from one process; each
+// does the normal handshake (sync_handshake), then replays a movement
+// pattern:
+//   world   inputs (a force held for one input period), as Dynamics sends them
+//   legacy  positions, answering the server's text exchange (one client:
+//           the legacy server only serves one)
+// Everything is measured on the client side: snapshots and bytes per
+// second (the server's throughput), input -> acknowledgement latency
+// (legacy: position -> "pok") and the interval between two snapshots,
+// as percentiles. --delay holds every outgoing input, --loss drops a
+// share of them (TCP itself never loses: this is what a lossy link does
+// to the input stream). Clients beyond the server's capacity are refused
+// and counted.
+// Usage: ./netload [--clients N] [--spectators N] [--proto world|legacy] ...
+
+#define LOAD_MAX      64       // Connections (players + spectators)
+#define LOAD_HISTORY  256      // Inputs in flight (by seq)
+#define LOAD_QUEUE    64       // Inputs held by --delay, per client
+#define LOAD_SPEED    5.0f     // m/s: legacy positions follow the pattern at this speed
+#define LOAD_TURN     0.5      // s: the random pattern changes direction this often
+#define LOAD_HANDSHAKE_TIMEOUT 5   // s: a server that does not answer
+
+enum { PATTERN_STILL, PATTERN_CIRCLE, PATTERN_ZIGZAG, PATTERN_RANDOM, PATTERNS };
+static const char *PATTERN_NAMES[PATTERNS] = { "still", "circle", "zigzag", "random" };
+
+typedef struct {
+    int fd;
+    NetPeer *peer;              // NULL: legacy
+    int spectator;
+    int gone;
+    Player players[MAX_PLAYERS];
+    Obstacle obs[MAX_OBSTACLES];
+    Target tar[MAX_TARGETS];
+    // Pattern
+    unsigned int seed;          // rand_r state
+    double phase;
+    Vec2 dir;                   // Random pattern: current direction
+    double next_turn;
+    Vec2 pos;                   // Legacy: our position
+    double moved_at;
+    // Inputs
+    unsigned int seq;           // Last input made (0 = none)
+    unsigned int acked;
+    double sent_at[LOAD_HISTORY];   // By seq (0 = dropped or acknowledged)
+    InputCmd held[LOAD_QUEUE];      // --delay
+    double release[LOAD_QUEUE];
+    int held_head, held_count;
+    // Counters
+    unsigned long snapshots;
+    double last_snapshot;
+    LinkStats stats;
+} LoadClient;
+
+// Samples for the percentiles (s)
+typedef struct {
+    double *v;
+    long n, cap;
+} Samples;
+
+static const char *opt_ip = "127.0.0.1";
+static int opt_port = SERVER_PORT;
+static int opt_clients = 1, opt_spectators = 0;
+static int opt_proto = NET_PROTO_WORLD;
+static int opt_pattern = PATTERN_CIRCLE;
+static double opt_duration = 10.0;
+static double opt_rate = 50.0;              // Inputs per second per player
+static float opt_force = 3.0f * F_STEP;
+static double opt_delay = 0.0;              // s
+static double opt_loss = 0.0;               // Share of the inputs dropped (0-1)
+
+static LoadClient clients[LOAD_MAX];
+static int n_clients = 0;
+static Samples latency, gaps;
+static unsigned long inputs_made = 0, inputs_dropped = 0;
+
+static void sample_add(Samples *s, double v) {
+    if (s->n == s->cap) {
+        long cap = s->cap ? s->cap * 2 : 1024;
+        double *v2 = realloc(s->v, cap * sizeof(double));
+        if (!v2) return;
+        s->v = v2;
+        s->cap = cap;
+    }
+    s->v[s->n++] = v;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_samples(const char *name, Samples *s) {
+    if (s->n == 0) { printf("%-28s %8s\n", name, "-"); return; }
+    qsort(s->v, s->n, sizeof(double), cmp_double);
+    printf("%-28s %8.1f %8.1f %8.1f %8.1f   (%ld samples)\n", name,
+           s->v[(long)(0.50 * (s->n - 1))] * 1000.0, s->v[(long)(0.90 * (s->n - 1))] * 1000.0,
+           s->v[(long)(0.99 * (s->n - 1))] * 1000.0, s->v[s->n - 1] * 1000.0, s->n);
+}
+
+// Direction of the pattern at time t (length 1, or 0 for 'still')
+static Vec2 pattern_dir(LoadClient *c, double t) {
+    Vec2 d = { 0.0f, 0.0f };
+    switch (opt_pattern) {
+        case PATTERN_CIRCLE:
+            d.x = (float)cos(2.0 * M_PI * t / 4.0 + c->phase);
+            d.y = (float)sin(2.0 * M_PI * t / 4.0 + c->phase);
+            break;
+        case PATTERN_ZIGZAG:
+            d.x = ((long)(t / 2.0 + c->phase) % 2) ? 1.0f : -1.0f;
+            break;
+        case PATTERN_RANDOM:
+            if (t >= c->next_turn) {
+                double a = 2.0 * M_PI * rand_r(&c->seed) / ((double)RAND_MAX + 1.0);
+                c->dir.x = (float)cos(a);
+                c->dir.y = (float)sin(a);
+                c->next_turn = t + LOAD_TURN;
+            }
+            d = c->dir;
+            break;
+    }
+    return d;
+}
+
+// Connects and negotiates one client. -1 if the server did not take it.
+static int connect_client(LoadClient *c, int index, int spectator) {
+    memset(c, 0, sizeof(LoadClient));
+    c->spectator = spectator;
+    c->seed = 1234u + index;
+    c->phase = 2.0 * M_PI * index / (opt_clients > 0 ? opt_clients : 1);
+    c->pos.x = MAP_WIDTH / 2.0f;
+    c->pos.y = MAP_HEIGHT / 2.0f;
+    for (int i = 0; i < MAX_PLAYERS; i++) c->players[i].id = -1;
+    for (int i = 0; i < MAX_OBSTACLES; i++) c->obs[i].id = -1;
+    for (int i = 0; i < MAX_TARGETS; i++) c->tar[i].id = -1;
+
+    int port = opt_port;
+    c->fd = init_network(MODE_CLIENT, &port, opt_ip);
+    if (c->fd < 0) {
+        fprintf(stderr, "netload: client %d: cannot connect to %s:%d\n", index, opt_ip, opt_port);
+        return -1;
+    }
+    // The handshake is blocking: a server that never answers must not hang us
+    struct timeval tv = { LOAD_HANDSHAKE_TIMEOUT, 0 };
+    setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int wanted = spectator ? NET_PROTO_SPECTATE : opt_proto;
+    const char *caps = spectator ? "spectate" : (opt_proto == NET_PROTO_WORLD ? "world" : NULL);
+    int proto = sync_handshake(MODE_CLIENT, c->fd, caps);
+    if (proto != wanted) {
+        fprintf(stderr, "netload: client %d: %s\n", index,
+                proto < 0 ? "handshake failed" : "the server does not offer this protocol (check its NET_SYNC)");
+        close(c->fd);
+        return -1;
+    }
+    if (proto != NET_PROTO_LEGACY && !(c->peer = net_world_open(c->fd, MODE_CLIENT))) {
+        close(c->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static void send_input(LoadClient *c, const InputCmd *in) {
+    if (net_world_send_input(c->peer, in) < 0) c->gone = 1;
+}
+
+// World sync / spectator: snapshots in, inputs out (when due)
+static void world_step(LoadClient *c, double now, double t, int input_due) {
+    WorldChanges changed;
+    int rc = net_world_recv_snapshot(c->peer, now, c->players, c->obs, c->tar, &changed);
+    if (rc < 0) { c->gone = 1; return; }
+    if (rc > 0) {
+        if (c->last_snapshot > 0) sample_add(&gaps, now - c->last_snapshot);
+        c->last_snapshot = now;
+        c->snapshots += rc;
+        // Inputs the server simulated since the previous snapshot
+        DroneState state;
+        unsigned int ack = c->spectator ? 0 : net_world_input_ack(c->peer, &state);
+        if (ack && (int)(ack - c->acked) > LOAD_HISTORY) c->acked = ack - LOAD_HISTORY;
+        while (ack && (int)(ack - c->acked) > 0) {
+            double *sent = &c->sent_at[++c->acked % LOAD_HISTORY];
+            if (*sent > 0) sample_add(&latency, now - *sent);
+            *sent = 0;
+        }
+    }
+    if (c->spectator) return;
+
+    // 1. A new input (only once the server gave us a slot and its clock)
+    if (input_due && net_world_player(c->peer) >= 0) {
+        double period = 1.0 / opt_rate;
+        float dt = DYNAMICS_RATE / 1000000.0f;
+        Vec2 d = pattern_dir(c, t);
+        InputCmd in;
+        memset(&in, 0, sizeof(in));
+        if (++c->seq == 0) c->seq = 1;     // 0 means "none"
+        in.seq = c->seq;
+        in.force.x = d.x * opt_force;
+        in.force.y = d.y * opt_force;
+        in.dt = dt;
+        in.steps = (int)lround(period / dt);
+        in.t0 = now - period;
+        c->sent_at[in.seq % LOAD_HISTORY] = now;
+        inputs_made++;
+        if (opt_loss > 0 && rand_r(&c->seed) < opt_loss * RAND_MAX) {
+            c->sent_at[in.seq % LOAD_HISTORY] = 0;
+            inputs_dropped++;
+        }
+        else if (opt_delay > 0 && c->held_count == LOAD_QUEUE) {
+            // [FIX] Queue full (rate x delay is checked at startup, a late
+            // loop may still catch up): a loss, never an early send that
+            // would overtake the inputs still held
+            c->sent_at[in.seq % LOAD_HISTORY] = 0;
+            inputs_dropped++;
+        }
+        else if (opt_delay > 0) {
+            int k = (c->held_head + c->held_count++) % LOAD_QUEUE;
+            c->held[k] = in;
+            c->release[k] = now + opt_delay;
+        }
+        else send_input(c, &in);
+    }
+
+    // 2. The delayed inputs now due
+    while (c->held_count > 0 && c->release[c->held_head] <= now && !c->gone) {
+        send_input(c, &c->held[c->held_head]);
+        c->held_head = (c->held_head + 1) % LOAD_QUEUE;
+        c->held_count--;
+    }
+}
+
+// Legacy: answers one line of the server's exchange with our position
+static void legacy_step(LoadClient *c, double now, double t) {
+    Vec2 d = pattern_dir(c, t);
+    float step = LOAD_SPEED * (float)(c->moved_at > 0 ? now - c->moved_at : 0.0);
+    c->moved_at = now;
+    c->pos.x = fminf(fmaxf(c->pos.x + d.x * step, 1.0f), MAP_WIDTH - 1.0f);
+    c->pos.y = fminf(fmaxf(c->pos.y + d.y * step, 1.0f), MAP_HEIGHT - 1.0f);
+
+    if (opt_delay > 0) usleep((useconds_t)(opt_delay * 1e6));   // Our answer is late
+    DroneState me;
+    memset(&me, 0, sizeof(me));
+    me.position = c->pos;
+    Obstacle opponent;
+    if (network_exchange(MODE_CLIENT, c->fd, &me, &opponent) < 0) { c->gone = 1; return; }
+    double rtt = network_last_rtt();
+    if (rtt > 0) {
+        // One sample per exchange cycle (position -> "pok")
+        sample_add(&latency, rtt);
+        double now2 = get_time_sec();
+        if (c->last_snapshot > 0) sample_add(&gaps, now2 - c->last_snapshot);
+        c->last_snapshot = now2;
+        c->snapshots++;
+    }
+}
+
+static void read_stats(LoadClient *c) {
+    if (c->peer) net_world_link_stats(c->peer, &c->stats);
+    else network_link_stats(c->fd, &c->stats);
+}
+
+static void print_role(const char *role, int spectator, double elapsed) {
+    int count = 0, gone = 0;
+    double snaps = 0, in = 0, out = 0, rtt = 0;
+    unsigned int lost = 0, retrans = 0;
+    for (int i = 0; i < n_clients; i++) {
+        LoadClient *c = &clients[i];
+        if (c->spectator != spectator) continue;
+        count++;
+        snaps += c->snapshots / elapsed;
+        if (c->gone) { gone++; continue; }
+        in += c->stats.bytes_in;
+        out += c->stats.bytes_out;
+        rtt += c->stats.rtt_ms;
+        lost += c->stats.lost;
+        retrans += c->stats.retrans;
+    }
+    if (count == 0) return;
+    int alive = count - gone;
+    printf("%-11s %7d %5d %13.1f %10.2f %10.2f %8.1f %8u %8u\n", role, count, gone, snaps,
+           in / 1024.0, out / 1024.0, alive ? rtt / alive : 0.0, lost, retrans);
+}
+
+static void usage(const char *prog) {
+    printf("Usage: %s [--ip ADDR] [--port N] [--clients N] [--spectators N] [--proto world|legacy]\n"
+           "       [--pattern still|circle|zigzag|random] [--duration SEC] [--rate HZ] [--force N]\n"
+           "       [--delay MS] [--loss PCT]\n", prog);
+    printf("  --clients     Player connections (default 1; legacy: 1)\n");
+    printf("  --spectators  Read-only connections (world sync server, NET_ROLE spectator)\n");
+    printf("  --proto       Protocol the players ask for (default world)\n");
+    printf("  --pattern     Movement replayed by every player (default circle)\n");
+    printf("  --rate        Inputs per second per player (default 50)\n");
+    printf("  --force       Command force of the pattern (default %.1f N)\n", 3.0f * F_STEP);
+    printf("  --delay       Holds every outgoing input (legacy: answer) this long\n");
+    printf("  --loss        Drops this share of the inputs (world sync)\n");
+}
+
+int main(int argc, char *argv[]) {
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    static const struct option options[] = {
+        { "ip",         required_argument, NULL, 'i' },
+        { "port",       required_argument, NULL, 'p' },
+        { "clients",    required_argument, NULL, 'n' },
+        { "spectators", required_argument, NULL, 's' },
+        { "proto",      required_argument, NULL, 'P' },
+        { "pattern",    required_argument, NULL, 'm' },
+        { "duration",   required_argument, NULL, 'd' },
+        { "rate",       required_argument, NULL, 'r' },
+        { "force",      required_argument, NULL, 'f' },
+        { "delay",      required_argument, NULL, 'D' },
+        { "loss",       required_argument, NULL, 'l' },
+        { "help",       no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "i:p:n:s:P:m:d:r:f:D:l:h", options, NULL)) != -1) {
+        switch (opt) {
+            case 'i': opt_ip = optarg; break;
+            case 'p': opt_port = atoi(optarg); break;
+            case 'n': opt_clients = atoi(optarg); break;
+            case 's': opt_spectators = atoi(optarg); break;
+            case 'P':
+                if (strcmp(optarg, "world") == 0) opt_proto = NET_PROTO_WORLD;
+                else if (strcmp(optarg, "legacy") == 0) opt_proto = NET_PROTO_LEGACY;
+                else { usage(argv[0]); return 1; }
+                break;
+            case 'm':
+                opt_pattern = -1;
+                for (int i = 0; i < PATTERNS; i++) if (strcmp(optarg, PATTERN_NAMES[i]) == 0) opt_pattern = i;
+                if (opt_pattern < 0) { usage(argv[0]); return 1; }
+                break;
+            case 'd': opt_duration = atof(optarg); break;
+            case 'r': opt_rate = atof(optarg); break;
+            case 'f': opt_force = (float)atof(optarg); break;
+            case 'D': opt_delay = atof(optarg) / 1000.0; break;
+            case 'l': opt_loss = atof(optarg) / 100.0; break;
+            default: usage(argv[0]); return (opt == 'h') ? 0 : 1;
+        }
+    }
+    if (opt_proto == NET_PROTO_LEGACY && (opt_clients != 1 || opt_spectators > 0)) {
+        fprintf(stderr, "netload: the legacy server serves one client and no spectators\n");
+        return 1;
+    }
+    if (opt_clients < 0 || opt_spectators < 0 || opt_clients + opt_spectators > LOAD_MAX ||
+        opt_clients + opt_spectators == 0 || opt_rate <= 0 || opt_duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    // Every input sent during --delay is held at once (one spare slot)
+    if (opt_proto == NET_PROTO_WORLD && opt_rate * opt_delay > LOAD_QUEUE - 1) {
+        fprintf(stderr, "netload: --rate x --delay holds %.0f inputs, at most %d (lower one of them)\n",
+                ceil(opt_rate * opt_delay), LOAD_QUEUE - 1);
+        return 1;
+    }
+
+    // 1. Connections (one after the other: the server runs each handshake)
+    for (int i = 0; i < opt_clients + opt_spectators; i++) {
+        if (connect_client(&clients[n_clients], i, i >= opt_clients) == 0) n_clients++;
+    }
+    if (n_clients == 0) return 1;
+    printf("netload: %d players, %d spectators on %s:%d (%s, %s pattern, %.0f s, delay %.0f ms, loss %.0f%%)\n",
+           opt_clients, opt_spectators, opt_ip, opt_port, opt_proto == NET_PROTO_WORLD ? "world sync" : "legacy",
+           PATTERN_NAMES[opt_pattern], opt_duration, opt_delay * 1000.0, opt_loss * 100.0);
+    for (int i = 0; i < n_clients; i++) read_stats(&clients[i]);   // Rates from now on
+
+    // 2. Load: every connection polled, the inputs at the input rate
+    struct pollfd pfd[LOAD_MAX];
+    double start = get_time_sec(), now = start;
+    double next_input = start;
+    int alive = n_clients;
+    while (alive > 0 && (now = get_time_sec()) < start + opt_duration) {
+        int wait_ms = (int)((next_input - now) * 1000.0);
+        if (wait_ms < 0) wait_ms = 0;
+        if (wait_ms > 10) wait_ms = 10;
+        for (int i = 0; i < n_clients; i++) {
+            pfd[i].fd = clients[i].gone ? -1 : clients[i].fd;
+            pfd[i].events = POLLIN;
+            pfd[i].revents = 0;
+        }
+        poll(pfd, n_clients, wait_ms);
+
+        now = get_time_sec();
+        int input_due = (now >= next_input);
+        if (input_due) next_input = (now - next_input > 1.0 / opt_rate) ? now + 1.0 / opt_rate : next_input + 1.0 / opt_rate;
+        alive = 0;
+        for (int i = 0; i < n_clients; i++) {
+            LoadClient *c = &clients[i];
+            if (c->gone) continue;
+            if (c->peer) world_step(c, now, now - start, input_due);
+            else if (pfd[i].revents) legacy_step(c, now, now - start);
+            if (!c->gone) alive++;
+        }
+    }
+    double elapsed = now - start;
+
+    // 3. Report
+    for (int i = 0; i < n_clients; i++) {
+        LoadClient *c = &clients[i];
+        if (!c->gone) read_stats(c);
+        if (c->peer) net_world_close(c->peer);
+        close(c->fd);
+    }
+    printf("\n%-11s %7s %5s %13s %10s %10s %8s %8s %8s\n", "role", "clients", "gone", "snapshots/s",
+           "kB/s in", "kB/s out", "RTT ms", "lost", "retrans");
+    print_role("players", 0, elapsed);
+    print_role("spectators", 1, elapsed);
+    if (opt_proto == NET_PROTO_WORLD) {
+        printf("inputs: %.0f/s made, %lu dropped (--loss, full --delay queue)\n", inputs_made / elapsed, inputs_dropped);
+    }
+    printf("\n%-28s %8s %8s %8s %8s\n", "ms", "p50", "p90", "p99", "max");
+    print_samples(opt_proto == NET_PROTO_WORLD ? "input -> ack" : "position -> pok", &latency);
+    print_samples(opt_proto == NET_PROTO_WORLD ? "snapshot interval" : "exchange interval", &gaps);
+    free(latency.v);
+    free(gaps.v);
+    return 0;
+}
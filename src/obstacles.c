@@ -1,59 +1,102 @@
 #include "common.h"
+#include "channel.h"
+#include "ready.h"
+#include "params.h"
+#include "motion.h"
 #include <time.h>
 
+#define OBSTACLE_REFRESH 4.0  // Seconds between two changes of the field
+
+// New random model for obstacle 'o' (keeps its id and anchor)
+static void pick_motion(Obstacle *o, int type, float speed, float radius, double now) {
+    memset(&o->motion, 0, sizeof(Motion));
+    if (type == MOTION_STATIC) return;
+    o->motion.type = type;
+    o->motion.seed = (unsigned int)rand();
+    o->motion.speed = speed * (0.5f + (rand() % 100) / 100.0f); // 0.5x .. 1.5x
+    o->motion.radius = radius;
+    o->motion.t0 = now;
+}
+
+static int motion_for(int id, int mode) {
+    if (mode >= 0) return mode;
+    return MOTION_LINEAR + id % 3; // "mixed": linear, circular, waypoint in turn
+}
+
 // This function matches the Assignment 2 behavior:
 // 30 Obstacles that stay mostly still, but occasionally refresh.
+// With OBSTACLE_MOTION linear/circular/waypoint/mixed they move instead:
+// only the model is sent, each reader computes the positions itself.
 void run_obstacles() {
     register_process("Obstacles");
     log_message(SYSTEM_LOG_FILE, "Obstacles", "Generator started (Assignment 2 Mode).");
 
-    int fd;
     // Wait for Blackboard pipe
-    while ((fd = open(PIPE_OBS_TO_SERVER, O_WRONLY)) < 0) {
-        usleep(100000); 
-    }
+    Channel *ch = chan_open(PIPE_OBS_TO_SERVER, CHAN_WRITE);
 
-    srand(time(NULL) + getpid());
+    // Same OBSTACLE_SEED = same field and same paths (0 = random)
+    char motion_param[PARAM_VAL_LEN];
+    param_get_str("OBSTACLE_MOTION", "static", motion_param, sizeof(motion_param));
+    int mode = motion_from_name(motion_param);
+    if (strcmp(motion_param, "mixed") == 0) mode = -1;
+    else if (mode < 0) mode = MOTION_STATIC;
+    float speed = param_get_float("OBSTACLE_SPEED", 2.0f);
+    float radius = param_get_float("OBSTACLE_RADIUS", 6.0f);
+    unsigned int seed = (unsigned int)param_get_int("OBSTACLE_SEED", 0);
+    srand(seed ? seed : (unsigned int)(time(NULL) + getpid()));
 
     Obstacle obstacles[MAX_OBSTACLES];
     Message msg;
+    memset(&msg, 0, sizeof(Message));
     msg.type = MSG_OBSTACLE;
     msg.sender_pid = getpid();
 
     // 1. INITIALIZATION: Fill the map with 30 obstacles
     // This makes sure Repulsion works immediately.
+    double now = get_time_sec();
     for (int i = 0; i < MAX_OBSTACLES; i++) {
         obstacles[i].id = i; // Assign IDs 0 to 29
         obstacles[i].position.x = 5 + rand() % (MAP_WIDTH - 10);
         obstacles[i].position.y = 5 + rand() % (MAP_HEIGHT - 10);
-        
-        msg.obstacle = obstacles[i];
-        write(fd, &msg, sizeof(Message));
-        
-        // Tiny sleep to ensure Blackboard reads them all safely
-        usleep(2000); 
+        pick_motion(&obstacles[i], motion_for(i, mode), speed, radius, now);
+    }
+    // The whole field in one batch write: no pacing needed
+    if (chan_send_batch(ch, &msg, obstacles, MAX_OBSTACLES) < 0) {
+        log_message(SYSTEM_LOG_FILE, "Obstacles", "Initial batch failed: %s", strerror(errno));
     }
 
-    log_message(SYSTEM_LOG_FILE, "Obstacles", "Initialized %d obstacles.", MAX_OBSTACLES);
+    log_message(SYSTEM_LOG_FILE, "Obstacles", "Initialized %d obstacles (motion: %s, seed %u).",
+                MAX_OBSTACLES, motion_param, seed);
+    ready_signal(READY_OBSTACLES);
 
     // 2. MAIN LOOP: Slow Refresh
+    // In Assignment 2, obstacles shouldn't flicker like a disco light.
+    double next_refresh = now + OBSTACLE_REFRESH;
     while (1) {
-        // Sleep for 4 seconds (Adjust this if you want faster/slower updates)
-        // In Assignment 2, obstacles shouldn't flicker like a disco light.
-        sleep(4); 
+        usleep(GENERATOR_RATE);
+        now = get_time_sec();
+        if (now < next_refresh) continue;
+        next_refresh += OBSTACLE_REFRESH;
 
-        // Pick ONE random obstacle ID (0-29) to move
+        // Pick ONE random obstacle ID (0-29) to change
         int id = rand() % MAX_OBSTACLES;
 
-        obstacles[id].position.x = 5 + rand() % (MAP_WIDTH - 10);
-        obstacles[id].position.y = 5 + rand() % (MAP_HEIGHT - 10);
+        if (obstacles[id].motion.type == MOTION_STATIC) {
+            // Teleport
+            obstacles[id].position.x = 5 + rand() % (MAP_WIDTH - 10);
+            obstacles[id].position.y = 5 + rand() % (MAP_HEIGHT - 10);
+        } else {
+            // New path starting where the obstacle is now (no jump)
+            obstacles[id].position = motion_position(&obstacles[id], now);
+            pick_motion(&obstacles[id], obstacles[id].motion.type, speed, radius, now);
+        }
 
         msg.obstacle = obstacles[id];
-        write(fd, &msg, sizeof(Message));
+        chan_send(ch, &msg);
         
         // Log it (Optional debug)
         // log_message(SYSTEM_LOG_FILE, "Obstacles", "Moved obstacle %d", id);
     }
 
-    close(fd);
-}
\ No newline at end of file
+    chan_close(ch);
+}
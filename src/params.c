@@ -1,40 +1,260 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <pthread.h>
 #include "params.h"
 
-float load_param(const char *filename, const char *key) {
+// Hash table (open addressing, linear probing)
+#define PARAM_SLOTS    64   // Must be a power of 2
+
+typedef struct {
+    int used;
+    char key[PARAM_KEY_LEN];
+    char value[PARAM_VAL_LEN];
+} ParamEntry;
+
+static ParamEntry table[PARAM_SLOTS];
+static int loaded = 0;
+static char watched_name[64];
+
+// In threads mode the store is shared by the components: the lock keeps
+// a reload from racing with the lookups of another thread, and values
+// leave the store only as copies made under it.
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// FNV-1a string hash
+static unsigned int hash_key(const char *key) {
+    unsigned int h = 2166136261u;
+    while (*key) { h ^= (unsigned char)*key++; h *= 16777619u; }
+    return h;
+}
+
+// Returns the slot of table 't' holding 'key', or the empty slot where it would go
+static ParamEntry *find_slot(ParamEntry *t, const char *key) {
+    unsigned int i = hash_key(key) & (PARAM_SLOTS - 1);
+    for (int n = 0; n < PARAM_SLOTS; n++) {
+        ParamEntry *e = &t[i];
+        if (!e->used || strcmp(e->key, key) == 0) return e;
+        i = (i + 1) & (PARAM_SLOTS - 1);
+    }
+    return NULL; // Table full
+}
+
+static int set_in(ParamEntry *t, const char *key, const char *value) {
+    ParamEntry *e = find_slot(t, key);
+    if (!e) {
+        printf("[Params] Warning: store full, '%s' ignored\n", key);
+        return 0;
+    }
+    if (e->used && strcmp(e->value, value) == 0) return 0;
+    e->used = 1;
+    snprintf(e->key, PARAM_KEY_LEN, "%s", key);
+    snprintf(e->value, PARAM_VAL_LEN, "%s", value);
+    return 1;
+}
+
+int param_set(const char *key, const char *value) {
+    pthread_mutex_lock(&table_lock);
+    int changed = set_in(table, key, value);
+    pthread_mutex_unlock(&table_lock);
+    return changed;
+}
+
+int param_remove(const char *key) {
+    pthread_mutex_lock(&table_lock);
+    ParamEntry *e = find_slot(table, key);
+    int removed = (e && e->used);
+    if (removed) {
+        // Linear probing: the keys after it are inserted again
+        // (a hole would hide the ones that probed past it)
+        ParamEntry old[PARAM_SLOTS];
+        e->used = 0;
+        memcpy(old, table, sizeof(old));
+        memset(table, 0, sizeof(table));
+        for (int i = 0; i < PARAM_SLOTS; i++) {
+            if (old[i].used) set_in(table, old[i].key, old[i].value);
+        }
+    }
+    pthread_mutex_unlock(&table_lock);
+    return removed;
+}
+
+// Parses the file into 't' (a private table, no lock needed).
+// Returns the number of keys, -1 if the file cannot be opened.
+static int parse_file(ParamEntry *t, const char *filename) {
     FILE *f = fopen(filename, "r");
-    if (!f) {
-        // If file not found, return a safe default 
-        // Or print error. Let's print error and return default 1.0
+    if (!f) return -1;
+
+    char line[512];
+    char read_key[256];
+    char read_val[256];
+    memset(t, 0, PARAM_SLOTS * sizeof(ParamEntry));
+
+    while (fgets(line, sizeof(line), f)) {
+        // Parse "KEY VALUE" (lines starting with # are comments)
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%255s %255s", read_key, read_val) != 2) continue;
+        if (strlen(read_key) >= PARAM_KEY_LEN || strlen(read_val) >= PARAM_VAL_LEN) {
+            printf("[Params] Warning: '%.31s' ignored, key or value too long (max %d / %d characters)\n",
+                   read_key, PARAM_KEY_LEN - 1, PARAM_VAL_LEN - 1);
+            continue;
+        }
+        set_in(t, read_key, read_val);
+    }
+    fclose(f);
+    int count = 0;
+    for (int i = 0; i < PARAM_SLOTS; i++) count += t[i].used;
+    return count;
+}
+
+int params_load(const char *filename) {
+    ParamEntry fresh[PARAM_SLOTS];
+    int count = parse_file(fresh, filename);
+    if (count < 0) {
         perror("Error opening params file");
-        return 1.0f; 
+        return -1;
     }
+    pthread_mutex_lock(&table_lock);
+    memcpy(table, fresh, sizeof(table));
+    pthread_mutex_unlock(&table_lock);
+    loaded = 1;
+    return count;
+}
+
+// Value of 'key' or NULL (table_lock held)
+static const char *lookup_locked(const char *key) {
+    ParamEntry *e = find_slot(table, key);
+    return (e && e->used) ? e->value : NULL;
+}
+
+const char *param_get_str(const char *key, const char *def, char *out, size_t size) {
+    pthread_mutex_lock(&table_lock);
+    const char *v = lookup_locked(key);
+    snprintf(out, size, "%s", v ? v : (def ? def : ""));
+    pthread_mutex_unlock(&table_lock);
+    return out;
+}
 
-    char line[128];
-    char read_key[64];
-    float read_val;
-    float result = -1.0f; // Default error value
+float param_get_float(const char *key, float def) {
+    pthread_mutex_lock(&table_lock);
+    const char *v = lookup_locked(key);
+    float f = v ? (float)atof(v) : def;
+    pthread_mutex_unlock(&table_lock);
+    return f;
+}
+
+int param_get_int(const char *key, int def) {
+    pthread_mutex_lock(&table_lock);
+    const char *v = lookup_locked(key);
+    int n = v ? atoi(v) : def;
+    pthread_mutex_unlock(&table_lock);
+    return n;
+}
+
+int param_next(int *iter, char *key, char *value) {
     int found = 0;
+    pthread_mutex_lock(&table_lock);
+    while (!found && *iter < PARAM_SLOTS) {
+        ParamEntry *e = &table[(*iter)++];
+        if (e->used) {
+            memcpy(key, e->key, PARAM_KEY_LEN);
+            memcpy(value, e->value, PARAM_VAL_LEN);
+            found = 1;
+        }
+    }
+    pthread_mutex_unlock(&table_lock);
+    return found;
+}
 
-    while (fgets(line, sizeof(line), f)) {
-        // Parse "KEY VALUE"
-        if (sscanf(line, "%s %f", read_key, &read_val) == 2) {
-            if (strcmp(read_key, key) == 0) {
-                result = read_val;
-                found = 1;
-                break;
-            }
+int params_loaded(void) {
+    return loaded;
+}
+
+// We watch the directory, not the file: editors usually save by
+// writing a new file and renaming it over the old one. Only complete
+// files count (no IN_CREATE: a new file is still empty then).
+int params_watch(const char *filename) {
+    char dir[128];
+    snprintf(dir, sizeof(dir), "%s", filename);
+    char *slash = strrchr(dir, '/');
+    if (slash) {
+        snprintf(watched_name, sizeof(watched_name), "%s", slash + 1);
+        *slash = '\0';
+    } else {
+        snprintf(watched_name, sizeof(watched_name), "%s", filename);
+        snprintf(dir, sizeof(dir), ".");
+    }
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        perror("[Params] inotify_init1");
+        return -1;
+    }
+    if (inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        perror("[Params] inotify_add_watch");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int params_poll(int watch_fd, const char *filename,
+                void (*on_change)(const char *key, const char *value)) {
+    if (watch_fd < 0) return 0;
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int touched = 0;
+    ssize_t len;
+    while ((len = read(watch_fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + len; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            if (ev->len > 0 && strcmp(ev->name, watched_name) == 0) touched = 1;
+            p += sizeof(struct inotify_event) + ev->len;
         }
     }
+    if (!touched) return 0;
 
-    fclose(f);
-    
-    if (!found) {
-        printf("[Params] Warning: Key '%s' not found in %s. Using default 1.0\n", key, filename);
-        return 1.0f;
-    }
-    
-    return result;
-}
\ No newline at end of file
+    // The store is rebuilt from the file, so a deleted line removes its
+    // key (values set with param_set() since then are replaced too).
+    // A file missing or empty mid-save keeps the current store.
+    ParamEntry fresh[PARAM_SLOTS];
+    if (parse_file(fresh, filename) <= 0) return 0;
+
+    // Differences: new or changed values, then removed keys (used = 0)
+    ParamEntry diff[2 * PARAM_SLOTS];
+    int changes = 0;
+    pthread_mutex_lock(&table_lock);
+    for (int i = 0; i < PARAM_SLOTS; i++) {
+        if (!fresh[i].used) continue;
+        ParamEntry *e = find_slot(table, fresh[i].key);
+        if (!e || !e->used || strcmp(e->value, fresh[i].value) != 0) diff[changes++] = fresh[i];
+    }
+    for (int i = 0; i < PARAM_SLOTS; i++) {
+        if (!table[i].used) continue;
+        ParamEntry *e = find_slot(fresh, table[i].key);
+        if (!e || !e->used) {
+            diff[changes] = table[i];
+            diff[changes++].used = 0;
+        }
+    }
+    memcpy(table, fresh, sizeof(table));
+    pthread_mutex_unlock(&table_lock);
+
+    if (on_change) {
+        for (int i = 0; i < changes; i++) on_change(diff[i].key, diff[i].used ? diff[i].value : NULL);
+    }
+    return changes;
+}
+
+float load_param(const char *filename, const char *key) {
+    if (!loaded && params_load(filename) < 0) return 1.0f;
+
+    pthread_mutex_lock(&table_lock);
+    const char *v = lookup_locked(key);
+    float f = v ? (float)atof(v) : 1.0f;
+    pthread_mutex_unlock(&table_lock);
+    if (!v) printf("[Params] Warning: Key '%s' not found in %s. Using default 1.0\n", key, filename);
+    return f;
+}
@@ -1,7 +1,57 @@
 #ifndef PARAMS_H
 #define PARAMS_H
 
-// Function to load parameter values by name from a given file
+#include <stddef.h>
+
+#define PARAMS_FILE "config/params.txt"
+
+// Longest key and value (with the terminator). Values may be socket or
+// file paths: room for a whole sun_path (108). Longer ones are ignored
+// with a warning, never cut.
+#define PARAM_KEY_LEN  32
+#define PARAM_VAL_LEN  128
+
+// PARAMETER STORE
+// config/params.txt ("KEY VALUE" per line) is parsed once into a hash
+// table; the getters below never touch the file again.
+// In threads mode Main loads it before starting the component threads,
+// which share the store: the getters only hand out copies.
+
+// Parses the file into the store. Returns the number of keys, -1 if missing.
+// Not to be called while other threads use the store.
+int params_load(const char *filename);
+
+// 1 once params_load() succeeded in this process
+int params_loaded(void);
+
+// Copies the value of 'key' ('def' if missing) into out[size], returns out
+const char *param_get_str(const char *key, const char *def, char *out, size_t size);
+
+// Typed getters: return 'def' if the key is not in the store
+float param_get_float(const char *key, float def);
+int param_get_int(const char *key, int def);
+
+// Sets a value in the store. Returns 1 if it changed, 0 if not.
+int param_set(const char *key, const char *value);
+
+// Removes a key (the getters fall back to their default). Returns 1 if it was there.
+int param_remove(const char *key);
+
+// Iterates over the store: start with *iter = 0, returns 0 at the end.
+// Copies each entry into key[PARAM_KEY_LEN] and value[PARAM_VAL_LEN].
+int param_next(int *iter, char *key, char *value);
+
+// HOT RELOAD (inotify)
+// Returns a non-blocking fd that becomes readable when the file changes
+int params_watch(const char *filename);
+
+// Drains the watch fd; if the file changed, rebuilds the store from it and
+// calls on_change() for every key whose value is new, with value NULL for
+// a key no longer in the file. Returns the number of changes.
+int params_poll(int watch_fd, const char *filename,
+                void (*on_change)(const char *key, const char *value));
+
+// Legacy helper: value of 'key' (1.0 if missing)
 float load_param(const char *filename, const char *key);
 
-#endif
\ No newline at end of file
+#endif
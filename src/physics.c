@@ -0,0 +1,94 @@
+#include <math.h>
+#include "physics.h"
+#include "params.h"
+#include "motion.h"
+
+void physics_load(PhysicsParams *pp) {
+    pp->M = param_get_float("M", 1.0f);
+    pp->K = param_get_float("K", 1.0f);
+    if (pp->M <= 0.0f) pp->M = 1.0f; // Avoid division by zero
+    pp->rep_rho = param_get_float("REPULSION_RHO", REPULSION_RHO);
+    pp->rep_eta = param_get_float("REPULSION_ETA", REPULSION_ETA);
+    pp->att_rho = param_get_float("ATTRACTION_RHO", ATTRACTION_RHO);
+    pp->att_eta = param_get_float("ATTRACTION_ETA", ATTRACTION_ETA);
+    pp->obstacle_collision = param_get_int("OBSTACLE_COLLISION", 0);
+    pp->hit_radius = param_get_float("OBSTACLE_HIT_RADIUS", OBSTACLE_HIT_RADIUS);
+}
+
+// Algorithm 2 : Attraction field
+// Targets exert an attractive force pulling the drone towards them.
+Vec2 physics_attraction(const PhysicsParams *pp, Vec2 pos, const Target *t) {
+    Vec2 f_att = {0.0, 0.0};
+    if (!t || t->active != 1) return f_att;
+    float dx = t->position.x - pos.x;
+    float dy = t->position.y - pos.y;
+    float dist = sqrt(dx*dx + dy*dy);
+    if (dist < pp->att_rho) {
+        f_att.x = pp->att_eta * dx;
+        f_att.y = pp->att_eta * dy;
+    }
+    return f_att;
+}
+
+// Solves: F = ma + kv
+void physics_step(const PhysicsParams *pp, DroneState *d, Vec2 f_ext, float T) {
+    //1.calculate Acceleration
+    float total_fx = d->force.x + f_ext.x;
+    float total_fy = d->force.y + f_ext.y;
+    float ax = (total_fx - pp->K * d->velocity.x) / pp->M;
+    float ay = (total_fy - pp->K * d->velocity.y) / pp->M;
+    //Update velocity and position using Euler integration
+    d->velocity.x += ax * T;
+    d->velocity.y += ay * T;
+    d->position.x += d->velocity.x * T;
+    d->position.y += d->velocity.y * T;
+    //Boundary conditions
+    if (d->position.x <= 1) { d->position.x = 1; d->velocity.x = -RESTITUTION*d->velocity.x; }
+    if (d->position.x >= MAP_WIDTH-1) { d->position.x = MAP_WIDTH-1; d->velocity.x = -RESTITUTION*d->velocity.x; }
+    if (d->position.y <= 1) { d->position.y = 1; d->velocity.y = -RESTITUTION*d->velocity.y; }
+    if (d->position.y >= MAP_HEIGHT-1) { d->position.y = MAP_HEIGHT-1; d->velocity.y = -RESTITUTION*d->velocity.y; }
+}
+
+// The drone segment is tested in the frame of each obstacle, so fast
+// obstacles cannot tunnel through it either. The approaching part of the
+// velocity (relative to the obstacle) is reflected like on the walls.
+int physics_resolve_obstacles(const PhysicsParams *pp, DroneState *d, Vec2 prev,
+                              const Obstacle *obs, int count, double t_prev, double t_now) {
+    if (!pp->obstacle_collision) return 0;
+    float r = pp->hit_radius;
+    float t_hit = 2.0f;
+    Vec2 o0_hit = {0, 0}, o1_hit = {0, 0};
+
+    for (int i = 0; i < count; i++) {
+        if (obs[i].id == -1) continue;
+        Vec2 o0 = motion_position(&obs[i], t_prev);
+        Vec2 o1 = motion_position(&obs[i], t_now);
+        Vec2 p0 = { prev.x - o0.x, prev.y - o0.y };
+        Vec2 p1 = { d->position.x - o1.x, d->position.y - o1.y };
+        float t = motion_sweep(p0, p1, r);
+        if (t >= 0.0f && t < t_hit) { t_hit = t; o0_hit = o0; o1_hit = o1; }
+    }
+    if (t_hit > 1.0f) return 0;
+
+    // Contact normal, from the obstacle to the drone at the contact time
+    Vec2 o = { o0_hit.x + t_hit * (o1_hit.x - o0_hit.x), o0_hit.y + t_hit * (o1_hit.y - o0_hit.y) };
+    Vec2 n = { prev.x + t_hit * (d->position.x - prev.x) - o.x,
+               prev.y + t_hit * (d->position.y - prev.y) - o.y };
+    float len = sqrtf(n.x*n.x + n.y*n.y);
+    if (len < 1e-6f) { n.x = 1.0f; n.y = 0.0f; } else { n.x /= len; n.y /= len; }
+
+    // 1. Rest on the surface of the obstacle where it is now
+    d->position.x = o1_hit.x + n.x * (r + 1e-3f);
+    d->position.y = o1_hit.y + n.y * (r + 1e-3f);
+
+    // 2. Bounce: reflect the approaching part of the relative velocity
+    float dt = (float)(t_now - t_prev);
+    Vec2 vo = { 0, 0 };
+    if (dt > 0.0f) { vo.x = (o1_hit.x - o0_hit.x) / dt; vo.y = (o1_hit.y - o0_hit.y) / dt; }
+    float vn = (d->velocity.x - vo.x) * n.x + (d->velocity.y - vo.y) * n.y;
+    if (vn < 0.0f) {
+        d->velocity.x -= (1.0f + RESTITUTION) * vn * n.x;
+        d->velocity.y -= (1.0f + RESTITUTION) * vn * n.y;
+    }
+    return 1;
+}
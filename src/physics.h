@@ -0,0 +1,37 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include "common.h"
+
+// DRONE PHYSICS
+// One integration step of a drone, shared by Dynamics (our drone, and the
+// replay of its inputs after a server correction) and by the world sync
+// server (the drones of its clients). Same inputs + same step = same path.
+//   F = ma + kv, explicit Euler, walls bounce with RESTITUTION.
+// The caller computes the external forces (repulsion, attraction).
+
+typedef struct {
+    float M, K;                 // Mass, viscous friction
+    float rep_rho, rep_eta;     // Obstacle repulsion
+    float att_rho, att_eta;     // Target attraction
+    int obstacle_collision;     // 1 = obstacles are solid (OBSTACLE_COLLISION)
+    float hit_radius;           // OBSTACLE_HIT_RADIUS
+} PhysicsParams;
+
+// Reads the values from the param store (compile-time defaults if missing)
+void physics_load(PhysicsParams *pp);
+
+// Pull of target 't' (NULL or inactive: none) on a drone at 'pos'
+Vec2 physics_attraction(const PhysicsParams *pp, Vec2 pos, const Target *t);
+
+// Advances 'd' by T seconds under its command force plus 'f_ext'
+void physics_step(const PhysicsParams *pp, DroneState *d, Vec2 f_ext, float T);
+
+// Hard collision with the obstacles (if enabled): the drone moved from
+// 'prev' to d->position between t_prev and t_now. Each obstacle is swept
+// along its motion; on the first contact the drone stops on the surface
+// and bounces. Returns 1 on contact.
+int physics_resolve_obstacles(const PhysicsParams *pp, DroneState *d, Vec2 prev,
+                              const Obstacle *obs, int count, double t_prev, double t_now);
+
+#endif
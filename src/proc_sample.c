@@ -0,0 +1,115 @@
+#include "common.h"
+#include "proc_sample.h"
+
+#define PROC_BUF 4096   // status and sched are 1-3 KB
+
+static long clock_ticks = 0;
+
+// The whole file, re-generated by the kernel. -1 once the task is gone (ESRCH).
+static int read_at0(int fd, char *buf, size_t cap) {
+    if (fd < 0) return -1;
+    ssize_t n = pread(fd, buf, cap - 1, 0);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+    return (int)n;
+}
+
+// "key:   value" anywhere in a status/sched text (0 if missing)
+static unsigned long long field_value(const char *buf, const char *key, int *found) {
+    const char *p = buf;
+    size_t len = strlen(key);
+    while ((p = strstr(p, key)) != NULL) {
+        // Whole key at the start of a line
+        if ((p == buf || p[-1] == '\n') && (p[len] == ':' || p[len] == ' ' || p[len] == '\t')) {
+            p += len;
+            while (*p == ' ' || *p == '\t' || *p == ':') p++;
+            if (found) *found = 1;
+            return strtoull(p, NULL, 10);
+        }
+        p += len;
+    }
+    if (found) *found = 0;
+    return 0;
+}
+
+static int open_entry(int pid, int tid, const char *file) {
+    char path[64];
+    if (tid > 0) snprintf(path, sizeof(path), "/proc/%d/task/%d/%s", pid, tid, file);
+    else snprintf(path, sizeof(path), "/proc/%d/%s", pid, file);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+int proc_sample_open(ProcSample *ps, int pid, int tid) {
+    memset(ps, 0, sizeof(ProcSample));
+    if (!clock_ticks) clock_ticks = sysconf(_SC_CLK_TCK);
+    ps->pid = pid;
+    ps->tid = tid;
+    ps->fd_stat = open_entry(pid, tid, "stat");
+    ps->fd_status = open_entry(pid, tid, "status");
+    ps->fd_sched = open_entry(pid, tid, "sched");     // Missing without CONFIG_SCHED_DEBUG
+    if (ps->fd_stat < 0 || ps->fd_status < 0) {
+        proc_sample_close(ps);
+        return -1;
+    }
+    return 0;
+}
+
+int proc_sample_update(ProcSample *ps, double now) {
+    char buf[PROC_BUF];
+
+    // 1. stat: state and CPU time (fields 3, 14 and 15; the name in
+    // parentheses may contain spaces, so parse after the last ')')
+    if (read_at0(ps->fd_stat, buf, sizeof(buf)) < 0) return -1;
+    const char *p = strrchr(buf, ')');
+    char state;
+    unsigned long long utime, stime;
+    if (!p || sscanf(p + 1, " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &state, &utime, &stime) != 3) return -1;
+
+    // 2. status: memory and context switches
+    if (read_at0(ps->fd_status, buf, sizeof(buf)) < 0) return -1;
+    long rss_kb = (long)field_value(buf, "VmRSS", NULL);
+    unsigned long long vcsw = field_value(buf, "voluntary_ctxt_switches", NULL);
+    unsigned long long ivcsw = field_value(buf, "nonvoluntary_ctxt_switches", NULL);
+
+    // 3. sched: wakeups (only with schedstats; otherwise every voluntary
+    // switch is a sleep, and so one wakeup)
+    unsigned long long wakeups = vcsw;
+    int found = 0;
+    if (read_at0(ps->fd_sched, buf, sizeof(buf)) > 0) {
+        unsigned long long w = field_value(buf, "se.statistics.nr_wakeups", &found);
+        if (!found) w = field_value(buf, "stats.nr_wakeups", &found);
+        if (found) wakeups = w;
+    }
+    ps->has_wakeups = found;
+
+    // 4. Rates over the interval
+    unsigned long long cpu_ticks = utime + stime;
+    double dt = now - ps->t;
+    if (ps->t > 0 && dt > 0) {
+        ps->cpu_pct = (double)(cpu_ticks - ps->cpu_ticks) / clock_ticks / dt * 100.0;
+        ps->vcsw_rate = (vcsw - ps->vcsw) / dt;
+        ps->ivcsw_rate = (ivcsw - ps->ivcsw) / dt;
+        ps->wakeup_rate = (wakeups - ps->wakeups) / dt;
+        if (ps->trend_len == PROC_TREND) {
+            memmove(ps->trend, ps->trend + 1, (PROC_TREND - 1) * sizeof(float));
+            ps->trend_len--;
+        }
+        ps->trend[ps->trend_len++] = (float)ps->cpu_pct;
+        ps->valid = 1;
+    }
+    ps->t = now;
+    ps->cpu_ticks = cpu_ticks;
+    ps->vcsw = vcsw;
+    ps->ivcsw = ivcsw;
+    ps->wakeups = wakeups;
+    ps->rss_kb = rss_kb;
+    ps->state = state;
+    return 0;
+}
+
+void proc_sample_close(ProcSample *ps) {
+    if (ps->fd_stat >= 0) close(ps->fd_stat);
+    if (ps->fd_status >= 0) close(ps->fd_status);
+    if (ps->fd_sched >= 0) close(ps->fd_sched);
+    ps->fd_stat = ps->fd_status = ps->fd_sched = -1;
+}
@@ -0,0 +1,43 @@
+#ifndef PROC_SAMPLE_H
+#define PROC_SAMPLE_H
+
+// PROCESS SAMPLING (Watchdog)
+// Reads /proc/<pid>/task/<tid>/{stat,status,sched} of one component:
+// the thread itself, so the components of the threads mode get a row
+// each. The three files stay open and are re-read with pread() from
+// offset 0 (the kernel regenerates them on every read): a sample costs
+// three reads, not three open/close. Rates come from the difference of
+// the kernel's counters between two samples.
+
+#define PROC_TREND 8        // CPU samples kept for the trend column
+
+typedef struct {
+    int pid, tid;
+    int fd_stat, fd_status, fd_sched;
+    int has_wakeups;            // sched has se.statistics.nr_wakeups (schedstats on)
+
+    // Kernel counters at the last sample
+    double t;
+    unsigned long long cpu_ticks;       // utime + stime
+    unsigned long long vcsw, ivcsw;     // Voluntary / involuntary context switches
+    unsigned long long wakeups;         // nr_wakeups, or vcsw without schedstats
+    long rss_kb;
+    char state;                         // R, S, D, Z...
+
+    // Over the last interval (valid once two samples were taken)
+    int valid;
+    double cpu_pct;                     // Of one CPU
+    double vcsw_rate, ivcsw_rate, wakeup_rate;  // Per second
+    float trend[PROC_TREND];            // cpu_pct, oldest first
+    int trend_len;
+} ProcSample;
+
+// tid 0: the whole process (/proc/<pid>). -1 if /proc has no such task.
+int proc_sample_open(ProcSample *ps, int pid, int tid);
+
+// Takes a sample at 'now' (get_time_sec). -1 once the task is gone.
+int proc_sample_update(ProcSample *ps, double now);
+
+void proc_sample_close(ProcSample *ps);
+
+#endif
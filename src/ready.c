@@ -0,0 +1,79 @@
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <stdint.h>
+#include "common.h"
+#include "ready.h"
+
+// A failure is written as a huge count, so one read() tells both apart
+#define READY_FAILED 0x100000
+
+static int ready_fd[READY_COUNT] = { -1, -1, -1, -1, -1 };
+
+static const char *names[READY_COUNT] = {
+    "Blackboard", "Dynamics", "Obstacles", "Targets", "FirstFrame"
+};
+
+const char *ready_name(ReadySlot slot) {
+    return (slot >= 0 && slot < READY_COUNT) ? names[slot] : "?";
+}
+
+int ready_init(void) {
+    for (int i = 0; i < READY_COUNT; i++) {
+        ready_fd[i] = eventfd(0, EFD_NONBLOCK);
+        if (ready_fd[i] < 0) {
+            perror("eventfd");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void ready_write(ReadySlot slot, uint64_t value) {
+    if (slot < 0 || slot >= READY_COUNT || ready_fd[slot] < 0) return;
+    if (write(ready_fd[slot], &value, sizeof(value)) != sizeof(value)) perror("ready write");
+}
+
+void ready_signal(ReadySlot slot) { ready_write(slot, 1); }
+void ready_fail(ReadySlot slot)   { ready_write(slot, READY_FAILED); }
+
+int ready_wait(const ReadySlot *slots, int n, double timeout, double t0, double *elapsed) {
+    struct pollfd pfd[READY_COUNT];
+    int done[READY_COUNT] = {0};
+    int remaining = n;
+    double deadline = get_time_sec() + timeout;
+
+    for (int i = 0; i < n; i++) elapsed[slots[i]] = -1.0;
+
+    while (remaining > 0) {
+        int np = 0, idx[READY_COUNT];
+        for (int i = 0; i < n; i++) {
+            if (done[i]) continue;
+            pfd[np].fd = ready_fd[slots[i]];
+            pfd[np].events = POLLIN;
+            idx[np++] = i;
+        }
+
+        int wait_ms = -1;
+        if (timeout >= 0) {
+            double left = deadline - get_time_sec();
+            if (left <= 0) return -1;
+            wait_ms = (int)(left * 1000) + 1;
+        }
+        int ready = poll(pfd, np, wait_ms);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        for (int k = 0; k < np; k++) {
+            if (!(pfd[k].revents & POLLIN)) continue;
+            uint64_t value;
+            if (read(pfd[k].fd, &value, sizeof(value)) != sizeof(value)) continue;
+            if (value >= READY_FAILED) return -1;
+            done[idx[k]] = 1;
+            elapsed[slots[idx[k]]] = get_time_sec() - t0;
+            remaining--;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef READY_H
+#define READY_H
+
+// READINESS NOTIFICATION
+// Main creates one eventfd per component before fork() (or before the
+// threads start), so every component inherits it. A component writes to
+// its eventfd once it is up; Main sleeps in poll() on all of them instead
+// of guessing from side effects.
+
+#define READY_TIMEOUT 5.0   // Default wait for the components (seconds)
+
+typedef enum {
+    READY_BLACKBOARD,
+    READY_DYNAMICS,
+    READY_OBSTACLES,
+    READY_TARGETS,
+    READY_FIRST_FRAME,      // The Blackboard has broadcast a complete world
+    READY_COUNT
+} ReadySlot;
+
+// Main: creates the eventfds (call before fork / pthread_create)
+int ready_init(void);
+
+// Components: "I am up" / "I will never be up". No-op without ready_init().
+void ready_signal(ReadySlot slot);
+void ready_fail(ReadySlot slot);
+
+// Main: waits until every slot in 'slots' has signaled, one failed, or
+// 'timeout' seconds passed (< 0 = no limit). elapsed[slot] gets the time
+// since 't0' at which each slot signaled (-1 if it did not).
+// Returns 0 if all are ready, -1 otherwise.
+int ready_wait(const ReadySlot *slots, int n, double timeout, double t0, double *elapsed);
+
+const char *ready_name(ReadySlot slot);
+
+#endif
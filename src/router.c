@@ -0,0 +1,349 @@
+#define _GNU_SOURCE
+#include "router.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Outputs are non-blocking: a stalled reader (e.g. a suspended terminal)
+// must never block the hub. We track how many bytes are still queued in
+// each pipe; above the high watermark the subscriber is "congested" and
+// state updates are dropped (the next ones supersede them anyway).
+// Once it drains, a full keyframe is sent so it catches up.
+#define SUB_RETRY_INTERVAL 0.1  // Seconds between attach attempts
+#define SUB_HIGH_WATERMARK 2    // Congested above capacity / 2
+#define VIEWER_HELLO_TIMEOUT 2.0 // Seconds for a viewer to send its subscription
+
+Subscriber subscribers[MAX_SUBSCRIBERS];
+int n_subscribers = 0;
+
+static Metric *topic_sent[MSG_TYPE_COUNT];     // All subscribers together
+static int viewer_fd = -1;
+static char viewer_path[108];
+static int viewer_next = 0;                    // Round-robin start of router_recv
+
+static const char *TOPIC_NAMES[MSG_TYPE_COUNT] = {
+    "DRONE_STATE", "FORCE_UPDATE", "OBSTACLE", "TARGET", "STOP", "PARAM", "PLAYER",
+    "INPUT", "CORRECTION", "LOCKSTEP", "NET_STATS"
+};
+
+// Used when config/topics.txt is missing (same format as the file)
+static const char *DEFAULT_TOPICS[] = {
+    "UI_Map   " PIPE_SERVER_TO_MAP      " DRONE_STATE:50 OBSTACLE TARGET STOP PLAYER",
+    "UI_Input " PIPE_SERVER_TO_UI_INPUT " DRONE_STATE:20 PARAM NET_STATS",
+    "Dynamics " PIPE_SERVER_TO_DYN      " FORCE_UPDATE OBSTACLE TARGET STOP PARAM PLAYER CORRECTION INPUT LOCKSTEP",
+};
+
+const char *topic_name(MessageType topic) {
+    if (topic < 0 || topic >= MSG_TYPE_COUNT) return "?";
+    return TOPIC_NAMES[topic];
+}
+
+int topic_from_name(const char *name) {
+    for (int t = 0; t < MSG_TYPE_COUNT; t++) {
+        if (strcmp(name, TOPIC_NAMES[t]) == 0) return t;
+    }
+    return -1;
+}
+
+// The rest of a subscription line: "TOPIC[:HZ] TOPIC[:HZ] ..."
+static void parse_topics(Subscriber *sub, char **save) {
+    char *tok;
+    while ((tok = strtok_r(NULL, " \t\r\n", save)) != NULL) {
+        float hz = 0.0f;
+        char *colon = strchr(tok, ':');
+        if (colon) { *colon = '\0'; hz = atof(colon + 1); }
+        int topic = topic_from_name(tok);
+        if (topic < 0) {
+            log_message(SYSTEM_LOG_FILE, "Router", "Unknown topic '%s' for '%s'", tok, sub->name);
+            continue;
+        }
+        sub->wants[topic] = 1;
+        sub->rate[topic] = (hz > 0) ? hz : 0.0f;
+    }
+}
+
+// Parse "NAME FIFO TOPIC[:HZ] TOPIC[:HZ] ..."
+static void parse_line(char *line) {
+    char *save = NULL;
+    char *name = strtok_r(line, " \t\r\n", &save);
+    if (!name || name[0] == '#') return;
+    char *path = strtok_r(NULL, " \t\r\n", &save);
+    if (!path) return;
+    if (n_subscribers >= MAX_SUBSCRIBERS) {
+        log_message(SYSTEM_LOG_FILE, "Router", "Too many subscribers, '%s' ignored", name);
+        return;
+    }
+
+    Subscriber *sub = &subscribers[n_subscribers];
+    memset(sub, 0, sizeof(Subscriber));
+    snprintf(sub->name, sizeof(sub->name), "%s", name);
+    snprintf(sub->path, sizeof(sub->path), "%s", path);
+    sub->ch = NULL;
+    parse_topics(sub, &save);
+
+    // The reader may start first, so the FIFO must exist already
+    if (chan_get_transport(sub->path) == CHAN_FIFO && mkfifo(sub->path, 0666) == -1 && errno != EEXIST)
+        perror("mkfifo subscriber");
+    n_subscribers++;
+}
+
+static void router_register_metrics(Subscriber *sub) {
+    char labels[48];
+    snprintf(labels, sizeof(labels), "subscriber=\"%s\"", sub->name);
+    sub->m_sent = metric_counter("drone_subscriber_sent_total", labels, "Frames written to the subscriber");
+    sub->m_dropped = metric_counter("drone_subscriber_dropped_total", labels, "Frames dropped (congested)");
+    sub->m_depth = metric_gauge("drone_subscriber_queue_bytes", labels, "Bytes not yet read by the subscriber");
+    sub->m_capacity = metric_gauge("drone_subscriber_capacity_bytes", labels, "Channel buffer size");
+    sub->m_congested = metric_gauge("drone_subscriber_congested", labels, "1 above the high watermark");
+    sub->m_attached = metric_gauge("drone_subscriber_attached", labels, "1 once the reader has opened its end");
+}
+
+int router_load(const char *filename) {
+    n_subscribers = 0;
+    char line[256];
+    FILE *f = fopen(filename, "r");
+    if (f) {
+        while (fgets(line, sizeof(line), f)) parse_line(line);
+        fclose(f);
+    } else {
+        log_message(SYSTEM_LOG_FILE, "Router", "%s not found, using default subscriptions", filename);
+        for (size_t i = 0; i < sizeof(DEFAULT_TOPICS) / sizeof(DEFAULT_TOPICS[0]); i++) {
+            snprintf(line, sizeof(line), "%s", DEFAULT_TOPICS[i]);
+            parse_line(line);
+        }
+    }
+    for (int i = 0; i < n_subscribers; i++) {
+        log_message(SYSTEM_LOG_FILE, "Router", "Subscriber '%s' on %s", subscribers[i].name, subscribers[i].path);
+        router_register_metrics(&subscribers[i]);
+    }
+    char labels[48];
+    for (int t = 0; t < MSG_TYPE_COUNT; t++) {
+        snprintf(labels, sizeof(labels), "topic=\"%s\"", TOPIC_NAMES[t]);
+        topic_sent[t] = metric_counter("drone_topic_sent_total", labels, "Messages delivered per topic");
+    }
+    return n_subscribers;
+}
+
+// Try to attach (a FIFO open fails with ENXIO until the reader exists)
+static void sub_attach(Subscriber *sub, double now) {
+    if (sub->viewer || sub->ch || now < sub->next_attach) return;
+    sub->next_attach = now + SUB_RETRY_INTERVAL;
+    sub->ch = chan_try_open(sub->path, CHAN_WRITE);
+    if (!sub->ch) return;
+    sub->capacity = chan_capacity(sub->ch);
+    sub->need_keyframe = 1;
+    log_message(SYSTEM_LOG_FILE, "Blackboard", "Subscriber '%s' attached (buffer %d bytes)", sub->name, sub->capacity);
+}
+
+static void sub_detach(Subscriber *sub) {
+    chan_close(sub->ch);
+    sub->ch = NULL;
+    if (sub->viewer) {
+        // The slot is free for the next viewer
+        sub->hello = 0;
+        log_message(SYSTEM_LOG_FILE, "Blackboard", "Viewer '%s' (%s) detached", sub->path, sub->name);
+        return;
+    }
+    log_message(SYSTEM_LOG_FILE, "Blackboard", "Subscriber '%s' detached", sub->name);
+}
+
+int router_listen(const char *path) {
+    struct sockaddr_un addr = { 0 };
+    if (strlen(path) >= sizeof(addr.sun_path)) { errno = ENAMETOOLONG; return -1; }   // Never a cut path
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    // SEQPACKET: a frame is one packet, never split or merged
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+        close(fd);
+        return -1;
+    }
+    viewer_fd = fd;
+    snprintf(viewer_path, sizeof(viewer_path), "%s", path);
+    return 0;
+}
+
+// 1. New connections take a free viewer slot (or a new one)
+static void viewer_accept(double now) {
+    int fd;
+    while ((fd = accept4(viewer_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        Subscriber *sub = NULL;
+        for (int i = 0; i < n_subscribers && !sub; i++) {
+            if (subscribers[i].viewer && !subscribers[i].ch) sub = &subscribers[i];
+        }
+        if (!sub && n_subscribers < MAX_SUBSCRIBERS) {
+            sub = &subscribers[n_subscribers];
+            memset(sub, 0, sizeof(Subscriber));
+            sub->viewer = 1;
+            snprintf(sub->name, sizeof(sub->name), "viewer%d", n_subscribers);
+            router_register_metrics(sub);   // Labelled by slot, kept for the next viewer
+            n_subscribers++;
+        }
+        if (!sub || !(sub->ch = chan_from_socket(fd, viewer_path))) {
+            log_message(SYSTEM_LOG_FILE, "Blackboard", "Viewer refused (%d subscribers)", n_subscribers);
+            close(fd);
+            continue;
+        }
+        sub->hello = 0;
+        sub->next_attach = now + VIEWER_HELLO_TIMEOUT;
+    }
+}
+
+// 2. Its first packet is the subscription: "VIEW <name> TOPIC[:HZ] ..."
+static void viewer_hello(Subscriber *sub, double now) {
+    char line[256];
+    int n = chan_recv_raw(sub->ch, line, sizeof(line) - 1);
+    if (n <= 0) {
+        if (n < 0 || now > sub->next_attach) {
+            log_message(SYSTEM_LOG_FILE, "Blackboard", "Viewer on %s closed before subscribing", sub->name);
+            chan_close(sub->ch);
+            sub->ch = NULL;
+        }
+        return;
+    }
+    line[n] = '\0';
+    char *save = NULL;
+    char *tok = strtok_r(line, " \t\r\n", &save);
+    char *name = strtok_r(NULL, " \t\r\n", &save);
+    if (!tok || strcmp(tok, "VIEW") != 0 || !name) {
+        log_message(SYSTEM_LOG_FILE, "Blackboard", "Viewer on %s: bad subscription, closed", sub->name);
+        chan_close(sub->ch);
+        sub->ch = NULL;
+        return;
+    }
+    memset(sub->wants, 0, sizeof(sub->wants));
+    memset(sub->rate, 0, sizeof(sub->rate));
+    memset(sub->next_due, 0, sizeof(sub->next_due));
+    memset(sub->sent_frame, 0, sizeof(sub->sent_frame));
+    snprintf(sub->path, sizeof(sub->path), "%s", name);
+    parse_topics(sub, &save);
+    sub->hello = 1;
+    sub->capacity = chan_capacity(sub->ch);
+    sub->max_depth = 0;
+    sub->congested = 0;
+    sub->need_keyframe = 1;
+    log_message(SYSTEM_LOG_FILE, "Blackboard", "Viewer '%s' attached as %s (buffer %d bytes)", name, sub->name, sub->capacity);
+}
+
+void router_begin_frame(double now) {
+    if (viewer_fd >= 0) viewer_accept(now);
+    for (int i = 0; i < n_subscribers; i++) {
+        Subscriber *sub = &subscribers[i];
+        sub->keyframe = 0;
+        sub_attach(sub, now);
+        if (sub->viewer && sub->ch && !sub->hello) viewer_hello(sub, now);
+        // Published once per tick, from the values of the previous one
+        metric_set(sub->m_sent, sub->sent);
+        metric_set(sub->m_dropped, sub->dropped);
+        metric_set(sub->m_attached, sub->ch != NULL);
+        if (!sub->ch) continue;
+        sub->depth = chan_pending(sub->ch);
+        if (sub->depth > sub->max_depth) sub->max_depth = sub->depth;
+        sub->congested = (sub->depth > sub->capacity / SUB_HIGH_WATERMARK);
+        metric_set(sub->m_depth, sub->depth);
+        metric_set(sub->m_capacity, sub->capacity);
+        metric_set(sub->m_congested, sub->congested);
+        if (sub->congested) {
+            sub->need_keyframe = 1;
+        } else if (sub->need_keyframe) {
+            // Clear first: a failed write during the keyframe sets it again
+            sub->keyframe = 1;
+            sub->need_keyframe = 0;
+        }
+    }
+}
+
+int router_due(Subscriber *sub, MessageType topic, double now) {
+    if (!sub->wants[topic] || !sub->ch || sub->congested || (sub->viewer && !sub->hello)) return 0;
+    if (sub->keyframe || sub->rate[topic] <= 0) return 1;
+    return now >= sub->next_due[topic];
+}
+
+void router_sent(Subscriber *sub, MessageType topic, unsigned long frame, double now) {
+    sub->sent_frame[topic] = frame;
+    if (sub->keyframe || sub->rate[topic] <= 0) return;
+    // The slot is used only by a send: a frame with nothing new keeps it
+    double interval = 1.0 / sub->rate[topic];
+    sub->next_due[topic] += interval;
+    if (sub->next_due[topic] < now) sub->next_due[topic] = now + interval;
+}
+
+// Counts a send; on failure marks the subscriber congested or detaches it
+static int send_result(Subscriber *sub, int rc) {
+    if (rc == 0) {
+        sub->sent++;
+        return 0;
+    }
+    if (errno == EAGAIN) {
+        // Buffer full: stop writing this tick, catch up with a keyframe later
+        sub->congested = 1;
+        sub->need_keyframe = 1;
+        sub->dropped++;
+    } else if (errno == EPIPE) {
+        sub_detach(sub);
+    }
+    return -1;
+}
+
+int router_send(Subscriber *sub, const Message *msg) {
+    if (!sub->ch) return -1;
+    if (sub->congested) { sub->dropped++; return -1; }
+    int rc = send_result(sub, chan_send(sub->ch, msg));
+    if (rc == 0) metric_add(topic_sent[msg->type], 1);
+    return rc;
+}
+
+int router_send_batch(Subscriber *sub, const Message *hdr, const void *items, int count) {
+    if (count <= 0) return 0;
+    if (!sub->ch) return -1;
+    if (sub->congested) { sub->dropped++; return -1; }
+    int rc = send_result(sub, chan_send_batch(sub->ch, hdr, items, count));
+    if (rc == 0) metric_add(topic_sent[hdr->type], count);
+    return rc;
+}
+
+void router_publish(const Message *msg) {
+    for (int i = 0; i < n_subscribers; i++) {
+        Subscriber *sub = &subscribers[i];
+        if (sub->wants[msg->type] && (!sub->viewer || sub->hello)) router_send(sub, msg);
+    }
+}
+
+int router_recv(Message *msg) {
+    // Round robin: a chatty viewer cannot starve the others
+    for (int k = 0; k < n_subscribers; k++) {
+        int i = (viewer_next + k) % n_subscribers;
+        Subscriber *sub = &subscribers[i];
+        if (!sub->viewer || !sub->ch || !sub->hello) continue;
+        int got = chan_recv(sub->ch, msg);
+        if (got > 0) {
+            viewer_next = i + 1;
+            return 1;
+        }
+        if (got < 0) sub_detach(sub);   // Closed by the viewer
+    }
+    return 0;
+}
+
+void router_report(void) {
+    for (int i = 0; i < n_subscribers; i++) {
+        Subscriber *sub = &subscribers[i];
+        if (sub->dropped > 0) {
+            log_message(SYSTEM_LOG_FILE, "Blackboard", "Subscriber '%s': sent %lu, dropped %lu, max queue %d/%d bytes",
+                        sub->name, sub->sent, sub->dropped, sub->max_depth, sub->capacity);
+        }
+    }
+}
+
+void router_close_all(void) {
+    for (int i = 0; i < n_subscribers; i++) {
+        chan_close(subscribers[i].ch);
+        subscribers[i].ch = NULL;
+    }
+    if (viewer_fd >= 0) {
+        close(viewer_fd);
+        unlink(viewer_path);
+        viewer_fd = -1;
+    }
+}
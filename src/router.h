@@ -0,0 +1,91 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include "common.h"
+#include "channel.h"
+#include "metrics.h"
+
+// Publish/Subscribe router used by the Blackboard.
+// Each subscriber is an output channel with a list of topics (MessageType)
+// and a max rate per topic. The list is read from config/topics.txt,
+// so a new consumer only needs a new line there (no hub code change).
+//
+// VIEWERS: a window started with --attach connects to the Blackboard's
+// Unix socket (VIEWER_SOCKET in params.txt) at any time and sends one
+// line in the same format, "VIEW <name> TOPIC[:HZ] ...". It gets a
+// keyframe, then deltas at its own rates, and may send messages back on
+// the same socket (the Input Window's forces). Closing the socket is the
+// detach. Nothing is rendered or sent while no viewer is attached.
+
+#define TOPICS_FILE     "config/topics.txt"
+#define MAX_SUBSCRIBERS 16      // Lines of topics.txt and viewers together
+
+typedef struct {
+    char name[32];
+    char path[64];
+    Channel *ch;            // NULL until the reader has opened its end
+    int capacity;           // Buffer size in bytes
+    int depth;              // Bytes not yet read by the subscriber
+    int max_depth;
+    int congested;
+    int need_keyframe;      // Updates were dropped: resend the full state
+    int keyframe;           // This frame is a keyframe
+    unsigned long sent;
+    unsigned long dropped;
+    double next_attach;
+    int viewer;             // Slot of a socket viewer (free while ch is NULL)
+    int hello;              // Viewer: subscription line received
+
+    // Topic interest
+    int wants[MSG_TYPE_COUNT];
+    float rate[MSG_TYPE_COUNT];         // Hz, 0 = every update
+    double next_due[MSG_TYPE_COUNT];
+    unsigned long sent_frame[MSG_TYPE_COUNT]; // Last frame delivered per topic
+
+    // Exported copies of the counters above (see metrics.h)
+    Metric *m_sent, *m_dropped, *m_depth, *m_capacity, *m_congested, *m_attached;
+} Subscriber;
+
+extern Subscriber subscribers[MAX_SUBSCRIBERS];
+extern int n_subscribers;
+
+// Loads the subscriptions (built-in defaults if the file is missing)
+// and creates the FIFOs. Returns the number of subscribers.
+int router_load(const char *filename);
+
+// Name <-> topic helpers ("DRONE_STATE" <-> MSG_DRONE_STATE)
+const char *topic_name(MessageType topic);
+int topic_from_name(const char *name);
+
+// Opens the viewer socket (SOCK_SEQPACKET). Returns -1 on failure.
+int router_listen(const char *path);
+
+// Once per tick: attach late readers and new viewers, measure queue depths
+void router_begin_frame(double now);
+
+// Next message sent by a viewer. Returns 1, or 0 when there is none.
+int router_recv(Message *msg);
+
+// 1 if 'sub' may get 'topic' this frame (subscribed, writable, rate ok).
+// Only reads: the rate slot is used by router_sent().
+int router_due(Subscriber *sub, MessageType topic, double now);
+
+// After sending 'topic' to 'sub': remembers the frame and starts the
+// next rate interval
+void router_sent(Subscriber *sub, MessageType topic, unsigned long frame, double now);
+
+// Non-blocking write. Returns 0 if sent, -1 if dropped.
+int router_send(Subscriber *sub, const Message *msg);
+
+// Same for an array of Obstacles/Targets, sent as batch frames
+int router_send_batch(Subscriber *sub, const Message *hdr, const void *items, int count);
+
+// Event delivery: send to every subscriber of msg->type, no rate limit
+void router_publish(const Message *msg);
+
+// Logs per-subscriber counters when something was dropped
+void router_report(void);
+
+void router_close_all(void);
+
+#endif
@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+#include "common.h"
+#include "params.h"
+#include "metrics.h"
+#include "rt.h"
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+
+static const char *policy_name(int policy) {
+    return policy == SCHED_FIFO ? "SCHED_FIFO" : policy == SCHED_RR ? "SCHED_RR" : "SCHED_OTHER";
+}
+
+// "RT_<COMPONENT>_<what>" (upper case)
+static void rt_key(char *key, size_t cap, const char *component, const char *what) {
+    int n = snprintf(key, cap, "RT_");
+    for (const char *c = component; *c && n < (int)cap - 1; c++) key[n++] = toupper((unsigned char)*c);
+    snprintf(key + n, cap - n, "_%s", what);
+}
+
+int rt_apply(const char *component) {
+    if (!param_get_int("RT_PROFILE", 0)) return 0;
+    char key[48];
+
+    // 1. Timer slack: the kernel may delay a timer by up to 50 us by
+    // default to merge wake-ups (per thread)
+    int slack_us = param_get_int("RT_TIMER_SLACK_US", RT_TIMER_SLACK_US);
+    if (slack_us > 0 && prctl(PR_SET_TIMERSLACK, (unsigned long)slack_us * 1000UL) != 0)
+        log_message(SYSTEM_LOG_FILE, "RT", "%s: timer slack not set (%s)", component, strerror(errno));
+
+    // 2. CPU affinity (this thread)
+    rt_key(key, sizeof(key), component, "CPU");
+    int cpu = param_get_int(key, -1);
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0) log_message(SYSTEM_LOG_FILE, "RT", "%s: CPU %d refused (%s)", component, cpu, strerror(rc));
+        else log_message(SYSTEM_LOG_FILE, "RT", "%s: pinned to CPU %d", component, cpu);
+    }
+
+    // 3. Memory: no page fault in the loop. MCL_FUTURE only when the
+    // lock limit cannot be reached (a later malloc would fail past it).
+    if (param_get_int("RT_MLOCK", 1)) {
+        struct rlimit rl;
+        int flags = MCL_CURRENT;
+        if (geteuid() == 0 || (getrlimit(RLIMIT_MEMLOCK, &rl) == 0 && rl.rlim_cur == RLIM_INFINITY)) flags |= MCL_FUTURE;
+        if (mlockall(flags) != 0) log_message(SYSTEM_LOG_FILE, "RT", "%s: memory not locked (%s)", component, strerror(errno));
+    }
+
+    // 4. Policy and priority (this thread). Without CAP_SYS_NICE the
+    // RLIMIT_RTPRIO soft limit is the highest priority allowed.
+    char name[PARAM_VAL_LEN];
+    param_get_str("RT_POLICY", "fifo", name, sizeof(name));
+    int policy = strcmp(name, "rr") == 0 ? SCHED_RR : strcmp(name, "other") == 0 ? SCHED_OTHER : SCHED_FIFO;
+    if (policy == SCHED_OTHER) return 0;
+    rt_key(key, sizeof(key), component, "PRIORITY");
+    int prio = param_get_int(key, strcmp(component, "Dynamics") == 0 ? RT_DYNAMICS_PRIORITY : RT_BLACKBOARD_PRIORITY);
+    int lo = sched_get_priority_min(policy), hi = sched_get_priority_max(policy);
+    if (prio < lo) prio = lo;
+    if (prio > hi) prio = hi;
+    struct sched_param sp = { .sched_priority = prio };
+    int rc = pthread_setschedparam(pthread_self(), policy, &sp);
+    if (rc == EPERM) {
+        struct rlimit rl;
+        if (getrlimit(RLIMIT_RTPRIO, &rl) == 0 && rl.rlim_cur > 0 && (rlim_t)prio > rl.rlim_cur) {
+            sp.sched_priority = (int)rl.rlim_cur;
+            rc = pthread_setschedparam(pthread_self(), policy, &sp);
+        }
+    }
+    if (rc != 0) {
+        log_message(SYSTEM_LOG_FILE, "RT", "%s: %s %d refused (%s), staying SCHED_OTHER", component,
+                    policy_name(policy), prio, strerror(rc));
+        return 0;
+    }
+    log_message(SYSTEM_LOG_FILE, "RT", "%s: %s priority %d, timer slack %d us", component,
+                policy_name(policy), sp.sched_priority, slack_us);
+    return 1;
+}
+
+static void ts_add_ns(struct timespec *t, long ns) {
+    t->tv_nsec += ns;
+    while (t->tv_nsec >= 1000000000L) { t->tv_nsec -= 1000000000L; t->tv_sec++; }
+}
+
+static double ts_diff(const struct timespec *a, const struct timespec *b) {
+    return (a->tv_sec - b->tv_sec) + (a->tv_nsec - b->tv_nsec) / 1e9;
+}
+
+void rt_loop_start(RtLoop *loop, long period_ns) {
+    memset(loop, 0, sizeof(RtLoop));
+    loop->period_ns = period_ns;
+    clock_gettime(CLOCK_MONOTONIC, &loop->next);
+}
+
+void rt_loop_wait(RtLoop *loop) {
+    struct timespec now;
+    ts_add_ns(&loop->next, loop->period_ns);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (ts_diff(&now, &loop->next) > 0) {
+        // The step took longer than the period: no burst to catch up
+        loop->overruns++;
+        loop->next = now;
+        return;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &loop->next, NULL) == EINTR) {}
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    rt_loop_record(loop, ts_diff(&now, &loop->next));
+}
+
+void rt_loop_record(RtLoop *loop, double late_sec) {
+    if (late_sec < 0) late_sec = 0;
+    loop->late_sum += late_sec;
+    loop->late_sum2 += late_sec * late_sec;
+    if (late_sec > loop->late_max) loop->late_max = late_sec;
+    loop->count++;
+}
+
+void rt_loop_report(RtLoop *loop, const char *component) {
+    if (loop->count == 0 && loop->overruns == 0) return;
+    double avg = loop->count ? loop->late_sum / loop->count : 0.0;
+    double var = loop->count ? loop->late_sum2 / loop->count - avg * avg : 0.0;
+    log_message(SYSTEM_LOG_FILE, component, "Loop jitter (%s, period %.1f ms): avg %.1f us, stddev %.1f us, max %.1f us, "
+                "%ld overruns in %ld steps", policy_name(sched_getscheduler(0)), loop->period_ns / 1e6,
+                avg * 1e6, sqrt(var > 0 ? var : 0) * 1e6, loop->late_max * 1e6, loop->overruns, loop->count + loop->overruns);
+
+    char labels[48];
+    snprintf(labels, sizeof(labels), "component=\"%s\"", component);
+    metric_set(metric_gauge("drone_loop_late_avg_seconds", labels, "Wake-up lateness, last report period"), avg);
+    metric_set(metric_gauge("drone_loop_late_max_seconds", labels, "Worst wake-up lateness, last report period"), loop->late_max);
+    metric_add(metric_counter("drone_loop_overruns_total", labels, "Steps longer than the period"), loop->overruns);
+
+    long period = loop->period_ns;
+    struct timespec next = loop->next;
+    memset(loop, 0, sizeof(RtLoop));
+    loop->period_ns = period;
+    loop->next = next;
+}
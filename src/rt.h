@@ -0,0 +1,50 @@
+#ifndef RT_H
+#define RT_H
+
+#include <time.h>
+
+// REAL-TIME PROFILE (Dynamics, Blackboard)
+// With RT_PROFILE 1 in params.txt, rt_apply() gives the calling thread
+// (so each component in threads mode) a real-time policy and priority,
+// pins it to a CPU, reduces its timer slack and locks the process'
+// memory. Every step is optional: without the privilege (CAP_SYS_NICE,
+// RLIMIT_RTPRIO, RLIMIT_MEMLOCK) it is logged and skipped, and the
+// component runs as before.
+//   RT_PROFILE 1                 (0 = default scheduling, the default)
+//   RT_POLICY fifo               (fifo, rr or other)
+//   RT_DYNAMICS_PRIORITY 80      (1-99; RT_BLACKBOARD_PRIORITY 70)
+//   RT_DYNAMICS_CPU 1            (-1 = any CPU; RT_BLACKBOARD_CPU)
+//   RT_MLOCK 1                   (mlockall: no page faults in the loops)
+//   RT_TIMER_SLACK_US 1          (kernel default 50)
+
+#define RT_DYNAMICS_PRIORITY   80
+#define RT_BLACKBOARD_PRIORITY 70
+#define RT_TIMER_SLACK_US      1
+
+// 'component' names the keys ("Dynamics" -> RT_DYNAMICS_*). Returns 1
+// if the real-time policy is in effect, 0 otherwise.
+int rt_apply(const char *component);
+
+// PERIODIC LOOP with absolute deadlines (clock_nanosleep TIMER_ABSTIME):
+// the work of a step does not shift the next one, and the lateness of
+// every wake-up is measured (the loop's jitter).
+typedef struct {
+    struct timespec next;   // Next deadline (CLOCK_MONOTONIC)
+    long period_ns;         // May change between waits
+    double late_sum, late_sum2, late_max;
+    long count;
+    long overruns;          // Deadlines already past: the loop restarts from now
+} RtLoop;
+
+void rt_loop_start(RtLoop *loop, long period_ns);
+
+// Sleeps until the next deadline, then records how late we woke up
+void rt_loop_wait(RtLoop *loop);
+
+// For loops that wait on something else until a deadline (the Blackboard)
+void rt_loop_record(RtLoop *loop, double late_sec);
+
+// Logs avg / stddev / max lateness and overruns since the last report, then resets
+void rt_loop_report(RtLoop *loop, const char *component);
+
+#endif
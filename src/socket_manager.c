@@ -1,17 +1,49 @@
+#define _GNU_SOURCE
 #include "socket_manager.h"
+#include "net_frame.h"
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <ctype.h>
+#include <poll.h>
+#include <sys/time.h>
 
 #define BUFFER_SIZE 256
+#define JOIN_TIMEOUT_MS 2000   // A player joining a running session: max handshake wait
+#define MAX_JOINS 8            // Handshakes in progress at once (more wait in the backlog)
+
+static int listen_fd = -1;     // Server: kept open for the players joining later
+
+// A player joining: the server side of sync_handshake as a state machine,
+// advanced by join_poll without ever blocking the session's loop
+enum { JOIN_FREE, JOIN_WAIT_OOK, JOIN_WAIT_SOK, JOIN_DONE };
+typedef struct {
+    int state;
+    int fd;
+    int proto;
+    double deadline;
+    char line[BUFFER_SIZE];
+    int len;
+} Join;
+static Join joins[MAX_JOINS];
+
+// Legacy exchange quality: the round trip is the time from our last line
+// of a request to the peer's answer ("drone" -> "dok", position -> "pok")
+static NetQuality legacy_quality;
+static double last_sent = 0.0;
 
 // Helper: Send string + MICRO Delay
 // 1ms (1000us) is enough to split packets but won't freeze the physics engine.
 void send_msg(int fd, const char *msg) {
     char buffer[BUFFER_SIZE];
     snprintf(buffer, BUFFER_SIZE, "%s\n", msg);
-    if (write(fd, buffer, strlen(buffer)) < 0) perror("[Net] Write failed");
+    ssize_t n = write(fd, buffer, strlen(buffer));
+    if (n < 0) perror("[Net] Write failed");
+    else {
+        last_sent = get_time_sec();
+        legacy_quality.bytes_out += n;
+        legacy_quality.msgs_out++;
+    }
     
     // [OPTIMIZATION] Reduced from 10ms to 1ms
     // This keeps the loop running at ~500Hz instead of ~30Hz
@@ -41,6 +73,8 @@ int read_msg(int fd, char *buffer) {
         // Stop on Newline or Null (if we have data)
         if (c == '\n' || c == '\0') {
             buffer[i] = '\0';
+            legacy_quality.bytes_in += i + 1 + nulls_skipped;
+            legacy_quality.msgs_in++;
             return i;
         }
         
@@ -50,7 +84,7 @@ int read_msg(int fd, char *buffer) {
     return i;
 }
 
-int init_network(int mode, int *port) {
+int init_network(int mode, int *port, const char *ip_arg) {
     int sockfd;
     struct sockaddr_in serv_addr;
     if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) return -1;
@@ -61,7 +95,7 @@ int init_network(int mode, int *port) {
         serv_addr.sin_addr.s_addr = INADDR_ANY;
         int opt = 1; setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
         if (bind(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) return -1;
-        listen(sockfd, 1);
+        listen(sockfd, MAX_PLAYERS);
         printf("[Net] Waiting for player on port %d...\n", *port); fflush(stdout);
         
         struct sockaddr_in cli_addr;
@@ -69,16 +103,28 @@ int init_network(int mode, int *port) {
         int newsockfd = accept(sockfd, (struct sockaddr *)&cli_addr, &clilen);
         if (newsockfd < 0) return -1;
         
-        close(sockfd);
+        // The listening socket stays open: world sync takes more players
+        // (join_poll), the other protocols close it (stop_listening)
+        fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+        listen_fd = sockfd;
         return newsockfd; 
     } else { 
         char ip[32];
-        printf("Enter Server IP (default 127.0.0.1): "); fflush(stdout);
-        if (fgets(ip, sizeof(ip), stdin) && strlen(ip) > 1) {
-             ip[strcspn(ip, "\n")] = 0; 
-             if (inet_pton(AF_INET, ip, &serv_addr.sin_addr) <= 0) inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr);
+        if (ip_arg) {
+            // Non-interactive (--ip)
+            if (inet_pton(AF_INET, ip_arg, &serv_addr.sin_addr) <= 0) {
+                printf("[Net] Invalid server IP '%s'\n", ip_arg);
+                close(sockfd);
+                return -1;
+            }
         } else {
-             inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr);
+            printf("Enter Server IP (default 127.0.0.1): "); fflush(stdout);
+            if (fgets(ip, sizeof(ip), stdin) && strlen(ip) > 1) {
+                 ip[strcspn(ip, "\n")] = 0; 
+                 if (inet_pton(AF_INET, ip, &serv_addr.sin_addr) <= 0) inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr);
+            } else {
+                 inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr);
+            }
         }
 
         if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) return -1;
@@ -86,9 +132,28 @@ int init_network(int mode, int *port) {
     }
 }
 
+// Protocol names, as sent after "sok" (index = NET_PROTO_*)
+static const char *PROTO_NAMES[] = { "legacy", "world", "lockstep", "spectate" };
+
+static int proto_from_name(const char *name) {
+    for (int i = 1; i < 4; i++) if (strcmp(name, PROTO_NAMES[i]) == 0) return i;
+    return NET_PROTO_LEGACY;
+}
+
+// Is 'word' one of the space separated words of 'list'?
+static int has_word(const char *list, const char *word) {
+    size_t len = strlen(word);
+    if (len == 0) return 0;
+    for (const char *p = list; (p = strstr(p, word)) != NULL; p += len) {
+        if ((p == list || p[-1] == ' ') && (p[len] == '\0' || p[len] == ' ')) return 1;
+    }
+    return 0;
+}
+
 // HANDSHAKE (FRIEND COMPATIBLE)
-int sync_handshake(int mode, int fd) {
+int sync_handshake(int mode, int fd, const char *caps) {
     char buf[BUFFER_SIZE];
+    int proto = NET_PROTO_LEGACY;
     if (mode == MODE_SERVER) {
         send_msg(fd, "ok");
         if (read_msg(fd, buf) <= 0 || strcmp(buf, "ook") != 0) return -1;
@@ -101,15 +166,36 @@ int sync_handshake(int mode, int fd) {
         if (read_msg(fd, buf) <= 0) return -1;
         // Accept "sok" or "sok..."
         if (strncmp(buf, "sok", 3) != 0) return -1;
+        // "sok world" / "sok lockstep" / "sok spectate": the client wants
+        // that protocol, agreed if it is in our list
+        const char *wanted = (buf[3] == ' ') ? buf + 4 : "";
+        if (caps && has_word(caps, wanted) && proto_from_name(wanted) != NET_PROTO_LEGACY) {
+            send_msg(fd, wanted);
+            proto = proto_from_name(wanted);
+        }
     } else {
         if (read_msg(fd, buf) <= 0 || strcmp(buf, "ok") != 0) return -1;
         send_msg(fd, "ook");
         
         if (read_msg(fd, buf) <= 0) return -1; // Rcv size
-        send_msg(fd, "sok");
+        if (caps) {
+            snprintf(buf, sizeof(buf), "sok %s", caps);
+            send_msg(fd, buf);
+            // A legacy server goes straight to its "drone" line: only
+            // consume the next line if it is the agreement
+            size_t len = strlen(caps) + 1;
+            char peek[BUFFER_SIZE];
+            if (recv(fd, peek, len, MSG_PEEK | MSG_WAITALL) == (ssize_t)len &&
+                strncmp(peek, caps, len - 1) == 0 && peek[len - 1] == '\n') {
+                if (read_msg(fd, buf) <= 0) return -1;
+                proto = proto_from_name(caps);
+            }
+        } else {
+            send_msg(fd, "sok");
+        }
     }
-    printf("[Net] Handshake OK.\n"); fflush(stdout);
-    return 0;
+    printf("[Net] Handshake OK (%s protocol).\n", PROTO_NAMES[proto]); fflush(stdout);
+    return proto;
 }
 
 // DATA EXCHANGE 
@@ -128,6 +214,7 @@ int network_exchange(int mode, int fd, DroneState *my_drone, Obstacle *opponent)
         send_msg(fd, msg);
         
         if (read_msg(fd, buf) <= 0) return -1; // dok
+        net_quality_sample(&legacy_quality, last_sent, get_time_sec());
 
         send_msg(fd, "obst");
         if (read_msg(fd, buf) <= 0) return -1; // coords
@@ -164,6 +251,7 @@ int network_exchange(int mode, int fd, DroneState *my_drone, Obstacle *opponent)
             sprintf(msg, "%.2f %.2f", my_drone->position.x, my_y_net);
             send_msg(fd, msg);
             if (read_msg(fd, buf) <= 0) return -1; 
+            net_quality_sample(&legacy_quality, last_sent, get_time_sec());   // pok
         }
         else if (strcmp(buf, "q") == 0) {
             send_msg(fd, "qok");
@@ -173,4 +261,133 @@ int network_exchange(int mode, int fd, DroneState *my_drone, Obstacle *opponent)
     return 0;
 }
 
-void close_network(int fd) { close(fd); }
\ No newline at end of file
+void network_link_stats(int fd, LinkStats *out) {
+    net_quality_read(&legacy_quality, fd, out);
+}
+
+double network_last_rtt(void) {
+    double r = legacy_quality.last;
+    legacy_quality.last = 0.0;
+    return r;
+}
+
+// One line of the handshake (the socket is non-blocking: it always fits)
+static int join_send(Join *j, const char *msg) {
+    char buffer[BUFFER_SIZE];
+    int len = snprintf(buffer, sizeof(buffer), "%s\n", msg);
+    return (send(j->fd, buffer, len, MSG_NOSIGNAL) == len) ? 0 : -1;
+}
+
+// Next complete line of the peer: 1, 0 if not there yet, -1 if closed
+static int join_line(Join *j, char *out) {
+    for (;;) {
+        char *nl = memchr(j->line, '\n', j->len);
+        if (!nl) nl = memchr(j->line, '\0', j->len);
+        if (nl) {
+            // Same rules as read_msg: leading NULs (friend's padding) are skipped
+            int n = (int)(nl - j->line);
+            memcpy(out, j->line, n);
+            out[n] = '\0';
+            j->len -= n + 1;
+            memmove(j->line, nl + 1, j->len);
+            if (n > 0) return 1;
+            continue;
+        }
+        if (j->len == (int)sizeof(j->line)) return -1;     // No line end in a full buffer
+        ssize_t got = recv(j->fd, j->line + j->len, sizeof(j->line) - j->len, 0);
+        if (got == 0) return -1;
+        if (got < 0) return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        j->len += (int)got;
+    }
+}
+
+// Runs a join as far as the peer's lines allow. -1 = failed.
+static int join_step(Join *j, const char *caps) {
+    char buf[BUFFER_SIZE];
+    int got;
+    while ((got = join_line(j, buf)) > 0) {
+        if (j->state == JOIN_WAIT_OOK) {
+            if (strcmp(buf, "ook") != 0) return -1;
+            char size_msg[64];
+            snprintf(size_msg, sizeof(size_msg), "%d,%d", MAP_WIDTH, MAP_HEIGHT);
+            if (join_send(j, size_msg) < 0) return -1;
+            j->state = JOIN_WAIT_SOK;
+        } else if (j->state == JOIN_WAIT_SOK) {
+            if (strncmp(buf, "sok", 3) != 0) return -1;
+            const char *wanted = (buf[3] == ' ') ? buf + 4 : "";
+            j->proto = NET_PROTO_LEGACY;
+            if (caps && has_word(caps, wanted) && proto_from_name(wanted) != NET_PROTO_LEGACY) {
+                if (join_send(j, wanted) < 0) return -1;
+                j->proto = proto_from_name(wanted);
+            }
+            j->state = JOIN_DONE;
+            return 0;
+        }
+    }
+    return got;
+}
+
+void join_poll(const char *caps, double now) {
+    // 1. New connections, as long as a join slot is free
+    for (int i = 0; i < MAX_JOINS && listen_fd >= 0; i++) {
+        if (joins[i].state != JOIN_FREE) continue;
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) break;
+        Join *j = &joins[i];
+        memset(j, 0, sizeof(Join));
+        j->fd = fd;
+        j->deadline = now + JOIN_TIMEOUT_MS / 1000.0;
+        j->state = JOIN_WAIT_OOK;
+        if (join_send(j, "ok") < 0) { close(fd); j->state = JOIN_FREE; }
+    }
+
+    // 2. The handshakes in progress
+    for (int i = 0; i < MAX_JOINS; i++) {
+        Join *j = &joins[i];
+        if (j->state == JOIN_FREE || j->state == JOIN_DONE) continue;
+        int rc = join_step(j, caps);
+        if (rc < 0 || (j->state != JOIN_DONE && now > j->deadline)) {
+            log_message(SYSTEM_LOG_FILE, "Net", "Join handshake %s", rc < 0 ? "failed" : "timed out");
+            close(j->fd);
+            j->state = JOIN_FREE;
+        }
+    }
+}
+
+int join_take(int *proto) {
+    for (int i = 0; i < MAX_JOINS; i++) {
+        Join *j = &joins[i];
+        if (j->state != JOIN_DONE) continue;
+        j->state = JOIN_FREE;
+        *proto = j->proto;
+        printf("[Net] Handshake OK (%s protocol).\n", PROTO_NAMES[j->proto]); fflush(stdout);
+        return j->fd;
+    }
+    return -1;
+}
+
+int accept_next(void) {
+    if (listen_fd < 0) return -1;
+    printf("[Net] Waiting for another player...\n"); fflush(stdout);
+    struct pollfd pfd = { listen_fd, POLLIN, 0 };
+    for (;;) {
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) return -1;
+        int fd = accept(listen_fd, NULL, NULL);     // Blocking socket (not inherited)
+        if (fd >= 0) return fd;
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return -1;
+    }
+}
+
+void stop_listening(void) {
+    if (listen_fd >= 0) close(listen_fd);
+    listen_fd = -1;
+    for (int i = 0; i < MAX_JOINS; i++) {
+        if (joins[i].state != JOIN_FREE) close(joins[i].fd);
+        joins[i].state = JOIN_FREE;
+    }
+}
+
+void close_network(int fd) {
+    close(fd);
+    stop_listening();
+}
\ No newline at end of file
@@ -7,11 +7,39 @@
 #include <arpa/inet.h>
 
 // Initialize the connection (Server listens, Client connects)
+// ip: server address for the client (NULL = ask on stdin)
 // Returns the socket file descriptor, or -1 on error.
-int init_network(int mode, int *port);
+int init_network(int mode, int *port, const char *ip);
+
+// Server: players connecting to the running session. Once per tick,
+// join_poll accepts them and advances their handshakes (the server side
+// of sync_handshake, offering 'caps') without blocking: a silent or slow
+// peer only loses its own join, after 2 s. join_take returns the socket
+// of a completed handshake and its protocol, -1 when there is none.
+void join_poll(const char *caps, double now);
+int join_take(int *proto);
+
+// Server: waits (blocking, like init_network) for the next connection
+// when the first peer was refused. Returns its socket, -1 on error.
+int accept_next(void);
+
+// Server: no more players (the listening socket is closed)
+void stop_listening(void);
+
+// Protocols negotiated by the handshake
+#define NET_PROTO_LEGACY 0   // Text exchange of the two positions (friend compatible)
+#define NET_PROTO_WORLD  1   // Server-authoritative world, binary delta snapshots (net_world.h)
+#define NET_PROTO_LOCKSTEP 2 // Deterministic lockstep, only inputs cross the wire (net_lockstep.h)
+#define NET_PROTO_SPECTATE 3 // Read-only view of a world sync session (net_world.h, spectators)
 
 // Performs the initial Handshake (ok/ook, size/sok) 
-int sync_handshake(int mode, int fd);
+// The client names the protocol it wants after "sok" ("sok world"); a server
+// that agrees answers with the protocol name. Peers that do not know
+// about it (plain "sok", or no answer line) stay on the legacy protocol.
+// caps: client, the protocol it wants ("world", "lockstep", "spectate");
+// server, the ones it offers ("world spectate"); NULL for legacy
+// Returns the negotiated NET_PROTO_*, or -1 on error.
+int sync_handshake(int mode, int fd, const char *caps);
 
 // Exchanges positions inside the main loop
 // mode: SERVER or CLIENT
@@ -21,7 +49,15 @@ int sync_handshake(int mode, int fd);
 // Returns 0 on success, -1 on failure/quit
 int network_exchange(int mode, int fd, DroneState *my_drone, Obstacle *opponent);
 
-// Closes the connection
+// Legacy exchange quality since the last call: round trip of the
+// request/answer pairs, bytes and lines each way, kernel send queue
+void network_link_stats(int fd, LinkStats *out);
+
+// Latest round trip of the legacy exchange (s), 0 if none was measured
+// since the previous call (one sample per request/answer pair)
+double network_last_rtt(void);
+
+// Closes the connection (and the listening socket)
 void close_network(int fd);
 
 #endif
\ No newline at end of file
@@ -4,33 +4,38 @@
 #include <fcntl.h>
 #include <time.h>
 #include "common.h"
+#include "channel.h"
+#include "ready.h"
+#include "params.h"
 
 void run_targets() {
     printf("[Targets] Starting...\n");
-    srand(time(NULL) + getpid() + 100);
+    // Same TARGET_SEED = same targets (0 = random), for repeatable benchmarks
+    unsigned int seed = (unsigned int)param_get_int("TARGET_SEED", 0);
+    srand(seed ? seed : (unsigned int)(time(NULL) + getpid() + 100));
     // Wait for pipe to be available
-    int fd_tar_to_server;
-    while ((fd_tar_to_server = open(PIPE_TAR_TO_SERVER, O_WRONLY)) < 0) {
-        usleep(100000);
-    }
+    Channel *ch_tar_to_server = chan_open(PIPE_TAR_TO_SERVER, CHAN_WRITE);
 
     Message msg;
+    memset(&msg, 0, sizeof(Message));
     msg.type = MSG_TARGET;
     msg.sender_pid = getpid();
 
-    // Spawn 20 targets initially
+    // Spawn all targets initially, sent as one batch
+    Target targets[MAX_TARGETS];
     for (int i = 0; i < MAX_TARGETS; i++) {
-        msg.target.id = i;
-        msg.target.position.x = 5 + rand() % (MAP_WIDTH - 10);
-        msg.target.position.y = 5 + rand() % (MAP_HEIGHT - 10);
-        msg.target.active = 1; 
-        
-        write(fd_tar_to_server, &msg, sizeof(Message));
-        usleep(100000); 
+        targets[i].id = i;
+        targets[i].position.x = 5 + rand() % (MAP_WIDTH - 10);
+        targets[i].position.y = 5 + rand() % (MAP_HEIGHT - 10);
+        targets[i].active = 1; 
+    }
+    if (chan_send_batch(ch_tar_to_server, &msg, targets, MAX_TARGETS) < 0) {
+        log_message(SYSTEM_LOG_FILE, "Targets", "Initial batch failed: %s", strerror(errno));
     }
+    ready_signal(READY_TARGETS);
     
     // Idle loop
     while (1) sleep(10);
     
-    close(fd_tar_to_server);
+    chan_close(ch_tar_to_server);
 }
\ No newline at end of file
@@ -0,0 +1,157 @@
+#define _GNU_SOURCE
+#include "common.h"
+#include "trace.h"
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <limits.h>
+
+#define TRACE_THREADS   8           // Traced threads per process
+#define TRACE_FLUSH_US  100000      // Writer period
+
+typedef struct {
+    uint64_t ts_ns;
+    const char *name;
+    uint64_t id;
+    char phase;
+} TraceEvent;
+
+typedef struct {
+    int pid, tid;
+    char name[32];
+    _Atomic uint64_t head;      // Written by the traced thread
+    _Atomic uint64_t tail;      // Written by the writer thread
+    _Atomic unsigned long dropped;
+    TraceEvent ring[TRACE_RING];
+} TraceBuf;
+
+int trace_enabled = 0;
+
+static _Thread_local TraceBuf *mine = NULL;
+static TraceBuf *bufs[TRACE_THREADS];
+static _Atomic int n_bufs = 0;
+static pthread_mutex_t reg_lock = PTHREAD_MUTEX_INITIALIZER;
+static int trace_fd = -1;
+static pthread_t writer;
+static _Atomic int writer_running = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);     // Same clock in every process
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int trace_create(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) return -1;
+    if (write(fd, "[\n", 2) != 2) { close(fd); return -1; }
+    close(fd);
+    char full[PATH_MAX];
+    setenv(TRACE_ENV, realpath(path, full) ? full : path, 1);
+    return 0;
+}
+
+// Formats [tail, head) of one ring, then releases the slots
+static void drain(TraceBuf *b, char *out, size_t cap) {
+    uint64_t head = atomic_load_explicit(&b->head, memory_order_acquire);
+    uint64_t tail = atomic_load_explicit(&b->tail, memory_order_relaxed);
+    while (tail != head) {
+        size_t len = 0;
+        // One write() per chunk of whole lines
+        while (tail != head && len + 256 < cap) {
+            const TraceEvent *e = &b->ring[tail % TRACE_RING];
+            double ts = e->ts_ns / 1000.0;
+            if (e->phase == 's' || e->phase == 'f') {
+                len += snprintf(out + len, cap - len,
+                                "{\"name\":\"%s\",\"cat\":\"flow\",\"ph\":\"%c\",\"id\":%llu,%s\"ts\":%.3f,\"pid\":%d,\"tid\":%d},\n",
+                                e->name, e->phase, (unsigned long long)e->id, e->phase == 'f' ? "\"bp\":\"e\"," : "",
+                                ts, b->pid, b->tid);
+            } else {
+                len += snprintf(out + len, cap - len, "{\"name\":\"%s\",\"cat\":\"drone\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d},\n",
+                                e->name, e->phase, ts, b->pid, b->tid);
+            }
+            tail++;
+        }
+        if (write(trace_fd, out, len) < 0) {}
+        atomic_store_explicit(&b->tail, tail, memory_order_release);
+    }
+}
+
+static void drain_all(char *out, size_t cap) {
+    int n = atomic_load(&n_bufs);
+    for (int i = 0; i < n; i++) drain(bufs[i], out, cap);
+}
+
+static void *writer_loop(void *arg) {
+    static char out[64 * 1024];
+    while (atomic_load(&writer_running)) {
+        drain_all(out, sizeof(out));
+        usleep(TRACE_FLUSH_US);
+    }
+    drain_all(out, sizeof(out));
+    return NULL;
+}
+
+void trace_init(const char *component) {
+    const char *path = getenv(TRACE_ENV);
+    if (!path || !path[0] || mine) return;
+
+    pthread_mutex_lock(&reg_lock);
+    int first = (trace_fd < 0);
+    if (first) trace_fd = open(path, O_WRONLY | O_APPEND);
+    int n = atomic_load(&n_bufs);
+    if (trace_fd < 0 || n == TRACE_THREADS) { pthread_mutex_unlock(&reg_lock); return; }
+    TraceBuf *b = calloc(1, sizeof(TraceBuf));
+    if (!b) { pthread_mutex_unlock(&reg_lock); return; }
+    b->pid = getpid();
+    b->tid = (int)syscall(SYS_gettid);
+    snprintf(b->name, sizeof(b->name), "%s", component);
+
+    // Names in the timeline (the process takes the name of its first thread)
+    char meta[256];
+    int len = 0;
+    if (first) len += snprintf(meta, sizeof(meta), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+                               b->pid, component);
+    len += snprintf(meta + len, sizeof(meta) - len, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+                    b->pid, b->tid, component);
+    if (write(trace_fd, meta, len) < 0) {}
+
+    bufs[n] = b;
+    atomic_store(&n_bufs, n + 1);
+    mine = b;
+    if (first) {
+        atomic_store(&writer_running, 1);
+        if (pthread_create(&writer, NULL, writer_loop, NULL) != 0) atomic_store(&writer_running, 0);
+        else pthread_setname_np(writer, "trace");
+        atexit(trace_close);
+    }
+    trace_enabled = 1;
+    pthread_mutex_unlock(&reg_lock);
+    log_message(SYSTEM_LOG_FILE, "Trace", "%s (PID %d, TID %d) traced to %s", component, b->pid, b->tid, path);
+}
+
+void trace_event(char phase, const char *name, uint64_t id) {
+    TraceBuf *b = mine;
+    if (!b) return;     // Another thread of a traced process
+    uint64_t head = atomic_load_explicit(&b->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&b->tail, memory_order_acquire) >= TRACE_RING) {
+        atomic_fetch_add_explicit(&b->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    TraceEvent *e = &b->ring[head % TRACE_RING];
+    e->ts_ns = now_ns();
+    e->name = name;
+    e->id = id;
+    e->phase = phase;
+    atomic_store_explicit(&b->head, head + 1, memory_order_release);
+}
+
+void trace_close(void) {
+    if (!atomic_exchange(&writer_running, 0)) return;
+    pthread_join(writer, NULL);
+    int n = atomic_load(&n_bufs);
+    for (int i = 0; i < n; i++) {
+        unsigned long dropped = atomic_load(&bufs[i]->dropped);
+        if (dropped) log_message(SYSTEM_LOG_FILE, "Trace", "%s: %lu events dropped (ring full)", bufs[i]->name, dropped);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// TIMELINE TRACE (Chrome trace-event JSON, opens in https://ui.perfetto.dev)
+// Opt-in: TRACE 1 in params.txt. Main creates TRACE_FILE and passes its
+// path to every process (and the windows it spawns) in $DRONE_TRACE.
+// Each traced thread owns a lock-free single-producer ring of events:
+// recording one is a clock read and three stores. A thread per process
+// drains the rings every 100 ms and appends the events to the file
+// (O_APPEND: the processes never mix inside a line). The JSON array is
+// left open, as the format allows, since the processes stop in any order.
+// Disabled, every trace_* call is one test of a global flag.
+
+#define TRACE_FILE  "drone_trace.json"
+#define TRACE_ENV   "DRONE_TRACE"
+#define TRACE_RING  16384       // Events per thread (about 1.6 s of a busy thread)
+
+extern int trace_enabled;
+
+// Main: truncates the file, writes the "[" and exports $DRONE_TRACE.
+// Returns -1 if the file cannot be created.
+int trace_create(const char *path);
+
+// Per traced thread (does nothing unless $DRONE_TRACE is set): names the
+// thread in the timeline and allocates its ring
+void trace_init(const char *component);
+
+// Spans (name: a string literal, it is stored as a pointer) and flow
+// arrows between threads or processes (same id on both ends)
+void trace_event(char phase, const char *name, uint64_t id);
+static inline void trace_begin(const char *name) { if (trace_enabled) trace_event('B', name, 0); }
+static inline void trace_end(const char *name) { if (trace_enabled) trace_event('E', name, 0); }
+static inline void trace_flow_out(const char *name, uint64_t id) { if (trace_enabled) trace_event('s', name, id); }
+static inline void trace_flow_in(const char *name, uint64_t id) { if (trace_enabled) trace_event('f', name, id); }
+
+// A message's flow id: its sender and send time (Message.stamp)
+static inline uint64_t trace_flow_id(int pid, double stamp) {
+    return ((uint64_t)(uint32_t)pid << 40) ^ (uint64_t)(stamp * 1e6);
+}
+
+// Drains the rings and stops the writer (also run at exit)
+void trace_close(void);
+
+#endif
@@ -5,8 +5,12 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/select.h>
+#include <signal.h>
 #include "common.h"
 #include "params.h" 
+#include "channel.h"
+#include "metrics.h"
 
 const char *keys[3][3] = {{"Z", "E", "R"}, {"S", "D", "F"}, {"X", "C", "V"}};
 // Commanded force values
@@ -14,6 +18,26 @@ float cmd_x = 0.0f;
 float cmd_y = 0.0f;
 float force_step;
 DroneState drone_display;
+// Force command rate limiting (coalesced: one absolute command per frame)
+float cmd_rate;
+double cmd_interval;
+unsigned int cmd_seq = 0;
+// Network links (NET_STATS, once a second; none = standalone or no peer)
+#define LINK_STATS_STALE 3.0
+LinkStats links[MAX_PLAYERS];
+int link_count = 0;
+double links_time = 0.0;
+int attached = 0;   // --attach: 'q' detaches this window only
+
+// Reads our parameters from the store (also called on MSG_PARAM updates)
+void apply_params() {
+    force_step = param_get_float("F_STEP", F_STEP);
+    if (force_step <= 0) force_step = F_STEP;
+    // Missing key: the default. Any positive rate is valid, 1 included.
+    cmd_rate = param_get_float("CMD_RATE", CMD_RATE_DEFAULT);
+    if (cmd_rate <= 0.0f) cmd_rate = CMD_RATE_DEFAULT;
+    cmd_interval = 1.0 / cmd_rate;
+}
 
 //  User interface drawing functions 
 void draw_input_win(WINDOW *win) {
@@ -49,6 +73,7 @@ void draw_input_win(WINDOW *win) {
         }
     }
     mvwprintw(win, h - 4, 2, "Tap ESC to close windows.");
+    if (attached) mvwprintw(win, h - 3, 2, "Tap q to detach this one.");
     wnoutrefresh(win);
 }
 // Display the current drone state and last command
@@ -73,6 +98,34 @@ void draw_output_win(WINDOW *win, char *last_cmd) {
     y++;
     mvwprintw(win, y++, 2, "Force X: %.2f", drone_display.force.x);
     mvwprintw(win, y++, 2, "Force Y: %.2f", drone_display.force.y);
+    y++;
+    wattron(win, A_BOLD);
+    mvwprintw(win, y++, 2, "*** Network ***");
+    wattroff(win, A_BOLD);
+    if (link_count == 0 || get_time_sec() - links_time > LINK_STATS_STALE) {
+        mvwprintw(win, y++, 2, "Offline");
+        wnoutrefresh(win);
+        return;
+    }
+    // Several clients (server): show the worst link, totals for the traffic
+    const LinkStats *worst = &links[0];
+    float in = 0, out = 0, msgs_in = 0, msgs_out = 0;
+    int queue = 0;
+    unsigned int lost = 0, retrans = 0;
+    for (int i = 0; i < link_count; i++) {
+        if (links[i].rtt_ms > worst->rtt_ms) worst = &links[i];
+        in += links[i].bytes_in; out += links[i].bytes_out;
+        msgs_in += links[i].msgs_in; msgs_out += links[i].msgs_out;
+        queue += links[i].send_queue;
+        lost += links[i].lost; retrans += links[i].retrans;
+    }
+    if (link_count > 1) mvwprintw(win, y++, 2, "Links:   %d (worst: player %d)", link_count, worst->peer);
+    mvwprintw(win, y++, 2, "RTT:     %.1f ms (%.1f-%.1f)", worst->rtt_ms, worst->rtt_min_ms, worst->rtt_max_ms);
+    mvwprintw(win, y++, 2, "Jitter:  %.1f ms", worst->jitter_ms);
+    mvwprintw(win, y++, 2, "In:      %.1f kB/s, %.0f msg/s", in / 1024.0f, msgs_in);
+    mvwprintw(win, y++, 2, "Out:     %.1f kB/s, %.0f msg/s", out / 1024.0f, msgs_out);
+    mvwprintw(win, y++, 2, "Queue:   %d B", queue);
+    mvwprintw(win, y++, 2, "Lost:    %u pings, %u retransmits", lost, retrans);
     wnoutrefresh(win);
 }
 
@@ -102,6 +155,29 @@ int main(int argc, char *argv[]) {
     // Register process and log startup(New for Assignment 2)
     register_process("UI_Input"); 
     log_message(SYSTEM_LOG_FILE, "UI_Map", "Map UI process started."); 
+    signal(SIGPIPE, SIG_IGN);
+
+    // --attach [socket]: commands and telemetry on one socket of the
+    // Blackboard instead of the two FIFOs. --rate: telemetry rate.
+    const char *attach = NULL;
+    float rate = 20.0f;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--attach") == 0) attach = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : VIEWER_SOCKET;
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) rate = atof(argv[++i]);
+    }
+    Channel *ch_out = NULL, *ch_in = NULL;
+    if (attach) {
+        char line[128];
+        snprintf(line, sizeof(line), "VIEW input DRONE_STATE:%g PARAM NET_STATS STOP", rate);
+        ch_in = ch_out = chan_subscribe(attach, line, 5.0);
+        if (!ch_in) {
+            fprintf(stderr, "[Input] No Blackboard on %s\n", attach);
+            log_message(SYSTEM_LOG_FILE, "UI_Input", "Cannot attach to %s", attach);
+            return 1;
+        }
+        log_message(SYSTEM_LOG_FILE, "UI_Input", "Attached to %s at %g Hz", attach, rate);
+        attached = 1;
+    }
     
     setlocale(LC_ALL, ""); 
     initscr(); cbreak(); noecho(); keypad(stdscr, TRUE); curs_set(0);
@@ -115,14 +191,16 @@ int main(int argc, char *argv[]) {
         init_pair(1, COLOR_YELLOW, -1); 
     }
 
-    force_step = load_param("config/params.txt", "F_STEP");
-    if (force_step <= 0) force_step = 2.0f;
+    params_load(PARAMS_FILE);
+    apply_params();
+    double last_sent = 0.0;
 
-    // Wait for pipes to be available
-    int fd_out;
-    while ((fd_out = open(PIPE_UI_TO_SERVER, O_WRONLY)) < 0) usleep(100000);
-    int fd_in;
-    while ((fd_in = open(PIPE_SERVER_TO_UI_INPUT, O_RDONLY | O_NONBLOCK)) < 0) usleep(100000);
+    // Wait for pipes to be available (the writer open returns as soon as
+    // the Blackboard has its end open)
+    if (!attach) {
+        ch_out = chan_open(PIPE_UI_TO_SERVER, CHAN_WRITE);
+        ch_in = chan_open(PIPE_SERVER_TO_UI_INPUT, CHAN_READ);
+    }
 
     WINDOW *left_win = newwin(1, 1, 0, 0);
     WINDOW *right_win = newwin(1, 1, 0, 0);
@@ -132,34 +210,60 @@ int main(int argc, char *argv[]) {
     update_layout(left_win, right_win, split_ratio, log_msg);
     
     int ch;
-    Message msg_out; msg_out.sender_pid = getpid();
+    Message msg_out; memset(&msg_out, 0, sizeof(Message)); msg_out.sender_pid = getpid();
     Message msg_in;
     int running = 1;
+    int cmd_dirty = 0; // Keys changed the command since the last send
+
+    // Exported through the metrics mapping (served by the Blackboard)
+    metrics_attach("input");
+    Metric *m_frames = metric_counter("drone_input_frames_total", NULL, "Input window redraws");
+    Metric *m_received = metric_counter("drone_input_received_total", NULL, "Messages read from the Blackboard");
+    Metric *m_commands = metric_counter("drone_input_commands_total", NULL, "Force commands sent");
     // Main Loop
     while (running) {
-        int input_processed = 0;
-        msg_out.type = MSG_FORCE_UPDATE;
+        int stop_requested = 0;
 
         // 1. READ Telemetry 
-        while (read(fd_in, &msg_in, sizeof(Message)) > 0) {
+        int got;
+        while ((got = chan_recv(ch_in, &msg_in)) > 0) {
+            metric_add(m_received, 1);
             if (msg_in.type == MSG_DRONE_STATE) drone_display = msg_in.drone;
+            else if (msg_in.type == MSG_PARAM) {
+                // "KEY VALUE", or "KEY" alone: deleted from params.txt
+                char key[PARAM_KEY_LEN], value[PARAM_VAL_LEN];
+                int fields = sscanf(msg_in.info, "%31s %127s", key, value);
+                if ((fields == 2 && param_set(key, value)) || (fields == 1 && param_remove(key))) apply_params();
+            }
+            else if (msg_in.type == MSG_NET_STATS) {
+                const LinkStats *list = chan_batch_items(ch_in);
+                for (link_count = 0; link_count < msg_in.batch && link_count < MAX_PLAYERS; link_count++) {
+                    links[link_count] = list[link_count];
+                }
+                links_time = get_time_sec();
+            }
             else if (msg_in.type == MSG_STOP) running = 0;
         }
+        if (got < 0 && attach) break;   // The Blackboard is gone
 
         // 2. READ Keys 
-        // We read ALL keys waiting in the buffer to prevent lag
+        // We read ALL keys waiting in the buffer and fold them into ONE command
+        // (key auto-repeat used to send a full Message per key press)
         while ((ch = getch()) != ERR) {
             if (ch == KEY_RESIZE) {
                 resize_term(0, 0); 
                 update_layout(left_win, right_win, split_ratio, log_msg);
             }
             else if (ch == 27) { 
-                msg_out.type = MSG_STOP; 
-                input_processed = 1;
+                stop_requested = 1;
                 running = 0;
             } 
+            else if (attach && (ch == 'q' || ch == 'Q')) {
+                running = 0;    // Detach only, the simulation goes on
+            } 
             else {
-                input_processed = 1;
+                // Only mapped keys change the command (a pending one stays pending)
+                int mapped = 1;
                 switch(ch) {
                     case 'e': case 'E': cmd_y -= force_step; strcpy(log_msg, " UP"); break;
                     case 'c': case 'C': cmd_y += force_step; strcpy(log_msg, " DOWN"); break;
@@ -171,27 +275,54 @@ int main(int argc, char *argv[]) {
                     case 'z': case 'Z': cmd_y -= force_step; cmd_x -= force_step; strcpy(log_msg, " UpLeft"); break;
                     case 'x': case 'X': cmd_y += force_step; cmd_x -= force_step; strcpy(log_msg, " DownLleft"); break;
                     case 'v': case 'V': cmd_y += force_step; cmd_x += force_step; strcpy(log_msg, " DownRight"); break;
+                    default: mapped = 0; break;
                 }
+                if (mapped) cmd_dirty = 1;
             }
         }
 
         // 3. SEND Update
-        if (input_processed) {
+        // STOP goes out immediately, force commands at most CMD_RATE per second.
+        // The command is absolute (total force), so skipping frames loses nothing.
+        if (stop_requested) {
+            msg_out.type = MSG_STOP;
+            msg_out.seq = ++cmd_seq;
+            chan_send(ch_out, &msg_out);
+            break;
+        }
+        double now = get_time_sec();
+        if (cmd_dirty && now - last_sent >= cmd_interval) {
+            msg_out.type = MSG_FORCE_UPDATE;
+            msg_out.seq = ++cmd_seq;
             msg_out.drone.force.x = cmd_x;
             msg_out.drone.force.y = cmd_y;
-            write(fd_out, &msg_out, sizeof(Message));
-            if (msg_out.type == MSG_STOP) break;
+            chan_send(ch_out, &msg_out);
+            metric_add(m_commands, 1);
+            last_sent = now;
+            cmd_dirty = 0;
         }
         
         draw_output_win(right_win, log_msg);
         doupdate();
+        metric_add(m_frames, 1);
+        metrics_heartbeat(now);
         
-        // Smart Sleep: Don't sleep if user is active (low latency)
-        if (!input_processed) usleep(UI_REFRESH_RATE); 
-        else usleep(1000); 
+        // Smart Sleep: wait for the next frame OR a key press (low latency, no busy loop).
+        // If a command is pending, only wait until the rate limit allows it.
+        long wait_us = UI_REFRESH_RATE;
+        if (cmd_dirty) {
+            long until_send = (long)((last_sent + cmd_interval - now) * 1e6);
+            if (until_send < wait_us) wait_us = (until_send > 0) ? until_send : 0;
+        }
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(STDIN_FILENO, &rfds);
+        struct timeval tv = { wait_us / 1000000, wait_us % 1000000 };
+        select(STDIN_FILENO + 1, &rfds, NULL, NULL, &tv);
     }
 
-    close(fd_out); close(fd_in); // Close pipes
+    if (ch_out != ch_in) chan_close(ch_out);
+    chan_close(ch_in); // Close pipes (one socket when attached)
     delwin(left_win); delwin(right_win); // Delete windows
     endwin();
     return 0;
@@ -6,12 +6,18 @@
 #include <string.h>
 #include <errno.h>
 #include <locale.h> 
+#include <signal.h>
 #include "common.h"
+#include "channel.h"
+#include "motion.h"
+#include "metrics.h"
+#include "trace.h"
 
 // State
 DroneState drone;
 Obstacle obstacles[MAX_OBSTACLES];
 Target targets[MAX_TARGETS];
+Player players[MAX_PLAYERS];   // Multiplayer: every drone with its score
 int score = 0; 
 
 // Track screen size for scaling
@@ -46,6 +52,13 @@ void draw_game_entities(WINDOW *win) {
     wattron(win, COLOR_PAIR(4)); box(win, 0, 0); wattroff(win, COLOR_PAIR(4));
     wattron(win, COLOR_PAIR(3) | A_BOLD);
     mvwprintw(win, 0, 2, " MAP DISPLAY | Score = %d ", score);
+    // Multiplayer: the server's scores, ours marked with '*'
+    int col = 28;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (players[i].id == -1 || col > inner_w - 10) continue;
+        mvwprintw(win, 0, col, " P%d%s=%d ", i, players[i].local ? "*" : "", players[i].score);
+        col += 8;
+    }
     wattroff(win, COLOR_PAIR(3) | A_BOLD);
 
     // Calculate Scale: Screen Pixels per Meter
@@ -69,17 +82,31 @@ void draw_game_entities(WINDOW *win) {
     wattron(win, COLOR_PAIR(3));
     // [HYBRID FIX] Iterate ALL slots instead of relying on obs_count
     // This works for both Mode 2 (ID 0 only) and Mode 1 (IDs 0-29)
+    // Moving obstacles are drawn where their motion model puts them now
+    double now = get_time_sec();
     for(int i=0; i<MAX_OBSTACLES; i++) {
         if (obstacles[i].id != -1) {
-            int r = 1 + (int)(obstacles[i].position.y * scale_y);
-            int c = 1 + (int)(obstacles[i].position.x * scale_x);
+            Vec2 pos = motion_position(&obstacles[i], now);
+            int r = 1 + (int)(pos.y * scale_y);
+            int c = 1 + (int)(pos.x * scale_x);
             if (r > 0 && r <= inner_h && c > 0 && c <= inner_w)
                 mvwaddch(win, r, c, 'O'); // Using 'O' for visibility
         }
     }
     wattroff(win, COLOR_PAIR(3));
 
-    // 3. Draw Drone (Blue +)
+    // 3. Draw the other drones (Blue, player number)
+    wattron(win, COLOR_PAIR(1));
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        if (players[i].id == -1 || players[i].local) continue;
+        int r = 1 + (int)(players[i].drone.position.y * scale_y);
+        int c = 1 + (int)(players[i].drone.position.x * scale_x);
+        if (r > 0 && r <= inner_h && c > 0 && c <= inner_w)
+            mvwaddch(win, r, c, '0' + i);
+    }
+    wattroff(win, COLOR_PAIR(1));
+
+    // 4. Draw Drone (Blue +)
     wattron(win, COLOR_PAIR(1) | A_BOLD);
     int dr = 1 + (int)(drone.position.y * scale_y);
     int dc = 1 + (int)(drone.position.x * scale_x);
@@ -99,6 +126,28 @@ void draw_game_entities(WINDOW *win) {
 int main(int argc, char *argv[]) {
     register_process("UI_Map"); 
     log_message(SYSTEM_LOG_FILE, "UI_Map", "Map UI process started."); 
+    signal(SIGPIPE, SIG_IGN);
+
+    // --attach [socket]: detachable viewer on the Blackboard's socket
+    // (default: the FIFO of config/topics.txt). --rate: its redraw rate.
+    const char *attach = NULL;
+    float rate = 50.0f;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--attach") == 0) attach = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : VIEWER_SOCKET;
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) rate = atof(argv[++i]);
+    }
+    Channel *ch_in = NULL;
+    if (attach) {
+        char line[128];
+        snprintf(line, sizeof(line), "VIEW map DRONE_STATE:%g OBSTACLE:%g TARGET PLAYER:%g STOP", rate, rate, rate);
+        ch_in = chan_subscribe(attach, line, 5.0);
+        if (!ch_in) {
+            fprintf(stderr, "[Map] No Blackboard on %s\n", attach);
+            log_message(SYSTEM_LOG_FILE, "UI_Map", "Cannot attach to %s", attach);
+            return 1;
+        }
+        log_message(SYSTEM_LOG_FILE, "UI_Map", "Attached to %s at %g Hz", attach, rate);
+    }
 
     setlocale(LC_ALL, "");
     initscr(); cbreak(); noecho(); keypad(stdscr, TRUE); curs_set(0); 
@@ -111,8 +160,8 @@ int main(int argc, char *argv[]) {
     init_pair(3, COLOR_YELLOW, -1); 
     init_pair(4, COLOR_WHITE, -1);  
     
-    int fd_in;
-    while ((fd_in = open(PIPE_SERVER_TO_MAP, O_RDONLY | O_NONBLOCK)) < 0) usleep(100000);
+    // Read through the channel API: it reassembles the batch frames
+    if (!ch_in) ch_in = chan_open(PIPE_SERVER_TO_MAP, CHAN_READ);
 
     WINDOW *field = newwin(3, 3, 0, 0); 
     layout_and_draw(field); 
@@ -121,10 +170,17 @@ int main(int argc, char *argv[]) {
     // This allows us to detect valid updates in ANY mode
     for(int i=0; i<MAX_OBSTACLES; i++) obstacles[i].id = -1;
     for(int i=0; i<MAX_TARGETS; i++) { targets[i].id = -1; targets[i].active = 0; }
+    for(int i=0; i<MAX_PLAYERS; i++) players[i].id = -1;
 
     Message msg;
     int running = 1;
 
+    // Exported through the metrics mapping (served by the Blackboard)
+    metrics_attach("map");
+    trace_init("UI_Map");
+    Metric *m_frames = metric_counter("drone_map_frames_total", NULL, "Map redraws");
+    Metric *m_received = metric_counter("drone_map_received_total", NULL, "Messages read from the Blackboard");
+
     // Main Loop
     while (running) {
         int ch = getch();
@@ -135,27 +191,49 @@ int main(int argc, char *argv[]) {
         if (ch == KEY_RESIZE || cur_h != screen_h || cur_w != screen_w) {
             resize_term(0, 0); layout_and_draw(field); 
         }
+        if (attach && (ch == 'q' || ch == 'Q')) break;     // Detach, the simulation goes on
 
         // Drain pipe buffer
-        while (read(fd_in, &msg, sizeof(Message)) > 0) {
+        trace_begin("read");
+        int got;
+        while ((got = chan_recv(ch_in, &msg)) > 0) {
+            metric_add(m_received, 1);
             switch(msg.type) {
                 case MSG_DRONE_STATE: 
                     drone = msg.drone; 
+                    trace_flow_in("drone state", trace_flow_id(msg.sender_pid, msg.stamp));
                     break;
-                case MSG_OBSTACLE:
+                case MSG_OBSTACLE: {
                     // [CRITICAL FIX] Update specific slot by ID
                     // This works for Multiplayer (ID 0 updates repeatedly)
                     // AND Standalone (IDs 0-29 update independently)
-                    if (msg.obstacle.id >= 0 && msg.obstacle.id < MAX_OBSTACLES) {
-                        obstacles[msg.obstacle.id] = msg.obstacle;
+                    // A batch is applied whole, before the next redraw.
+                    const Obstacle *list = msg.batch ? chan_batch_items(ch_in) : &msg.obstacle;
+                    for (int k = 0; k < (msg.batch ? msg.batch : 1); k++) {
+                        if (list[k].id >= 0 && list[k].id < MAX_OBSTACLES) obstacles[list[k].id] = list[k];
+                    }
+                    break;
+                }
+                case MSG_TARGET: {
+                    const Target *list = msg.batch ? chan_batch_items(ch_in) : &msg.target;
+                    for (int k = 0; k < (msg.batch ? msg.batch : 1); k++) {
+                        int id = list[k].id;
+                        if (id >= 0 && id < MAX_TARGETS) {
+                            if (targets[id].active == 1 && list[k].active == 0) score++;
+                            targets[id] = list[k];
+                        }
                     }
                     break;
-                case MSG_TARGET:
-                    if (msg.target.id >= 0 && msg.target.id < MAX_TARGETS) {
-                        if (targets[msg.target.id].active == 1 && msg.target.active == 0) score++;
-                        targets[msg.target.id] = msg.target;
+                }
+                case MSG_PLAYER: {
+                    // The whole table, index = slot (empty slots have id -1)
+                    const Player *list = chan_batch_items(ch_in);
+                    for (int k = 0; k < msg.batch && k < MAX_PLAYERS; k++) {
+                        players[k] = list[k];
+                        if (list[k].id != -1 && list[k].local) score = list[k].score; // The server decides
                     }
                     break;
+                }
                 case MSG_STOP: 
                     running = 0; 
                     break;
@@ -163,10 +241,23 @@ int main(int argc, char *argv[]) {
             }
         }
         
+        trace_end("read");
+        if (got < 0 && attach) {
+            // The Blackboard is gone
+            log_message(SYSTEM_LOG_FILE, "UI_Map", "Blackboard closed the viewer socket");
+            break;
+        }
+
+        trace_begin("draw_game_entities");
         draw_game_entities(field);
+        trace_end("draw_game_entities");
+        metric_add(m_frames, 1);
+        metrics_heartbeat(get_time_sec());
+        trace_begin("sleep");
         usleep(UI_REFRESH_RATE);
+        trace_end("sleep");
     }
     
-    close(fd_in); delwin(field); endwin();
+    chan_close(ch_in); delwin(field); endwin();
     return 0;
 }
\ No newline at end of file
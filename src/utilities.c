@@ -1,4 +1,5 @@
 #include "common.h"
+#include <sys/syscall.h>
 
 // THE LOCKING FUNCTION
 int file_lock(int fd, int cmd, int type) {
@@ -33,9 +34,12 @@ void log_message(const char *filename, const char *process_name, const char *fmt
     }
 
     // Prepare Message
+    // (localtime_r: the components may log from several threads)
     time_t now = time(NULL);
-    char *time_str = ctime(&now);
-    time_str[strlen(time_str) - 1] = '\0'; // Remove newline
+    struct tm tm_now;
+    char time_str[32];
+    localtime_r(&now, &tm_now);
+    strftime(time_str, sizeof(time_str), "%a %b %e %H:%M:%S %Y", &tm_now);
 
     char buffer[1024];
     va_list args;
@@ -64,10 +68,23 @@ void register_process(const char *process_name) {
         return;
     }
 
-    // Write PID
-    dprintf(fd, "%s %d\n", process_name, getpid());
+    // Write PID and TID (the Watchdog samples the thread's /proc entry)
+    dprintf(fd, "%s %d %ld\n", process_name, getpid(), (long)syscall(SYS_gettid));
 
     // Unlock & Close
     file_lock(fd, F_SETLKW, F_UNLCK);
     close(fd);
-}
\ No newline at end of file
+}
+
+// MONOTONIC CLOCK (Seconds)
+double get_time_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// SEQUENCE COMPARISON
+// Signed difference so the counter can wrap around safely
+int seq_is_newer(unsigned int seq, unsigned int last) {
+    return (int)(seq - last) > 0;
+}
@@ -1,10 +1,54 @@
 #include "common.h"
+#include "metrics.h"
+#include "proc_sample.h"
 #include <ncurses.h>
 
 #define PROCESS_CHECK_INTERVAL 2 // Seconds between checks
-#define BOX_WIDTH 62             
+#define BOX_WIDTH 78             
 #define BOX_HEIGHT 20            
 
+// Resource sampling (proc_sample.c): one sampler per registered component,
+// kept across passes so the counters can be diffed
+#define MAX_WATCHED 16
+#define POLL_WAKEUP_RATE 200.0   // Wakeups/s: a poll-and-sleep loop (Dynamics sleeps 2 ms: 500/s)
+#define BUSY_CPU_PCT 50.0        // % of one CPU
+static ProcSample samples[MAX_WATCHED];
+static char sample_names[MAX_WATCHED][32];
+static int sample_flags[MAX_WATCHED];        // 1 poll, 2 busy (logged on change)
+static int n_samples = 0;
+
+// The sampler of 'name' (reopened if it restarted with another PID)
+static int sample_slot(const char *name, int pid, int tid) {
+    int i;
+    for (i = 0; i < n_samples; i++) {
+        if (strcmp(sample_names[i], name) == 0) break;
+    }
+    if (i == n_samples) {
+        if (n_samples == MAX_WATCHED) return -1;
+        snprintf(sample_names[i], sizeof(sample_names[i]), "%s", name);
+        samples[i].fd_stat = samples[i].fd_status = samples[i].fd_sched = -1;
+        samples[i].pid = -1;
+        n_samples++;
+    }
+    if (samples[i].pid != pid || samples[i].tid != tid) {
+        proc_sample_close(&samples[i]);
+        sample_flags[i] = 0;
+        if (proc_sample_open(&samples[i], pid, tid) < 0) return -1;
+    }
+    return i;
+}
+
+// CPU history as a bar per sample, relative to the row's peak (at least 5%)
+static void draw_trend(const ProcSample *ps) {
+    static const char LEVELS[] = " .:-=+*#";
+    float peak = 5.0f;
+    for (int k = 0; k < ps->trend_len; k++) if (ps->trend[k] > peak) peak = ps->trend[k];
+    for (int k = 0; k < ps->trend_len; k++) {
+        int level = (int)(ps->trend[k] / peak * 7.0f + 0.5f);
+        addch(LEVELS[level < 0 ? 0 : level > 7 ? 7 : level]);
+    }
+}
+
 int main() {
     // 1. Setup Logging & UI
     register_process("Watchdog"); 
@@ -16,6 +60,10 @@ int main() {
     curs_set(0); // Hide cursor
     timeout(PROCESS_CHECK_INTERVAL * 1000); // Set getch timeout
 
+    // Exported through the metrics mapping (served by the Blackboard)
+    metrics_attach("watchdog");
+    Metric *m_checks = metric_counter("drone_watchdog_checks_total", NULL, "Passes over the process list");
+    Metric *m_alerts = metric_counter("drone_watchdog_alerts_total", NULL, "Processes found not responding");
 
     if (has_colors()) {
         start_color();
@@ -57,9 +105,12 @@ int main() {
         attron(A_BOLD | COLOR_PAIR(1));
         mvprintw(start_y, start_x + (BOX_WIDTH - 25) / 2, " Watchdog Process Monitor "); 
         // Table Header
-        mvprintw(start_y + 2, start_x + 2, " %-20s | %-10s | %-15s ", "PROCESS NAME", "PID", "STATUS");
+        mvprintw(start_y + 2, start_x + 2, " %-12s %6s %-5s %5s %6s %6s %6s %6s  %-8s", "PROCESS", "PID", "STATE",
+                 "CPU%", "RSS MB", "vcs/s", "ivcs/s", "wake/s", "CPU TREND");
         mvhline(start_y + 3, start_x + 2, ACS_HLINE, BOX_WIDTH - 4); // Inner separator
         attroff(A_BOLD | COLOR_PAIR(1));
+        mvprintw(start_y + BOX_HEIGHT - 3, start_x + 2, "POLL: >%.0f wakeups/s   BUSY: >%.0f%% CPU   (every %d s)",
+                 POLL_WAKEUP_RATE, BUSY_CPU_PCT, PROCESS_CHECK_INTERVAL);
         mvprintw(start_y + BOX_HEIGHT - 2, start_x + 2, "Press 'q' to Quit | Logs: ./watchdog.log");
 
         // READ process_list.txt and CHECK each process
@@ -79,40 +130,75 @@ int main() {
         char line[64];
         int row_offset = 5; // Start printing 5 lines down from box top
         
+        double now = get_time_sec();
         while (fgets(line, sizeof(line), fp)) {
             char name[32];
             pid_t pid;
+            int tid = 0;        // Older lines have no thread ID: the whole process
             line[strcspn(line, "\n")] = 0;
 
-            if (sscanf(line, "%s %d", name, &pid) == 2) {
+            if (sscanf(line, "%31s %d %d", name, &pid, &tid) >= 2) {
                 int current_row = start_y + row_offset;
 
                 // Send Signal 0 to check health
-                if (kill(pid, 0) == 0) {
-                    mvprintw(current_row, start_x + 2, " %-20s | %-10d | ", name, pid);
-                    // Green for alive
-                    attron(A_BOLD | COLOR_PAIR(2));
-                    printw("ALIVE");
-                    attroff(A_BOLD | COLOR_PAIR(2));
-                    
-                    log_message(WATCHDOG_LOG_FILE, "Watchdog", "%s (PID %d) is running", name, pid);
+                int alive = (kill(pid, 0) == 0);
+                char labels[48];
+                snprintf(labels, sizeof(labels), "process=\"%s\"", name);
+                metric_set(metric_gauge("drone_process_alive", labels, "1 if the process answers signal 0"), alive);
+                int slot = alive ? sample_slot(name, pid, tid) : -1;
+                ProcSample *ps = (slot >= 0 && proc_sample_update(&samples[slot], now) == 0) ? &samples[slot] : NULL;
+                mvprintw(current_row, start_x + 2, " %-12.12s %6d ", name, pid);
+                if (alive) {
+                    // Green for alive, yellow for a poll loop, red for a CPU hog
+                    int flags = 0;
+                    if (ps && ps->valid) flags = (ps->wakeup_rate > POLL_WAKEUP_RATE) | ((ps->cpu_pct > BUSY_CPU_PCT) << 1);
+                    int color = (flags & 2) ? 3 : (flags & 1) ? 1 : 2;
+                    attron(A_BOLD | COLOR_PAIR(color));
+                    printw("%-5s", (flags & 2) ? "BUSY" : (flags & 1) ? "POLL" : "ALIVE");
+                    attroff(A_BOLD | COLOR_PAIR(color));
+                    if (ps && ps->valid) {
+                        printw(" %5.1f %6.1f %6.0f %6.0f %6.0f  ", ps->cpu_pct, ps->rss_kb / 1024.0,
+                               ps->vcsw_rate, ps->ivcsw_rate, ps->wakeup_rate);
+                        draw_trend(ps);
+                        log_message(WATCHDOG_LOG_FILE, "Watchdog", "%s (PID %d) is running: CPU %.1f%%, RSS %ld kB, "
+                                    "%.0f voluntary + %.0f involuntary switches/s, %.0f wakeups/s%s",
+                                    name, pid, ps->cpu_pct, ps->rss_kb, ps->vcsw_rate, ps->ivcsw_rate, ps->wakeup_rate,
+                                    ps->has_wakeups ? "" : " (= voluntary switches)");
+                        if (flags != sample_flags[slot] && flags) {
+                            log_message(SYSTEM_LOG_FILE, "Watchdog", "%s (PID %d): %.0f wakeups/s at %.1f%% CPU%s", name, pid,
+                                        ps->wakeup_rate, ps->cpu_pct, (flags & 2) ? ", busy" : ", poll-and-sleep loop");
+                        }
+                        sample_flags[slot] = flags;
+
+                        char labels[48];
+                        snprintf(labels, sizeof(labels), "process=\"%s\"", name);
+                        metric_set(metric_gauge("drone_process_cpu_percent", labels, "CPU over the last check, % of one CPU"), ps->cpu_pct);
+                        metric_set(metric_gauge("drone_process_rss_bytes", labels, "Resident memory"), ps->rss_kb * 1024.0);
+                        metric_set(metric_counter("drone_process_voluntary_switches_total", labels, "Sleeps (blocking calls)"), ps->vcsw);
+                        metric_set(metric_counter("drone_process_involuntary_switches_total", labels, "Preemptions"), ps->ivcsw);
+                        metric_set(metric_counter("drone_process_wakeups_total", labels, "Wakeups (voluntary switches without schedstats)"), ps->wakeups);
+                    } else {
+                        log_message(WATCHDOG_LOG_FILE, "Watchdog", "%s (PID %d) is running", name, pid);
+                    }
                 } else {
-                    mvprintw(current_row, start_x + 2, " %-20s | %-10d | ", name, pid);
-                     // Red Blink for unresponsive
+                    // Red Blink for unresponsive
                     attron(A_BOLD | A_BLINK | COLOR_PAIR(3));
-                    printw("NOT RESPONDING!");
+                    printw("DEAD  NOT RESPONDING!");
                     attroff(A_BOLD | A_BLINK | COLOR_PAIR(3));
-                    
+
                     log_message(SYSTEM_LOG_FILE, "Watchdog", "ALERT: %s (PID %d) is not responding!", name, pid);
+                    metric_add(m_alerts, 1);
                 }
                 row_offset++;
                 // Stop if we run out of box height
-                if (row_offset >= BOX_HEIGHT - 2) break; 
+                if (row_offset >= BOX_HEIGHT - 3) break; 
             }
         }
 
         file_lock(fd, F_SETLKW, F_UNLCK); // Unlock
         fclose(fp);// Close file
+        metric_add(m_checks, 1);
+        metrics_heartbeat(get_time_sec());
 
         refresh();
 